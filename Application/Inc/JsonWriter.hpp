@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef JSONWRITER_HPP_
+#define JSONWRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief Streaming JSON encoder that writes directly into a caller provided buffer, in a
+ * 		  single pass, without heap allocation or the printf machinery.
+ *
+ * Separators are inserted automatically, so a payload is built by nesting calls:
+ * @code
+ *   JsonWriter json(buf, sizeof(buf));
+ *   json.beginObject().key("sensor").beginArray();
+ *   json.beginObject().member("temperature", 23).endObject();
+ *   json.endArray().endObject();
+ *   size_t length = json.finish();
+ * @endcode
+ *
+ * Keys must be string literals, their length is resolved at compile time and they are
+ * copied without escaping. When the buffer is exhausted the writer latches an overflow
+ * state, all further writes are discarded and finish() returns zero.
+ */
+class JsonWriter
+{
+	public:
+		constexpr JsonWriter(char *buffer, size_t size)
+			: buf(buffer), bufSize(size), pos(0), depth(0), firstInScope(1), afterKey(false),
+			  overflow(size == 0)
+		{
+		}
+
+		JsonWriter &beginObject() { return open('{'); }
+		JsonWriter &endObject() { return close('}'); }
+		JsonWriter &beginArray() { return open('['); }
+		JsonWriter &endArray() { return close(']'); }
+
+		/**
+		 * @brief Writes a member name, the next value written is bound to this key.
+		 */
+		template <size_t N>
+		JsonWriter &key(const char (&name)[N])
+		{
+			separator();
+			put('"');
+			put(name, N - 1);
+			put('"');
+			put(':');
+			afterKey = true;
+			return *this;
+		}
+
+		/**
+		 * @brief Writes an integer value, any integral type up to 32-bits wide.
+		 */
+		template <typename T,
+				  typename = typename std::enable_if<std::is_integral<T>::value &&
+													 !std::is_same<T, bool>::value>::type>
+		JsonWriter &value(T number)
+		{
+			static_assert(sizeof(T) <= sizeof(uint32_t), "JsonWriter supports up to 32-bit integers");
+
+			separator();
+			if (std::is_signed<T>::value && number < 0) {
+				put('-');
+				putUnsigned(0u - static_cast<uint32_t>(number));
+			}
+			else {
+				putUnsigned(static_cast<uint32_t>(number));
+			}
+			return *this;
+		}
+
+		JsonWriter &value(bool state)
+		{
+			separator();
+			if (state) put("true", 4);
+			else put("false", 5);
+			return *this;
+		}
+
+		/**
+		 * @brief Writes a string value, quotes, backslashes and control characters are escaped.
+		 */
+		JsonWriter &value(const char *text)
+		{
+			separator();
+			put('"');
+			for (; *text != '\0'; text++) {
+				char c = *text;
+				if (c == '"' || c == '\\') {
+					put('\\');
+					put(c);
+				}
+				else if (static_cast<unsigned char>(c) < 0x20) {
+					put("\\u00", 4);
+					put(hexDigit(c >> 4));
+					put(hexDigit(c));
+				}
+				else {
+					put(c);
+				}
+			}
+			put('"');
+			return *this;
+		}
+
+		/**
+		 * @brief Writes a fixed-point number, where value is scaled by 10^decimals.
+		 *        Example: fixed(-2315, 2) writes -23.15
+		 *        At most 9 decimals are supported, more latches the error like an overflow.
+		 */
+		JsonWriter &fixed(int32_t number, uint8_t decimals)
+		{
+			separator();
+
+			/* 10^decimals must fit in 32-bits */
+			if (decimals > maxDecimals) {
+				overflow = true;
+				return *this;
+			}
+
+			uint32_t magnitude = static_cast<uint32_t>(number);
+			if (number < 0) {
+				put('-');
+				magnitude = 0u - magnitude;
+			}
+
+			uint32_t scale = 1;
+			for (uint8_t i = 0; i < decimals; i++) {
+				scale *= 10;
+			}
+
+			putUnsigned(magnitude / scale);
+			if (decimals > 0) {
+				put('.');
+				putUnsigned(magnitude % scale, decimals);
+			}
+			return *this;
+		}
+
+		/**
+		 * @brief Convenience for writing a key/value pair.
+		 */
+		template <size_t N, typename T>
+		JsonWriter &member(const char (&name)[N], T number)
+		{
+			return key(name).value(number);
+		}
+
+		/**
+		 * @brief Terminates the payload with a null character.
+		 * @retval Payload length excluding the terminator, or zero if the buffer overflowed or
+		 * 		   the nesting is unbalanced.
+		 */
+		size_t finish()
+		{
+			if (overflow || depth != 0) {
+				if (bufSize > 0) buf[0] = '\0';
+				return 0;
+			}
+
+			buf[pos] = '\0';
+			return pos;
+		}
+
+		size_t size() const { return pos; }
+		bool ok() const { return !overflow; }
+
+	private:
+		/* Maximum nesting depth, one bit per level in firstInScope */
+		static constexpr uint8_t maxDepth = 31;
+
+		/* Maximum fixed-point decimals, 10^9 is the largest power of ten in 32-bits */
+		static constexpr uint8_t maxDecimals = 9;
+
+		JsonWriter &open(char c)
+		{
+			separator();
+			put(c);
+			if (depth < maxDepth) {
+				depth++;
+				firstInScope |= (1u << depth);
+			}
+			else {
+				overflow = true;
+			}
+			return *this;
+		}
+
+		JsonWriter &close(char c)
+		{
+			if (depth > 0) {
+				firstInScope &= ~(1u << depth);
+				depth--;
+			}
+			else {
+				overflow = true;
+			}
+			put(c);
+			return *this;
+		}
+
+		/* Emits a comma, unless this is the first element in the scope or a key was just written */
+		void separator()
+		{
+			if (afterKey) {
+				afterKey = false;
+			}
+			else if (firstInScope & (1u << depth)) {
+				firstInScope &= ~(1u << depth);
+			}
+			else {
+				put(',');
+			}
+		}
+
+		/* One byte is always kept in reserve for the terminator */
+		void put(char c)
+		{
+			if (!overflow && (pos + 1) < bufSize) {
+				buf[pos++] = c;
+			}
+			else {
+				overflow = true;
+			}
+		}
+
+		void put(const char *text, size_t length)
+		{
+			if (!overflow && (pos + length) < bufSize) {
+				for (size_t i = 0; i < length; i++) {
+					buf[pos++] = text[i];
+				}
+			}
+			else {
+				overflow = true;
+			}
+		}
+
+		/* Writes a decimal value, zero padded to at least minDigits */
+		void putUnsigned(uint32_t number, uint8_t minDigits = 1)
+		{
+			char digits[10];
+			uint8_t count = 0;
+
+			do {
+				digits[count++] = static_cast<char>('0' + (number % 10));
+				number /= 10;
+			} while (number != 0 && count < sizeof(digits));
+
+			while (count < minDigits && count < sizeof(digits)) {
+				digits[count++] = '0';
+			}
+
+			while (count > 0) {
+				put(digits[--count]);
+			}
+		}
+
+		static constexpr char hexDigit(int nibble)
+		{
+			return "0123456789ABCDEF"[nibble & 0x0F];
+		}
+
+		char *buf;
+		size_t bufSize;
+		size_t pos;
+		uint8_t depth;
+		uint32_t firstInScope;
+		bool afterKey;
+		bool overflow;
+};
+
+
+#endif /* JSONWRITER_HPP_ */
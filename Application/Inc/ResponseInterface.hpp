@@ -36,6 +36,7 @@ typedef enum {
 	RESPONSE_MSG_HELP,
 	RESPONSE_MSG_INVALID,
 	RESPONSE_MSG_PROMPT,
+	RESPONSE_MSG_STATS,
 	RESPONSE_MSG_STATUS,
 	RESPONSE_MSG_VERSION,
 	RESPONSE_MSG_WIFI_STATUS
@@ -57,6 +58,7 @@ class ResponseInterface : public cpp_freertos::Thread
 		void Run();
 
 		void CloudStatusHandler();
+		void StatsHandler();
 		void WifiStatusHandler();
 
 	private:
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RINGBUFFER_HPP_
+#define RINGBUFFER_HPP_
+
+#include <array>
+#include <cstddef>
+
+/**
+ * @brief Fixed capacity FIFO ring buffer, storage is statically allocated as part of the
+ * 		  object. When full, pushing a new element overwrites the oldest element.
+ * @note  Not thread safe, the owner is responsible for serializing access.
+ */
+template <typename T, std::size_t Capacity>
+class RingBuffer
+{
+	static_assert(Capacity > 0, "RingBuffer capacity must be non-zero");
+
+	public:
+		RingBuffer() : head(0), count(0) {}
+
+		/**
+		 * @brief Appends an element to the back, overwriting the oldest element when full.
+		 * @retval false if an element was overwritten
+		 */
+		bool push(const T &value)
+		{
+			bool overwrite = full();
+
+			buffer[(head + count) % Capacity] = value;
+			if (overwrite) {
+				head = (head + 1) % Capacity;
+			}
+			else {
+				count++;
+			}
+
+			return !overwrite;
+		}
+
+		/**
+		 * @brief Removes the oldest element, does nothing if empty.
+		 */
+		void pop()
+		{
+			if (count > 0) {
+				head = (head + 1) % Capacity;
+				count--;
+			}
+		}
+
+		/**
+		 * @brief Access element by position, where zero is the oldest element.
+		 */
+		const T &operator[](std::size_t index) const { return buffer[(head + index) % Capacity]; }
+		const T &front() const { return buffer[head]; }
+
+		void clear() { head = count = 0; }
+		bool empty() const { return count == 0; }
+		bool full() const { return count == Capacity; }
+		std::size_t size() const { return count; }
+		static constexpr std::size_t capacity() { return Capacity; }
+
+	private:
+		std::array<T, Capacity> buffer;
+		std::size_t head;
+		std::size_t count;
+};
+
+
+#endif /* RINGBUFFER_HPP_ */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RUNTIMESTATS_HPP_
+#define RUNTIMESTATS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @brief Samples the FreeRTOS run time statistics, reporting how each task used the processor
+ * 		  since the previous sample, and how close each task came to exhausting its stack.
+ * @note  Each instance keeps its own previous sample, so independent reports (e.g. the stats
+ * 		  command and the cloud publish) do not disturb one another. Not thread safe, the owner
+ * 		  is responsible for serializing access.
+ */
+class RunTimeStats
+{
+	public:
+		static constexpr size_t MaxTasks = 20;
+
+		typedef struct {
+			const char *name;
+			UBaseType_t priority;
+			uint32_t load;			/* tenths of a percent of the sample period */
+			uint32_t stackFree;		/* fewest bytes of stack ever left unused */
+		} Task_t;
+
+		RunTimeStats() : count(0), period(0), lastTotal(0), load(0) {}
+
+		bool sample();
+
+		size_t size() const { return count; }
+		const Task_t &operator[](size_t index) const { return tasks[index]; }
+
+		/**
+		 * @brief Length of the last sample period, in microseconds.
+		 */
+		uint32_t periodUs() const { return period; }
+
+		/**
+		 * @brief Share of the last sample period spent outside the idle task, in tenths of a percent.
+		 */
+		uint32_t totalLoad() const { return load; }
+
+	private:
+		typedef struct {
+			TaskHandle_t handle;
+			uint32_t runTime;
+		} RunTime_t;
+
+		std::array<TaskStatus_t, MaxTasks> status;
+		std::array<Task_t, MaxTasks> tasks;
+		std::array<RunTime_t, MaxTasks> previous;
+		size_t count;
+		uint32_t period;
+		uint32_t lastTotal;
+		uint32_t load;
+};
+
+
+#endif /* RUNTIMESTATS_HPP_ */
@@ -32,8 +32,9 @@
 class UserConfig
 {
 	public:
-		typedef std::array<uint8_t, 2048> KeyValue_t;
-		typedef std::array<uint8_t, 2048> CertValue_t;
+		/* Key and certificate are held in DER form, an RSA-2048 key is about 1.2 KB */
+		typedef std::array<uint8_t, 1536> KeyValue_t;
+		typedef std::array<uint8_t, 1536> CertValue_t;
 		typedef std::array<char, 64> EndpointUrlValue_t;
 		typedef std::array<char, 64> ThingNameValue_t;
 
@@ -86,17 +87,33 @@ class UserConfig
 			uint16_t tableVersion;
 			Cloud_t cloud;
 			Wifi_t wifi;
-			uint32_t checksum;
 		}Config_t;
 
-		static constexpr uint16_t TableVersion = 1;
+		static constexpr uint16_t TableVersion = 2;
 		static constexpr uint16_t TableSize  = sizeof(Config_t);
 
-		/* Note: this invokes file I/O from the "global" workspace before the kernel has been
-		 * started. This means the CRT file I/O requests ~400+ bytes during library initialization.
-		 * This heap memory remains allocated in the "global" workspace and is never used again. If
-		 * memory constraints become critical, need to reassess initializing this object using
-		 * an explicit call from a running thread.
+		/* Table written in one piece through the "storage" file interface by earlier firmware,
+		 * with the key and certificate in PEM form. Imported on first boot, do not modify. */
+		typedef struct {
+			uint16_t tableSize;
+			uint16_t tableVersion;
+			struct {
+				struct {
+					std::array<uint8_t, 2048> value;
+					uint16_t size;
+				} key, cert;
+				EndpointUrl_t EndpointUrl;
+				ThingName_t ThingName;
+			} cloud;
+			Wifi_t wifi;
+			uint32_t checksum;
+		}LegacyConfig_t;
+
+		static constexpr uint16_t LegacyTableVersion = 1;
+
+		/* Note: this reads storage from the "global" workspace before the kernel has been
+		 * started. Each parameter is read directly from its storage record, no file I/O or heap
+		 * is required.
 		 */
 		UserConfig() { GetConfig(&config); };
 
@@ -117,7 +134,6 @@ class UserConfig
 		Config_t config;
 
 		void GetConfig(Config_t *);
-		bool SetConfig(std::unique_ptr<Config_t> );
 };
 
 #endif /* USERCONFIG_HPP_ */
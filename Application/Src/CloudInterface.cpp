@@ -20,11 +20,19 @@
  *
  */
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <random>
 
 #include "ThreadConfig.hpp"
 #include "UserConfig.hpp"
 #include "CloudInterface.hpp"
+#include "RingBuffer.hpp"
+#include "JsonWriter.hpp"
+#include "RunTimeStats.hpp"
+#include "HeapManager.h"
+#include "semaphore.hpp"
 
 #include "WiFiStation.hpp"
 #include "hts221.hpp"
@@ -34,9 +42,29 @@
 
 extern "C" {
 #include "aws_mqtt_agent.h"
+#include "aws_mqtt_agent_config.h"
+#include "aws_bufferpool.h"
 }
 
 /* Typedef -----------------------------------------------------------*/
+/**
+ * @brief A single set of sensor readings, time stamped in milliseconds since power-up.
+ */
+typedef struct {
+	uint32_t time;
+	int16_t temperature;
+	uint16_t humidity;
+	uint16_t pressure;
+} Sample_t;
+
+/**
+ * @brief A batch of samples published asynchronously, awaiting the broker acknowledgment.
+ */
+typedef struct {
+	size_t count;
+	volatile MQTTAgentReturnCode_t result;
+} Batch_t;
+
 
 /* Define ------------------------------------------------------------*/
 /**
@@ -60,6 +88,44 @@ extern "C" {
 /* Topic name for the MQTT broker */
 #define TOPIC_NAME (const uint8_t *)"stm32/sensor"
 
+/* Topic name for the runtime statistics */
+#define STATS_TOPIC_NAME (const uint8_t *)"stm32/stats"
+
+/* Period between each sensor sample */
+#define SAMPLE_PERIOD                 pdMS_TO_TICKS( 5000 )
+
+/* Samples are buffered locally and published together as a single JSON array,
+ * once either CLOUD_BATCH_SAMPLES samples are pending or the oldest pending
+ * sample reaches CLOUD_BATCH_MAX_AGE, whichever comes first. Setting
+ * CLOUD_BATCH_SAMPLES to 1 publishes every sample as it is taken. */
+#define CLOUD_BATCH_SAMPLES           10
+#define CLOUD_BATCH_MAX_AGE           pdMS_TO_TICKS( 60000 )
+
+/* Number of samples retained locally while the cloud connection is down. Once
+ * full, the oldest samples are discarded. */
+#define CLOUD_QUEUE_SAMPLES           120
+
+/* A lost connection is re-established with an exponential backoff, bounded by
+ * the min/max delay. Each delay is randomized between 50-100% of its nominal
+ * value, so a fleet of devices does not reconnect in lock step. */
+#define CLOUD_RECONNECT_MIN_DELAY     pdMS_TO_TICKS( 2000 )
+#define CLOUD_RECONNECT_MAX_DELAY     pdMS_TO_TICKS( 300000 )
+
+/* Consecutive publish failures tolerated before the connection is considered lost */
+#define CLOUD_MAX_PUBLISH_FAILURES    3
+
+/* Number of batches published without waiting for the previous one to be acknowledged, so
+ * a backlog drains at the link rate rather than one broker round trip per batch. Each batch
+ * takes a payload buffer, and an MQTT agent operation slot. */
+#define CLOUD_PUBLISH_WINDOW          3
+
+/* Worst case length of one JSON encoded sample, used to size the payload buffer */
+#define CLOUD_SAMPLE_JSON_MAX         80
+
+/* Period between runtime statistics publishes (task load, stack and heap usage), set to 0 to
+ * disable. Must be well under the 71 minute wrap of the run time counter. */
+#define CLOUD_STATS_PERIOD            pdMS_TO_TICKS( 300000 )
+
 
 /* Macro -------------------------------------------------------------*/
 
@@ -67,15 +133,38 @@ extern "C" {
 enl::WiFiStation WiFi;
 
 static MQTTAgentHandle_t xMQTTHandle = NULL;
-static const size_t buf_size = 512;
-static char buf[buf_size] = {};
+static const size_t buf_size = 1024;
+static char buf[CLOUD_PUBLISH_WINDOW][buf_size] = {};
+static Batch_t batches[CLOUD_PUBLISH_WINDOW];
+static cpp_freertos::CountingSemaphore batchDone(CLOUD_PUBLISH_WINDOW, 0);
+static size_t batchesInFlight = 0;
+static RingBuffer<Sample_t, CLOUD_QUEUE_SAMPLES> samples;
+static volatile bool brokerDisconnected = false;
+
+static_assert( CLOUD_QUEUE_SAMPLES >= CLOUD_BATCH_SAMPLES,
+		"Sample queue must hold at least one batch" );
+
+static_assert( (CLOUD_BATCH_SAMPLES * CLOUD_SAMPLE_JSON_MAX + 16) <= buf_size,
+		"Payload buffer too small for CLOUD_BATCH_SAMPLES" );
+
+static_assert( CLOUD_PUBLISH_WINDOW >= 1 && CLOUD_PUBLISH_WINDOW < mqttconfigMAX_PARALLEL_OPS,
+		"Publish window must leave an MQTT agent operation free" );
 
 
 /* Function prototypes -----------------------------------------------*/
 static bool networkInit(UserConfig &userConfig);
 static bool cloudConnect(UserConfig &userConfig);
 static void cloudDisconnect();
-static void cloudSend(int16_t temperature, uint16_t humidity, uint16_t pressure);
+static BaseType_t cloudEventCallback(void * pvUserData, const MQTTAgentCallbackParams_t * const pxCallbackParams);
+static bool cloudLinkUp();
+static void cloudSample(sensor::HTS221 &hts221, sensor::LPS22HB &lps22hb);
+static bool cloudFlushDue(size_t first = 0);
+static bool cloudSend();
+static bool cloudAwaitBatches();
+static size_t cloudFormatBatch(char *payload, size_t first);
+static void cloudBatchCallback(void * pvCallbackContext, uint32_t ulMessageId, MQTTAgentReturnCode_t xResult);
+static bool cloudSendStats();
+static bool cloudPublish(const uint8_t *topic, size_t length);
 
 
 /* External functions ------------------------------------------------*/
@@ -96,39 +185,86 @@ CloudInterface::CloudInterface(UserConfig &uh)
 
 /**
  * @brief Implements the persistent loop for thread execution.
+ *
+ * Sensors are sampled at a fixed rate regardless of the connection state. While connected,
+ * the MQTT session is held open and pending samples are published in batches. When the
+ * WiFi link or broker connection is lost, samples are queued locally and the connection
+ * is re-established using a randomized exponential backoff.
  */
 void CloudInterface::Run()
 {
-	uint16_t humidity, pressure;
-	int16_t temperature;
-
 	sensor::HTS221 hts221(I2C2_Bus);
 	sensor::LPS22HB lps22hb(I2C2_Bus);
 
-	networkInit(userConfigHandle);
+	/* Pressure is buffered by the sensor between samples, and drained in one burst */
+	lps22hb.enableFifo(sensor::LPS22HB::FifoDepth);
 
-	if( cloudConnect(userConfigHandle) )
-	{
-		for(size_t index = 0; index < 10; index++)
-		{
-			temperature = hts221.getTemperature();
-			humidity = hts221.getHumidity();
-			pressure = lps22hb.getPressure();
+	bool connected = false;
+	uint8_t publishFailures = 0;
+	TickType_t backoff = CLOUD_RECONNECT_MIN_DELAY;
+	TickType_t retryDelay = 0;
+	TickType_t lastAttempt = xTaskGetTickCount();
+	TickType_t lastStats = xTaskGetTickCount();
 
-			cloudSend(temperature, humidity, pressure);
+	/* Seed the backoff jitter with the station MAC, so each device picks a different delay.
+	 * Querying the status first brings up the WiFi module, so the MAC is available. */
+	enl::MACAddress mac;
+	WiFi.status();
+	WiFi.macAddress(mac);
+	std::minstd_rand jitter( (mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5] );
 
-			CloudInterface::DelayUntil(5000);
+	while (true)
+	{
+		cloudSample(hts221, lps22hb);
+
+		/* Drop the session if the broker or WiFi link went away */
+		if ( connected && ( brokerDisconnected || !cloudLinkUp() ) ) {
+			configPRINTF( ("Cloud connection lost.\n") );
+			cloudDisconnect();
+			connected = false;
+			lastAttempt = xTaskGetTickCount();
+			retryDelay = 0;
 		}
 
-		cloudDisconnect();
-		WiFi.disconnect();
-	}
+		if ( !connected && (xTaskGetTickCount() - lastAttempt) >= retryDelay ) {
+			if ( (cloudLinkUp() || networkInit(userConfigHandle)) && cloudConnect(userConfigHandle) ) {
+				connected = true;
+				publishFailures = 0;
+				backoff = CLOUD_RECONNECT_MIN_DELAY;
+			}
+			else {
+				std::uniform_int_distribution<TickType_t> range(backoff / 2, backoff);
+				retryDelay = range(jitter);
+				backoff = std::min<TickType_t>(backoff * 2, CLOUD_RECONNECT_MAX_DELAY);
+				configPRINTF( ("Cloud reconnect in %lu ms.\n", retryDelay * portTICK_PERIOD_MS) );
+			}
+			lastAttempt = xTaskGetTickCount();
+
+			/* A connection attempt can outlast several sample periods, resume sampling
+			 * from now rather than catching up with a burst of samples. */
+			CloudInterface::ResetDelayUntil();
+		}
+
+		/* Publish queued batches, including any backlog from while offline */
+		while ( connected && cloudFlushDue() ) {
+			if ( cloudSend() ) {
+				publishFailures = 0;
+			}
+			else {
+				if ( ++publishFailures >= CLOUD_MAX_PUBLISH_FAILURES ) {
+					brokerDisconnected = true;
+				}
+				break;
+			}
+		}
 
-    configPRINTF( ("Demo completed.\n") );
+		if ( connected && (CLOUD_STATS_PERIOD > 0) && (xTaskGetTickCount() - lastStats) >= CLOUD_STATS_PERIOD ) {
+			cloudSendStats();
+			lastStats = xTaskGetTickCount();
+		}
 
-	/* Suspend ourselves indefinitely */
-	vTaskSuspend(NULL);
-	while (1);
+		CloudInterface::DelayUntil(SAMPLE_PERIOD);
+	}
 }
 
 /**
@@ -183,13 +319,14 @@ static bool cloudConnect(UserConfig &userConfig)
         0,                                    /* The length of the client Id, filled in later as not const. */
         pdFALSE,                              /* Deprecated. */
         NULL,                                 /* User data supplied to the callback. Can be NULL. */
-        NULL,                                 /* Callback used to report various events. Can be NULL. */
+        cloudEventCallback,                   /* Callback used to report various events. Can be NULL. */
         NULL,                                 /* Certificate used for secure connection. Can be NULL. */
         0                                     /* Size of certificate used for secure connection. */
     };
 
-    /* Check this function has not already been executed. */
+    /* Check a previous session has been released. */
     configASSERT( xMQTTHandle == NULL );
+    brokerDisconnected = false;
 
     /* The MQTT client object must be created before it can be used.  The
      * maximum number of MQTT client objects that can exist simultaneously
@@ -213,6 +350,7 @@ static bool cloudConnect(UserConfig &userConfig)
         {
             /* Could not connect, so delete the MQTT client. */
             ( void ) MQTT_AGENT_Delete( xMQTTHandle );
+            xMQTTHandle = NULL;
             configPRINTF( ( "ERROR:  MQTT client failed to connect with error %d.\n", xReturned ) );
         }
         else
@@ -227,41 +365,323 @@ static bool cloudConnect(UserConfig &userConfig)
 
 
 /**
- * @brief Closes an active MQTT connection.
+ * @brief Closes an active MQTT connection, and releases the client.
  */
 static void cloudDisconnect()
 {
 	MQTT_AGENT_Disconnect( xMQTTHandle, MQTT_TIMEOUT );
     MQTT_AGENT_Delete( xMQTTHandle );
+    xMQTTHandle = NULL;
     configPRINTF( ( "MQTT client disconnected.\n" ) );
 }
 
 
 /**
- * @brief Uploads the provided sensor information to the cloud server
- * @param temperature value to be uploaded
- * @param humidity value to be uploaded
- * @param pressure value to be uploaded
+ * @brief Receives events from the MQTT agent task.
+ * @note  Runs in the MQTT agent context, where agent APIs must not be called. A lost
+ * 		  connection is only flagged here, and handled by the cloud thread.
  */
-static void cloudSend(int16_t temperature, uint16_t humidity, uint16_t pressure)
+static BaseType_t cloudEventCallback(void * pvUserData, const MQTTAgentCallbackParams_t * const pxCallbackParams)
 {
-    MQTTAgentPublishParams_t xPublishParameters;
+	( void ) pvUserData;
+
+	if ( pxCallbackParams->xMQTTEvent == eMQTTAgentDisconnect ) {
+		brokerDisconnected = true;
+	}
+
+	/* Publish buffers are not retained */
+	return pdFALSE;
+}
+
+
+/**
+ * @brief Reports whether the station is currently associated with an access point.
+ */
+static bool cloudLinkUp()
+{
+	return ( WiFi.status() == enl::WiFiStatus::WL_CONNECTED );
+}
+
+
+/**
+ * @brief Reads the sensors and appends a time stamped sample to the pending batch. When the
+ * batch is already full (e.g. previous publish failed), the oldest sample is discarded.
+ * Pressure is the average of the readings buffered in the sensor FIFO since the last sample.
+ * @param hts221 temperature and humidity sensor
+ * @param lps22hb pressure sensor
+ */
+static void cloudSample(sensor::HTS221 &hts221, sensor::LPS22HB &lps22hb)
+{
+	static uint16_t pressure = 0;
+	std::array<sensor::LPS22HB::Sample_t, sensor::LPS22HB::FifoDepth> batch;
+	Sample_t sample;
+
+	size_t count = lps22hb.readBatch(batch.data(), batch.size());
+	if (count > 0) {
+		uint32_t sum = 0;
+		for (size_t index = 0; index < count; index++) {
+			sum += batch[index].pressure;
+		}
+		pressure = (sum + count / 2) / count;
+	}
+	else if (pressure == 0) {
+		/* Nothing buffered yet, take the current output value */
+		pressure = lps22hb.getPressure();
+	}
+
+	sample.time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+	sample.temperature = hts221.getTemperature();
+	sample.humidity = hts221.getHumidity();
+	sample.pressure = pressure;
+
+	if ( !samples.push(sample) ) {
+		configPRINTF( ("WARNING: telemetry queue full, oldest sample discarded\n") );
+	}
+}
+
+
+/**
+ * @brief Determines if enough samples are pending to publish; either a full batch, or the
+ * oldest sample has waited CLOUD_BATCH_MAX_AGE.
+ * @param first index of the first pending sample, skipping those already being published
+ */
+static bool cloudFlushDue(size_t first)
+{
+	if ( samples.size() <= first ) {
+		return false;
+	}
+
+	/* Compared in milliseconds, the unit of the time stamp, so the age stays correct as the
+	 * time stamp wraps */
+	uint32_t age = ( xTaskGetTickCount() * portTICK_PERIOD_MS ) - samples[first].time;
+	return ( (samples.size() - first) >= CLOUD_BATCH_SAMPLES ) ||
+			( age >= (CLOUD_BATCH_MAX_AGE * portTICK_PERIOD_MS) );
+}
+
+
+/**
+ * @brief Uploads the oldest pending sensor samples to the cloud server, as up to
+ * CLOUD_PUBLISH_WINDOW messages of CLOUD_BATCH_SAMPLES samples that are all in flight at
+ * once. Samples are released, in order, only once the broker has acknowledged the message
+ * they were sent in; the others are sent again on the next attempt.
+ * @note  Sampling is suspended until every message completes, so the queue is not modified
+ * 		  while its samples are being published. A message still in flight from an earlier
+ * 		  attempt owns its payload buffer and batch, so none are reused until it completes.
+ * @retval true if all the samples were published
+ */
+static bool cloudSend()
+{
+	size_t queued = 0;
+	size_t first = 0;
 
-    /* Format sensor values into a JSON message */
-    int32_t ret = snprintf(buf, buf_size,
-                "{\"sensor\":{\"temperature\":%i,\"humidity\":%.u,\"pressure\":%u}}",
-                temperature, humidity, pressure);
-    if(ret < 0) {
-    	configPRINTF( ("ERROR: snprintf() returns %lu.", ret) );
+	if ( !cloudAwaitBatches() ) {
+		return false;
+	}
+
+	/* Fill the window, the first batch is always sent as the flush is due */
+	while ( queued < CLOUD_PUBLISH_WINDOW && ( queued == 0 || cloudFlushDue(first) ) )
+	{
+		Batch_t &batch = batches[queued];
+		size_t length = cloudFormatBatch(buf[queued], first);
+		if (length == 0) {
+			configPRINTF( ("ERROR: JSON payload exceeds %u bytes.\n", buf_size) );
+			break;
+		}
+
+		MQTTAgentPublishParams_t xPublishParameters;
+		memset( &( xPublishParameters ), 0x00, sizeof( xPublishParameters ) );
+		xPublishParameters.pucTopic = TOPIC_NAME;
+		xPublishParameters.pvData = buf[queued];
+		xPublishParameters.usTopicLength = ( uint16_t ) strlen( ( const char * ) TOPIC_NAME );
+		xPublishParameters.ulDataLength = length;
+		xPublishParameters.xQoS = eMQTTQoS1;
+
+		batch.count = std::min<size_t>(samples.size() - first, CLOUD_BATCH_SAMPLES);
+		batch.result = eMQTTAgentFailure;
+
+		MQTTAgentReturnCode_t xReturned = MQTT_AGENT_PublishAsync( xMQTTHandle,
+										&( xPublishParameters ),
+										cloudBatchCallback,
+										&batch,
+										NULL,
+										MQTT_TIMEOUT );
+		if ( xReturned != eMQTTAgentSuccess ) {
+			configPRINTF( ("ERROR: xReturned from MQTT publish is %d\n", xReturned) );
+			break;
+		}
+
+		first += batch.count;
+		queued++;
+		batchesInFlight++;
+	}
+
+	if ( !cloudAwaitBatches() ) {
+		return false;
+	}
+
+	bool published = ( queued > 0 );
+	for (size_t index = 0; index < queued && published; index++)
+	{
+		if ( batches[index].result != eMQTTAgentSuccess ) {
+			configPRINTF( ("ERROR: MQTT publish failed with %d\n", batches[index].result) );
+			published = false;
+			break;
+		}
+
+		configPRINTF( ("Message published, %u sample(s) '%s'\n", batches[index].count, buf[index] ) );
+		for (size_t count = 0; count < batches[index].count; count++) {
+			samples.pop();
+		}
+	}
+
+	return published;
+}
+
+
+/**
+ * @brief Waits for every batch in flight to complete. One that does not is left in flight, and
+ * is waited for again before the next attempt reuses its payload buffer and batch.
+ * @retval true if no batch remains in flight
+ */
+static bool cloudAwaitBatches()
+{
+	/* Every queued publish completes, by PUBACK, timeout or disconnect, before the agent
+	 * gives up on it. The extra margin only covers time spent in the command queue. */
+	while ( batchesInFlight > 0 && batchDone.Take(2 * MQTT_TIMEOUT) ) {
+		batchesInFlight--;
+	}
+
+	if ( batchesInFlight > 0 ) {
+		configPRINTF( ("ERROR: MQTT publish did not complete\n") );
+		brokerDisconnected = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Formats pending samples into a JSON message, up to CLOUD_BATCH_SAMPLES of them.
+ * @param payload buffer of buf_size bytes
+ * @param first index of the first sample
+ * @retval message length, or 0 if it does not fit
+ */
+static size_t cloudFormatBatch(char *payload, size_t first)
+{
+    JsonWriter json(payload, buf_size);
+
+    json.beginObject().key("sensor").beginArray();
+    size_t count = std::min<size_t>(samples.size() - first, CLOUD_BATCH_SAMPLES);
+    for (size_t index = first; index < first + count; index++)
+    {
+        const Sample_t &sample = samples[index];
+
+        json.beginObject()
+            .member("time", sample.time)
+            .member("temperature", sample.temperature)
+            .member("humidity", sample.humidity)
+            .member("pressure", sample.pressure)
+            .endObject();
     }
+    json.endArray().endObject();
 
+    return json.finish();
+}
+
+
+/**
+ * @brief Receives the outcome of a batch publish from the MQTT agent task.
+ * @note  Runs in the MQTT agent context, where agent APIs must not be called.
+ */
+static void cloudBatchCallback(void * pvCallbackContext, uint32_t ulMessageId, MQTTAgentReturnCode_t xResult)
+{
+	( void ) ulMessageId;
+
+	static_cast<Batch_t *>(pvCallbackContext)->result = xResult;
+	batchDone.Give();
+}
+
+
+/**
+ * @brief Uploads the runtime statistics: per task processor load and stack usage since the
+ * previous upload, heap usage, and network buffer pool usage.
+ * @retval true if the statistics were published
+ */
+static bool cloudSendStats()
+{
+	static RunTimeStats stats;
+	HeapStats_t heap;
+	std::array<BufferPoolStats_t, 2> pool;
+
+	/* The payload buffer is shared with the sample batches */
+	if ( !stats.sample() || !cloudAwaitBatches() ) {
+		return false;
+	}
+	vPortGetHeapStats(&heap);
+	size_t poolClasses = BUFFERPOOL_GetStats(pool.data(), pool.size());
+
+	JsonWriter json(buf[0], buf_size);
+
+	json.beginObject()
+		.member("time", xTaskGetTickCount() * portTICK_PERIOD_MS)
+		.member("period", stats.periodUs() / 1000)
+		.key("load").fixed(stats.totalLoad(), 1)
+		.key("heap").beginObject()
+			.member("free", heap.xAvailableHeapSpaceInBytes)
+			.member("minimum", heap.xMinimumEverFreeBytesRemaining)
+			.member("largest", heap.xSizeOfLargestFreeBlockInBytes)
+			.member("blocks", heap.xNumberOfFreeBlocks)
+			.endObject()
+		.key("buffers").beginArray();
+
+	for (size_t index = 0; index < poolClasses; index++) {
+		json.beginObject()
+			.member("size", pool[index].ulBufferSize)
+			.member("peak", pool[index].usPeakInUse)
+			.member("failures", pool[index].ulAllocationFailures)
+			.endObject();
+	}
+	json.endArray().key("tasks").beginArray();
+
+	for (size_t index = 0; index < stats.size(); index++) {
+		const RunTimeStats::Task_t &task = stats[index];
+
+		json.beginObject()
+			.key("name").value(task.name)
+			.key("load").fixed(task.load, 1)
+			.member("stack", task.stackFree)
+			.endObject();
+	}
+	json.endArray().endObject();
+
+	size_t length = json.finish();
+	if (length == 0) {
+		configPRINTF( ("ERROR: stats payload exceeds %u bytes.\n", buf_size) );
+		return false;
+	}
+
+	return cloudPublish(STATS_TOPIC_NAME, length);
+}
+
+
+/**
+ * @brief Publishes the message held in the first payload buffer, and waits for the broker to
+ * acknowledge it.
+ * @param topic topic name
+ * @param length message length, in bytes
+ * @retval true if the message was published
+ */
+static bool cloudPublish(const uint8_t *topic, size_t length)
+{
+    MQTTAgentPublishParams_t xPublishParameters;
 
     /* Setup the publish parameters. */
     memset( &( xPublishParameters ), 0x00, sizeof( xPublishParameters ) );
-    xPublishParameters.pucTopic = TOPIC_NAME;
-    xPublishParameters.pvData = buf;
-    xPublishParameters.usTopicLength = ( uint16_t ) strlen( ( const char * ) TOPIC_NAME );
-    xPublishParameters.ulDataLength = ret;
+    xPublishParameters.pucTopic = topic;
+    xPublishParameters.pvData = buf[0];
+    xPublishParameters.usTopicLength = ( uint16_t ) strlen( ( const char * ) topic );
+    xPublishParameters.ulDataLength = length;
     xPublishParameters.xQoS = eMQTTQoS1;
 
     /* Publish the message. */
@@ -272,9 +692,8 @@ static void cloudSend(int16_t temperature, uint16_t humidity, uint16_t pressure)
     if( xReturned != eMQTTAgentSuccess )
     {
     	configPRINTF( ("ERROR: xReturned from MQTT publish is %d\n", xReturned) );
+    	return false;
     }
 
-    configPRINTF( ("Message published '%s'\n", buf ) );
+    return true;
 }
-
-
@@ -27,6 +27,7 @@
 #include <cstring>
 
 #include "device.h"
+#include "mbedtls/base64.h"
 
 #include "UserConfig.hpp"
 #include "CommandInterface.hpp"
@@ -49,6 +50,7 @@ static constexpr char cmdPrompt[] = "";
 static constexpr char cmdCloud[] = "cloud ";
 static constexpr char cmdHelp[] = "help";
 static constexpr char cmdReset[] = "reset";
+static constexpr char cmdStats[] = "stats";
 static constexpr char cmdStatus[] = "status";
 static constexpr char cmdWifi[] = "wifi ";
 static constexpr char cmdVersion[] = "version";
@@ -133,6 +135,9 @@ void CommandInterface::Run()
     		if (ParseCmdWordEnd(commandLineBuffer.cbegin(), cmdStatus)) {
     			responseId = RESPONSE_MSG_STATUS;
     		}
+    		else if (ParseCmdWordEnd(commandLineBuffer.cbegin(), cmdStats)) {
+    			responseId = RESPONSE_MSG_STATS;
+    		}
     		break;
 
     	case 'v':
@@ -364,62 +369,92 @@ ResponseId_t CommandInterface::WifiCmdHandler(Buffer_t::const_iterator first, Bu
 
 
 /**
- * @brief	Buffers and handles receiving a PEM object
- * @param	buffer is the location to hold the PEM message as its received
+ * @brief	Receives a PEM object and decodes it to DER as each line arrives. The armour lines
+ * 			are skipped and the base64 body is decoded straight into buffer, so the PEM text is
+ * 			never held in full. The object ends with a blank line.
+ * @param	buffer is the location to hold the DER object as its decoded
  * @param   length is the maximum number of bytes that will fit in buffer
- * @retval	size of PEM object received, in bytes
+ * @retval	size of DER object received, in bytes. Zero if the object was invalid or too large.
  */
 uint16_t CommandInterface::RxPEMObject(uint8_t *buffer, uint16_t length)
 {
-	Buffer_t::iterator lineEnd;
-	int32_t lineSize = 0;
-	int32_t pemSize = 0;
+	std::array<char, 4> quantum;
+	size_t quantumSize = 0;
+	size_t derSize = 0;
+	bool isValid = true;
+	bool isEnded = false;
+
+	/* Decodes whole base64 quanta, appending the result to buffer */
+	auto decode = [&](const char *source, size_t sourceSize) {
+		size_t decodedSize = 0;
+		if (mbedtls_base64_decode(buffer + derSize, length - derSize, &decodedSize,
+				reinterpret_cast<const unsigned char *>(source), sourceSize) != 0) {
+			return false;
+		}
+
+		derSize += decodedSize;
+		return true;
+	};
 
-	while (pemSize < length ){
-		std::fgets(commandLineBuffer.begin(), commandLineBuffer.size(), stdin);
+	while (true) {
+		if (std::fgets(commandLineBuffer.begin(), commandLineBuffer.size(), stdin) == nullptr) {
+			isValid = false;
+			break;
+		}
 
-		lineEnd = std::find(commandLineBuffer.begin(), commandLineBuffer.end(), '\n');
-		if (lineEnd == commandLineBuffer.cend()) {
+		Buffer_t::iterator lineEnd = std::find(commandLineBuffer.begin(), commandLineBuffer.end(), '\n');
+		if (lineEnd == commandLineBuffer.end()) {
 			/* invalid contents, missing terminator */
-			pemSize = 0;
+			isValid = false;
 			break;
 		}
 
-		lineSize = (lineEnd - commandLineBuffer.cbegin());
+		const char *line = commandLineBuffer.cbegin();
+		size_t lineSize = lineEnd - commandLineBuffer.begin();
+		if ((lineSize > 0) && (line[lineSize - 1] == '\r')) {
+			lineSize--;
+		}
 
 		if (lineSize == 0) {
 			/* Transfer complete */
-
-			/* PEM format must be null terminated, insert null terminator */
-			if ( (pemSize + 1) <= length ) {
-				buffer[pemSize] = 0;
-				pemSize++;
-			}
-			else {
-				/* Message is to large, discard  */
-				pemSize = 0;
-			}
-
 			break;
 		}
 
-		/* PEM format requires a '\n' at the end of each line, keep terminator.
-		 */
-		lineSize++;
+		if (std::strncmp(line, "-----END", 8) == 0) {
+			isEnded = true;
+		}
 
-		if ( (pemSize + lineSize) <= length ) {
-			std::memcpy(buffer + pemSize, commandLineBuffer.cbegin(), lineSize);
-			pemSize += lineSize;
+		/* Keep reading to the blank line after an error, "-----BEGIN/END" lines carry no data */
+		if (!isValid || isEnded || (std::strncmp(line, "-----", 5) == 0)) {
+			continue;
 		}
-		else {
-			/* Message is to large, discard  */
-			pemSize = 0;
-			break;
+
+		/* Complete the quantum left over from the previous line */
+		size_t fill = std::min(quantum.size() - quantumSize, lineSize);
+		std::copy_n(line, fill, quantum.begin() + quantumSize);
+		quantumSize += fill;
+		line += fill;
+		lineSize -= fill;
+
+		if (quantumSize == quantum.size()) {
+			isValid = decode(quantum.data(), quantumSize);
+			quantumSize = 0;
+
+			/* Decode the rest of the line in place, holding back a partial quantum */
+			size_t wholeSize = lineSize - (lineSize % quantum.size());
+			isValid = isValid && decode(line, wholeSize);
+
+			quantumSize = lineSize - wholeSize;
+			std::copy_n(line + wholeSize, quantumSize, quantum.begin());
 		}
+	}
 
+	if ((quantumSize != 0) || !isEnded) {
+		/* Body was truncated */
+		isValid = false;
 	}
 
-	return (uint16_t)pemSize;
+	return isValid ? (uint16_t)derSize : 0;
 }
 
 /**
@@ -7,8 +7,10 @@
 
 #include <syscalls.h>
 #include <ThreadConfig.hpp>
+#include <algorithm>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <chrono>
 
 #include "ticks.hpp"
@@ -17,9 +19,16 @@
 
 #include "UserConfig.hpp"
 #include "ResponseInterface.hpp"
+#include "RunTimeStats.hpp"
+#include "HeapManager.h"
 #include "WiFiStation.hpp"
 #include "AppVersion.hpp"
 
+extern "C" {
+#include "aws_tls.h"
+#include "aws_logging_task.h"
+}
+
 using namespace cpp_freertos;
 using namespace std;
 
@@ -32,6 +41,9 @@ using namespace std;
 /* Private variables ---------------------------------------------------------*/
 extern enl::WiFiStation WiFi;
 
+/* Shared by the status and stats commands, each reports the load since the previous report */
+static RunTimeStats runTimeStats;
+
 static void HelpHandler(void);
 static void InvalidHandler(void);
 static void PromptHandler(void);
@@ -84,6 +96,10 @@ void ResponseInterface::Run()
 		case RESPONSE_MSG_PROMPT:
 			break;
 
+		case RESPONSE_MSG_STATS:
+			StatsHandler();
+			break;
+
 		case RESPONSE_MSG_STATUS:
 			StatusHandler();
 			break;
@@ -120,6 +136,13 @@ void ResponseInterface::CloudStatusHandler(void)
 
 	std::printf("-- Cloud Status --\n");
 	std::printf("Key size: %u\n", cloud.key.size);
+
+	TLSHandshakeMetrics_t tls;
+	TLS_GetHandshakeMetrics(&tls);
+	std::printf("TLS full handshakes: %lu, last %lu ms, max %lu ms\n",
+			tls.ulFullCount, tls.ulFullLastMs, tls.ulFullMaxMs);
+	std::printf("TLS resumed handshakes: %lu, last %lu ms, max %lu ms\n",
+			tls.ulResumedCount, tls.ulResumedLastMs, tls.ulResumedMaxMs);
 	std::fflush(stdout);
 }
 
@@ -138,6 +161,7 @@ static void HelpHandler(void)
 	std::printf("%-*s %s\n", width, "cloud url <field>","Sets the hostname/endpoint URL for connecting to a cloud server.");
 	std::printf("%-*s %s\n", width, "cloud status","Reports status for the cloud connection.");
 	std::printf("%-*s %s\n", width, "reset","Full processor reset; core and peripherals, as well as external modules.");
+	std::printf("%-*s %s\n", width, "stats","Per task CPU load and stack usage, heap and queue statistics.");
 	std::printf("%-*s %s\n", width, "status","High level system information and status.");
 	std::printf("%-*s %s\n", width, "version","Report application and library version numbers.");
 	std::printf("%-*s %s\n", width, "wifi on/off","Immediately turns WiFi radio on or off.");
@@ -191,6 +215,11 @@ static void StatusHandler(void)
 	std::printf("%.2lu:", min );
 	std::printf("%.2lu\n", sec1 );
 
+	if (runTimeStats.sample()) {
+		uint32_t load = runTimeStats.totalLoad();
+		std::printf("CPU load: %lu.%lu%% over %lu ms\n", load / 10, load % 10, runTimeStats.periodUs() / 1000);
+	}
+
 	/* Report high level link status */
 	if ( WiFi.RSSI() != 0 ) {
 		std::printf("WiFi: %s, Connected, ", WiFi.SSID() );
@@ -212,6 +241,44 @@ static void StatusHandler(void)
 }
 
 
+/**
+ * @brief Reports per task processor load and stack usage since the previous report, along with
+ * heap and queue usage, for sizing stacks, the heap and queues.
+ */
+void ResponseInterface::StatsHandler(void)
+{
+	std::printf("-- Runtime Statistics --\n");
+
+	if (runTimeStats.sample()) {
+		uint32_t load = runTimeStats.totalLoad();
+		std::printf("CPU load: %lu.%lu%% over %lu ms\n", load / 10, load % 10, runTimeStats.periodUs() / 1000);
+	}
+
+	std::printf("%-*s %4s %7s %11s\n", configMAX_TASK_NAME_LEN, "Task", "Pri", "CPU", "Stack free");
+	for (size_t index = 0; index < runTimeStats.size(); index++) {
+		const RunTimeStats::Task_t &task = runTimeStats[index];
+		std::printf("%-*s %4lu %5lu.%lu%% %9lu B\n", configMAX_TASK_NAME_LEN, task.name, task.priority,
+				task.load / 10, task.load % 10, task.stackFree);
+	}
+
+	/* Fragmentation is the share of free space that is not in the largest free block */
+	HeapStats_t heap;
+	vPortGetHeapStats(&heap);
+	uint32_t fragmentation = (heap.xAvailableHeapSpaceInBytes == 0) ? 0 :
+			100 - (heap.xSizeOfLargestFreeBlockInBytes * 100ull) / heap.xAvailableHeapSpaceInBytes;
+	std::printf("Heap: %u of %u B free, %u B minimum ever\n", heap.xAvailableHeapSpaceInBytes,
+			configTOTAL_HEAP_SIZE, heap.xMinimumEverFreeBytesRemaining);
+	std::printf("Heap free blocks: %u, largest %u B, fragmentation %lu%%\n", heap.xNumberOfFreeBlocks,
+			heap.xSizeOfLargestFreeBlockInBytes, fragmentation);
+
+	UBaseType_t pending = msgHandle.NumItems();
+	std::printf("Response queue: %lu of %lu\n", pending, pending + msgHandle.NumSpacesLeft());
+	std::printf("Log messages dropped: %lu\n", ulLoggingDroppedMessages());
+
+	std::fflush(stdout);
+}
+
+
 /**
  * @brief Reports the various software version numbers.
  */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "RunTimeStats.hpp"
+
+/* Typedef -----------------------------------------------------------*/
+
+/* Define ------------------------------------------------------------*/
+
+/* Macro -------------------------------------------------------------*/
+
+/* Variables ---------------------------------------------------------*/
+
+/* Function prototypes -----------------------------------------------*/
+
+/* External functions ------------------------------------------------*/
+
+
+/**
+ * @brief Takes a new sample, replacing the previous results. The first sample covers the time
+ * since power-up. Run time is counted in microseconds and wraps every 71 minutes, samples
+ * must be taken more often for the results to be meaningful.
+ * @retval True if the results are valid.
+ */
+bool RunTimeStats::sample()
+{
+	uint32_t total = 0;
+	uint32_t idle = 0;
+	size_t found = uxTaskGetSystemState(status.data(), status.size(), &total);
+
+	period = total - lastTotal;
+	lastTotal = total;
+
+	for (size_t index = 0; index < found; index++) {
+		const TaskStatus_t &task = status[index];
+
+		/* Tasks created since the last sample started with no run time */
+		uint32_t last = 0;
+		for (size_t prior = 0; prior < count; prior++) {
+			if (previous[prior].handle == task.xHandle) {
+				last = previous[prior].runTime;
+				break;
+			}
+		}
+
+		uint32_t used = task.ulRunTimeCounter - last;
+		if (std::strcmp(task.pcTaskName, "IDLE") == 0) {
+			idle = used;
+		}
+
+		tasks[index].name = task.pcTaskName;
+		tasks[index].priority = task.uxCurrentPriority;
+		tasks[index].load = (period == 0) ? 0 : std::min<uint32_t>(1000, (used * 1000ull) / period);
+		tasks[index].stackFree = task.usStackHighWaterMark * sizeof(StackType_t);
+	}
+
+	for (size_t index = 0; index < found; index++) {
+		previous[index].handle = status[index].xHandle;
+		previous[index].runTime = status[index].ulRunTimeCounter;
+	}
+	count = found;
+
+	if ( (found == 0) || (period == 0) ) {
+		load = 0;
+		return false;
+	}
+
+	load = 1000 - std::min<uint32_t>(1000, (idle * 1000ull) / period);
+	return true;
+}
+
@@ -29,17 +29,38 @@
  *  during system initialization.
  *  - As designed, separate data spaces exist for consumers and producers. System is reentrant
  *  so long as the above limitations are observed.
+ *  - Each parameter is persisted as its own storage record, so a setter only appends the one
+ *  value that changed (see storage_record_write).
+
+ *  - Earlier firmware stored the whole table in one piece. Its values are imported into records
+ *  on first boot (see ImportLegacyConfig).
  */
 
-#include <cstdio>
+#include <algorithm>
 #include <cstring>
 
 #include "UserConfig.hpp"
 #include "UserConfig.h"
-#include "syscalls.h"
+#include "device.h"
+#include "mbedtls/base64.h"
 
 
 /* Typedef -----------------------------------------------------------*/
+/**
+ * @brief Storage record identifiers, one per configuration field. These values are persisted
+ * in flash, do not renumber.
+ */
+typedef enum : uint16_t {
+	RECORD_CLOUD_KEY_PEM = 1,		/* Retired, key now stored as DER */
+	RECORD_CLOUD_CERT_PEM = 2,		/* Retired, certificate now stored as DER */
+	RECORD_CLOUD_ENDPOINT_URL = 3,
+	RECORD_CLOUD_THING_NAME = 4,
+	RECORD_WIFI_ON = 5,
+	RECORD_WIFI_PASSWORD = 6,
+	RECORD_WIFI_SSID = 7,
+	RECORD_CLOUD_KEY = 8,
+	RECORD_CLOUD_CERT = 9
+} RecordId_t;
 
 /* Define ------------------------------------------------------------*/
 
@@ -48,55 +69,232 @@
 /* Variables ---------------------------------------------------------*/
 
 /* Function prototypes -----------------------------------------------*/
+static size_t ReadRecord(RecordId_t id, void *dest, size_t capacity);
+static bool WriteRecord(RecordId_t id, const void *source, size_t size);
+static bool RetirePemRecords(void);
+static void ImportLegacyConfig(UserConfig::Config_t *scratch);
+static size_t DecodePem(const uint8_t *pem, size_t pemSize, uint8_t *der, size_t capacity);
 
 /* External functions ------------------------------------------------*/
 
 
 
 /**
- * @brief Reads one full object worth of configuration parameters from storage, if invalid,
- * initializes to known state.
+ * @brief Loads each configuration parameter from its storage record, parameters without a
+ * valid record are initialized to zero. Storage validates the CRC of every record it returns, a
+ * torn or corrupted record reads back as never stored, and a record too long for its parameter is
+ * rejected here.
  * @param dest Is the location to load configuration data into
  */
 void UserConfig::GetConfig(Config_t *dest)
 {
-	FILE *handle = std::fopen(Device.storage, "rb");
-	size_t status = std::fread(dest, sizeof(Config_t), 1, handle);
-
-	/* Validate, when invalid initialize */
-	if    ( (handle == nullptr)
-		 || (std::ferror(handle) == 1 )
-		 || (status == 0)
-		 || (dest->tableSize != TableSize)
-		 || (dest->tableVersion > TableVersion)
+	ImportLegacyConfig(dest);
+
+	std::memset(dest, 0, sizeof(Config_t));
+	dest->tableVersion = TableVersion;
+	dest->tableSize = TableSize;
+
+	dest->cloud.key.size = ReadRecord(RECORD_CLOUD_KEY,
+			dest->cloud.key.value.data(), dest->cloud.key.value.size());
+	dest->cloud.cert.size = ReadRecord(RECORD_CLOUD_CERT,
+			dest->cloud.cert.value.data(), dest->cloud.cert.value.size());
+
+	/* Strings always retain a null terminator */
+	ReadRecord(RECORD_CLOUD_ENDPOINT_URL,
+			dest->cloud.EndpointUrl.value.data(), dest->cloud.EndpointUrl.value.size() - 1);
+	ReadRecord(RECORD_CLOUD_THING_NAME,
+			dest->cloud.ThingName.value.data(), dest->cloud.ThingName.value.size() - 1);
+
+	uint8_t isWifiOn = 0;
+	ReadRecord(RECORD_WIFI_ON, &isWifiOn, sizeof(isWifiOn));
+	dest->wifi.isWifiOn = (isWifiOn != 0);
+
+	dest->wifi.password.size = ReadRecord(RECORD_WIFI_PASSWORD,
+			dest->wifi.password.value.data(), dest->wifi.password.value.size() - 1);
+	dest->wifi.ssid.size = ReadRecord(RECORD_WIFI_SSID,
+			dest->wifi.ssid.value.data(), dest->wifi.ssid.value.size() - 1);
+}
+
+
+/**
+ * @brief Imports the table stored by earlier firmware, converting the key and certificate to
+ * DER. Only parameters without a record are written, so an interrupted import resumes on the next
+ * boot and values set since are never replaced. The table stays readable until the record log is
+ * first compacted over it.
+ * @param scratch Is working space for building each record, its contents are destroyed
+ */
+static void ImportLegacyConfig(UserConfig::Config_t *scratch)
+{
+	uint16_t length = 0;
+	const UserConfig::LegacyConfig_t *legacy =
+			static_cast<const UserConfig::LegacyConfig_t *>(storage_legacy_read(&length));
+
+	if    ( (legacy == nullptr)
+		 || (length < sizeof(UserConfig::LegacyConfig_t))
+		 || (legacy->tableSize != sizeof(UserConfig::LegacyConfig_t))
+		 || (legacy->tableVersion != UserConfig::LegacyTableVersion)
 		 ) {
-		std::memset(dest, 0, sizeof(Config_t));
-		dest->tableVersion = TableVersion;
-		dest->tableSize = TableSize;
+		return;
+	}
+
+	/* A record write that compacts the log erases the table, so it is checked before each value
+	 * is read, and values are copied out of flash before they are written */
+	auto pending = [](RecordId_t id) {
+		uint16_t unused;
+		return (storage_legacy_read(&unused) != nullptr) &&
+			   (storage_record_read(id, &unused) == nullptr);
+	};
+
+	if (pending(RECORD_CLOUD_KEY)) {
+		size_t size = DecodePem(legacy->cloud.key.value.data(),
+				std::min<size_t>(legacy->cloud.key.size, legacy->cloud.key.value.size()),
+				scratch->cloud.key.value.data(), scratch->cloud.key.value.size());
+		if (size > 0) {
+			WriteRecord(RECORD_CLOUD_KEY, scratch->cloud.key.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_CLOUD_CERT)) {
+		size_t size = DecodePem(legacy->cloud.cert.value.data(),
+				std::min<size_t>(legacy->cloud.cert.size, legacy->cloud.cert.value.size()),
+				scratch->cloud.cert.value.data(), scratch->cloud.cert.value.size());
+		if (size > 0) {
+			WriteRecord(RECORD_CLOUD_CERT, scratch->cloud.cert.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_CLOUD_ENDPOINT_URL)) {
+		const UserConfig::EndpointUrlValue_t &url = legacy->cloud.EndpointUrl.value;
+		size_t size = strnlen(url.data(), url.size());
+		if (size > 0) {
+			std::memcpy(scratch->cloud.EndpointUrl.value.data(), url.data(), size);
+			WriteRecord(RECORD_CLOUD_ENDPOINT_URL, scratch->cloud.EndpointUrl.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_CLOUD_THING_NAME)) {
+		const UserConfig::ThingNameValue_t &name = legacy->cloud.ThingName.value;
+		size_t size = strnlen(name.data(), name.size());
+		if (size > 0) {
+			std::memcpy(scratch->cloud.ThingName.value.data(), name.data(), size);
+			WriteRecord(RECORD_CLOUD_THING_NAME, scratch->cloud.ThingName.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_WIFI_PASSWORD)) {
+		const UserConfig::Password_t &password = legacy->wifi.password;
+		size_t size = std::min<size_t>(password.size, password.value.size());
+		if (size > 0) {
+			std::memcpy(scratch->wifi.password.value.data(), password.value.data(), size);
+			WriteRecord(RECORD_WIFI_PASSWORD, scratch->wifi.password.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_WIFI_SSID)) {
+		const UserConfig::Ssid_t &ssid = legacy->wifi.ssid;
+		size_t size = std::min<size_t>(ssid.size, ssid.value.size());
+		if (size > 0) {
+			std::memcpy(scratch->wifi.ssid.value.data(), ssid.value.data(), size);
+			WriteRecord(RECORD_WIFI_SSID, scratch->wifi.ssid.value.data(), size);
+		}
+	}
+
+	if (pending(RECORD_WIFI_ON)) {
+		uint8_t isWifiOn = (legacy->wifi.isWifiOn ? 1 : 0);
+		WriteRecord(RECORD_WIFI_ON, &isWifiOn, sizeof(isWifiOn));
+	}
+}
+
+
+/**
+ * @brief Decodes the base64 body of a PEM object, the text between its BEGIN and END lines.
+ * @param pem Is the PEM text
+ * @param pemSize Is the maximum length of the text
+ * @param der Is the location to decode into
+ * @param capacity Is the size of the der buffer
+ * @retval Number of bytes decoded, zero if the text is not a valid PEM object.
+ */
+static size_t DecodePem(const uint8_t *pem, size_t pemSize, uint8_t *der, size_t capacity)
+{
+	const char *text = reinterpret_cast<const char *>(pem);
+	const char *last = text + strnlen(text, pemSize);
+	const char begin[] = "-----BEGIN";
+	const char end[] = "-----END";
+
+	const char *body = std::search(text, last, begin, begin + sizeof(begin) - 1);
+	body = std::find(body, last, '\n');
+	if (body == last) {
+		return 0;
+	}
+	body++;
+
+	const char *footer = std::search(body, last, end, end + sizeof(end) - 1);
+	if (footer == last) {
+		return 0;
+	}
+
+	size_t size = 0;
+	if (mbedtls_base64_decode(der, capacity, &size, reinterpret_cast<const unsigned char *>(body),
+			footer - body) != 0) {
+		return 0;
+	}
+	return size;
+}
+
+
+/**
+ * @brief Copies the most recent value of a single parameter out of storage.
+ * @param id Identifies the parameter
+ * @param dest Is the location to copy the value into
+ * @param capacity Is the maximum number of bytes to copy
+ * @retval Number of bytes copied, zero if the parameter has never been stored or its record is
+ * longer than capacity. A truncated key or string is never loaded.
+ */
+static size_t ReadRecord(RecordId_t id, void *dest, size_t capacity)
+{
+	uint16_t length = 0;
+	const void *source = storage_record_read(id, &length);
+
+	if ( (source == nullptr) || (length > capacity) ) {
+		return 0;
 	}
 
-	std::fclose(handle);
+	std::memcpy(dest, source, length);
+	return length;
 }
 
+
 /**
- * @brief Writes one full object worth of configuration parameters into storage.
- * @param  source Is the location to write configuration data from
+ * @brief Appends a new value for a single parameter to storage, leaving the others untouched.
+ * @param id Identifies the parameter
+ * @param source Is the location of the value to be saved
+ * @param size Is how many bytes to save
  * @retval On success, true is returned. On error, false is returned.
  */
-bool UserConfig::SetConfig(std::unique_ptr<Config_t> source)
+static bool WriteRecord(RecordId_t id, const void *source, size_t size)
 {
-	_ssize_t status = 1;
+	return (storage_record_write(id, source, size) == 0);
+}
 
-	FILE *handle = std::fopen(Device.storage, "wb");
 
- 	if (handle != nullptr) {
-		std::fwrite(source.get(), sizeof(Config_t), 1, handle);
-		std::fflush(handle);
-	 	status = std::ferror(handle);
-	 	std::fclose(handle);
+/**
+ * @brief Supersedes any PEM key or certificate left by earlier firmware with an empty record.
+ * Compaction keeps the latest record of every identifier, so until then the retired values
+ * would be copied forward, occupying half a slot and leaving no room for the DER values.
+ * @retval On success, true is returned. On error, false is returned.
+ */
+static bool RetirePemRecords(void)
+{
+	for (RecordId_t id : {RECORD_CLOUD_KEY_PEM, RECORD_CLOUD_CERT_PEM}) {
+		uint16_t length = 0;
+
+		if ( (storage_record_read(id, &length) != nullptr) && (length > 0) &&
+			 !WriteRecord(id, nullptr, 0) ) {
+			return false;
+		}
 	}
 
-	return (status == 1 ? false : true);
+	return true;
 }
 
 
@@ -127,12 +325,9 @@ const UserConfig::Wifi_t & UserConfig::GetWifiConfig() const
  */
 bool UserConfig::SetCloudKey(std::unique_ptr<Key_t> newKey)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->cloud.key.value = newKey->value;
-	modify->cloud.key.size = newKey->size;
-	return SetConfig( std::move(modify) );
+	size_t size = std::min<size_t>(newKey->size, newKey->value.size());
+	return ( RetirePemRecords() &&
+			 WriteRecord(RECORD_CLOUD_KEY, newKey->value.data(), size) );
 }
 
 
@@ -143,12 +338,9 @@ bool UserConfig::SetCloudKey(std::unique_ptr<Key_t> newKey)
  */
 bool UserConfig::SetCloudCert(std::unique_ptr<Cert_t> newCert)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->cloud.cert.value = newCert->value;
-	modify->cloud.cert.size = newCert->size;
-	return SetConfig( std::move(modify) );
+	size_t size = std::min<size_t>(newCert->size, newCert->value.size());
+	return ( RetirePemRecords() &&
+			 WriteRecord(RECORD_CLOUD_CERT, newCert->value.data(), size) );
 }
 
 
@@ -159,11 +351,8 @@ bool UserConfig::SetCloudCert(std::unique_ptr<Cert_t> newCert)
  */
 bool UserConfig::SetCloudEndpointUrl(const EndpointUrlValue_t * newEndpointUrl)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->cloud.EndpointUrl.value = *newEndpointUrl;
-	return SetConfig( std::move(modify) );
+	size_t size = strnlen(newEndpointUrl->data(), newEndpointUrl->size());
+	return WriteRecord(RECORD_CLOUD_ENDPOINT_URL, newEndpointUrl->data(), size);
 }
 
 
@@ -174,11 +363,8 @@ bool UserConfig::SetCloudEndpointUrl(const EndpointUrlValue_t * newEndpointUrl)
  */
 bool UserConfig::SetCloudThingName(const ThingNameValue_t * newThingName)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->cloud.ThingName.value = *newThingName;
-	return SetConfig( std::move(modify) );
+	size_t size = strnlen(newThingName->data(), newThingName->size());
+	return WriteRecord(RECORD_CLOUD_THING_NAME, newThingName->data(), size);
 }
 
 
@@ -189,11 +375,8 @@ bool UserConfig::SetCloudThingName(const ThingNameValue_t * newThingName)
  */
 bool UserConfig::SetWifiOn(bool isWifiOn)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->wifi.isWifiOn = isWifiOn;
-	return SetConfig( std::move(modify) );
+	uint8_t value = (isWifiOn ? 1 : 0);
+	return WriteRecord(RECORD_WIFI_ON, &value, sizeof(value));
 }
 
 
@@ -205,12 +388,8 @@ bool UserConfig::SetWifiOn(bool isWifiOn)
  */
 bool UserConfig::SetWifiPassword(const PasswordValue_t *password, size_t size)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->wifi.password.value = *password;
-	modify->wifi.password.size = size;
-	return SetConfig( std::move(modify) );
+	size = std::min<size_t>(size, password->size());
+	return WriteRecord(RECORD_WIFI_PASSWORD, password->data(), size);
 }
 
 
@@ -221,12 +400,8 @@ bool UserConfig::SetWifiPassword(const PasswordValue_t *password, size_t size)
  */
 bool UserConfig::SetWifiSsid(const SsidValue_t *ssid, size_t size)
 {
-	std::unique_ptr<Config_t> modify = std::make_unique<Config_t>();
-
-	GetConfig( modify.get() );
-	modify->wifi.ssid.value = *ssid;
-	modify->wifi.ssid.size = size;
-	return SetConfig( std::move(modify) );
+	size = std::min<size_t>(size, ssid->size());
+	return WriteRecord(RECORD_WIFI_SSID, ssid->data(), size);
 }
 
 
@@ -234,7 +409,7 @@ bool UserConfig::SetWifiSsid(const SsidValue_t *ssid, size_t size)
 /**
  * @brief  Retrieves the current cloud key value
  * @param  handle is an object that contains the cloud settings
- * @param  key points to the cloud key value
+ * @param  key points to the cloud key value, DER encoded
  * @param  size is the key length in bytes
  */
 extern "C" void GetCloudKey(UCHandle handle, const uint8_t ** key, const uint16_t ** size )
@@ -248,7 +423,7 @@ extern "C" void GetCloudKey(UCHandle handle, const uint8_t ** key, const uint16_
 /**
  * @brief  Retrieves the current cloud cert value
  * @param  handle is an object that contains the cloud settings
- * @param  cert points to the cloud cert value
+ * @param  cert points to the cloud cert value, DER encoded
  * @param  size is the cert length in bytes
  */
 extern "C" void GetCloudCert(UCHandle handle, const uint8_t ** cert, const uint16_t ** size )
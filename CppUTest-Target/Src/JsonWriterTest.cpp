@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "CppUTest/TestHarness.h"
+#include "systime.h"
+#include "JsonWriter.hpp"
+
+
+
+/* Typedef -----------------------------------------------------------*/
+
+/* Define ------------------------------------------------------------*/
+
+/* Number of payloads generated when comparing encoder performance */
+#define BENCHMARK_ITERATIONS	1000
+
+/* Macro -------------------------------------------------------------*/
+
+/* Variables ---------------------------------------------------------*/
+
+/* Function prototypes -----------------------------------------------*/
+
+/* External functions ------------------------------------------------*/
+
+
+TEST_GROUP(JsonWriter) {};
+
+TEST(JsonWriter, empty)
+{
+	char buf[8];
+
+	JsonWriter json(buf, sizeof(buf));
+	json.beginObject().endObject();
+
+	CHECK( json.finish() == 2 );
+	STRCMP_EQUAL( "{}", buf );
+}
+
+
+TEST(JsonWriter, nested)
+{
+	char buf[128];
+
+	JsonWriter json(buf, sizeof(buf));
+	json.beginObject()
+		.key("a").beginArray().value(1).value(2).endArray()
+		.key("b").beginObject().member("c", true).member("d", "x\"y").endObject()
+		.endObject();
+
+	CHECK( json.finish() > 0 );
+	STRCMP_EQUAL( "{\"a\":[1,2],\"b\":{\"c\":true,\"d\":\"x\\\"y\"}}", buf );
+}
+
+
+TEST(JsonWriter, integers)
+{
+	char buf[128];
+
+	JsonWriter json(buf, sizeof(buf));
+	json.beginArray()
+		.value(static_cast<int32_t>(INT32_MIN))
+		.value(static_cast<uint32_t>(UINT32_MAX))
+		.value(static_cast<int16_t>(-1))
+		.value(0)
+		.endArray();
+
+	CHECK( json.finish() > 0 );
+	STRCMP_EQUAL( "[-2147483648,4294967295,-1,0]", buf );
+}
+
+
+TEST(JsonWriter, fixed)
+{
+	char buf[64];
+
+	JsonWriter json(buf, sizeof(buf));
+	json.beginArray().fixed(-2315, 2).fixed(7, 3).fixed(-5, 1).fixed(42, 0).endArray();
+
+	CHECK( json.finish() > 0 );
+	STRCMP_EQUAL( "[-23.15,0.007,-0.5,42]", buf );
+}
+
+
+TEST(JsonWriter, fixedLimit)
+{
+	char buf[64];
+
+	JsonWriter json(buf, sizeof(buf));
+	json.beginArray().fixed(INT32_MIN, 9).fixed(INT32_MAX, 9).fixed(1, 9).endArray();
+
+	CHECK( json.finish() > 0 );
+	STRCMP_EQUAL( "[-2.147483648,2.147483647,0.000000001]", buf );
+
+	/* 10^10 does not fit in 32-bits */
+	JsonWriter rejected(buf, sizeof(buf));
+	rejected.beginArray().fixed(1, 10).endArray();
+
+	CHECK( !rejected.ok() );
+	CHECK( rejected.finish() == 0 );
+}
+
+
+TEST(JsonWriter, overflow)
+{
+	char buf[8];
+
+	/* Exactly fits, including the terminator */
+	JsonWriter fits(buf, sizeof(buf));
+	fits.beginArray().value(12345).endArray();
+	CHECK( fits.finish() == 7 );
+	STRCMP_EQUAL( "[12345]", buf );
+
+	/* One character too many */
+	JsonWriter json(buf, sizeof(buf));
+	json.beginArray().value(123456).endArray();
+	CHECK( json.ok() == false );
+	CHECK( json.finish() == 0 );
+	STRCMP_EQUAL( "", buf );
+
+	/* Unbalanced nesting */
+	JsonWriter open(buf, sizeof(buf));
+	open.beginArray();
+	CHECK( open.finish() == 0 );
+}
+
+
+/**
+ * Compares the encoder against the snprintf() path it replaced, for the same sensor
+ * payload. Output must be identical, and the elapsed time for each is reported.
+ */
+TEST(JsonWriter, benchmark)
+{
+	char buf1[128];
+	char buf2[128];
+	uint32_t time = 123456789;
+	int16_t temperature = -12;
+	uint16_t humidity = 45;
+	uint16_t pressure = 1013;
+	size_t length1 = 0;
+	size_t length2 = 0;
+
+	/* Timed with the cycle counter based clock, the run is only a few ticks long */
+	uint32_t start = SysTime_Microseconds();
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		length1 = std::snprintf(buf1, sizeof(buf1),
+				"{\"sensor\":[{\"time\":%lu,\"temperature\":%i,\"humidity\":%u,\"pressure\":%u}]}",
+				time, temperature, humidity, pressure);
+	}
+	uint32_t elapsed1 = SysTime_Microseconds() - start;
+
+	start = SysTime_Microseconds();
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		JsonWriter json(buf2, sizeof(buf2));
+		json.beginObject().key("sensor").beginArray()
+			.beginObject()
+			.member("time", time)
+			.member("temperature", temperature)
+			.member("humidity", humidity)
+			.member("pressure", pressure)
+			.endObject()
+			.endArray().endObject();
+		length2 = json.finish();
+	}
+	uint32_t elapsed2 = SysTime_Microseconds() - start;
+
+	CHECK( length1 == length2 );
+	STRCMP_EQUAL( buf1, buf2 );
+
+	std::printf("\nJSON x%u: snprintf %lu us, JsonWriter %lu us\n", BENCHMARK_ITERATIONS,
+			(unsigned long)elapsed1, (unsigned long)elapsed2);
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "CppUTest/TestHarness.h"
+#include "systime.h"
+
+extern "C" {
+#include "aws_mqtt_topic_index.h"
+}
+
+
+
+/* Typedef -----------------------------------------------------------*/
+
+/* Define ------------------------------------------------------------*/
+
+/* Largest number of subscriptions the benchmark compares */
+#define TOPIC_INDEX_ENTRIES		256
+
+/* Nodes for the benchmark subscriptions, which take at most 3 unshared levels each */
+#define TOPIC_INDEX_NODES		( TOPIC_INDEX_ENTRIES * 3 + 1 )
+
+/* Longest topic filter used by the tests */
+#define TOPIC_FILTER_LENGTH		48
+
+/* Number of publish messages dispatched when comparing against the linear search */
+#define BENCHMARK_ITERATIONS	1000
+
+/* Macro -------------------------------------------------------------*/
+
+/* Variables ---------------------------------------------------------*/
+static MQTTTopicIndex_t topicIndex;
+static MQTTTopicNode_t topicNodes[TOPIC_INDEX_NODES];
+static MQTTTopicEntry_t topicEntries[TOPIC_INDEX_ENTRIES];
+static uint16_t topicEdges[mqtttopicindexNUM_EDGES(TOPIC_INDEX_NODES)];
+static char topicFilters[TOPIC_INDEX_ENTRIES][TOPIC_FILTER_LENGTH];
+
+/* Topic of the publish message being dispatched, and the entries it matched */
+static const char *matchTopic;
+static bool matched[TOPIC_INDEX_ENTRIES];
+static size_t matchCount;
+
+/* Function prototypes -----------------------------------------------*/
+
+/* External functions ------------------------------------------------*/
+
+
+/**
+ * Matches a topic against a topic filter one level at a time, as described by the
+ * MQTT specification. Used to check the index, and as the linear search baseline.
+ */
+static bool referenceMatch(const char *topic, const char *filter)
+{
+	while (true) {
+		size_t filterLength = std::strcspn(filter, "/");
+		if (filterLength == 1 && filter[0] == '#') {
+			return true;
+		}
+		if (topic == nullptr) {
+			return false;
+		}
+
+		size_t topicLength = std::strcspn(topic, "/");
+		bool wildCard = (filterLength == 1 && filter[0] == '+');
+		if (!wildCard && (filterLength != topicLength || std::strncmp(topic, filter, topicLength) != 0)) {
+			return false;
+		}
+
+		bool topicMore = (topic[topicLength] == '/');
+		if (filter[filterLength] != '/') {
+			return !topicMore;
+		}
+
+		filter += filterLength + 1;
+		topic = topicMore ? topic + topicLength + 1 : nullptr;
+	}
+}
+
+
+/**
+ * Records an index candidate which really matches, as the MQTT library would.
+ */
+static MQTTTopicIndexAction_t recordMatch(void *context, uint16_t entry)
+{
+	(void)context;
+
+	if (referenceMatch(matchTopic, topicFilters[entry])) {
+		CHECK( !matched[entry] );
+		matched[entry] = true;
+		matchCount++;
+	}
+	return eMQTTTopicIndexContinue;
+}
+
+
+/**
+ * Stops at the first candidate.
+ */
+static MQTTTopicIndexAction_t stopMatch(void *context, uint16_t entry)
+{
+	(void)entry;
+	(*static_cast<size_t *>(context))++;
+	return eMQTTTopicIndexStop;
+}
+
+
+static MQTTTopicIndexStatus_t insert(uint16_t entry, const char *filter)
+{
+	std::strncpy(topicFilters[entry], filter, TOPIC_FILTER_LENGTH - 1);
+	return MQTT_TopicIndexInsert(&topicIndex, entry, (const uint8_t *)topicFilters[entry],
+			(uint16_t)std::strlen(topicFilters[entry]));
+}
+
+
+/**
+ * Dispatches a topic through the index, both passes, and returns the number of matches.
+ */
+static size_t match(const char *topic)
+{
+	matchTopic = topic;
+	std::memset(matched, 0, sizeof(matched));
+	matchCount = 0;
+
+	MQTT_TopicIndexMatchSimple(&topicIndex, (const uint8_t *)topic, (uint16_t)std::strlen(topic), recordMatch, nullptr);
+	MQTT_TopicIndexMatchWildCard(&topicIndex, (const uint8_t *)topic, (uint16_t)std::strlen(topic), recordMatch, nullptr);
+	return matchCount;
+}
+
+
+TEST_GROUP(MQTTTopicIndex)
+{
+	void setup()
+	{
+		MQTT_TopicIndexInit(&topicIndex, topicNodes, TOPIC_INDEX_NODES, topicEntries, TOPIC_INDEX_ENTRIES, topicEdges);
+	}
+};
+
+
+TEST(MQTTTopicIndex, simple)
+{
+	CHECK( insert(0, "a/b/c") == eMQTTTopicIndexSuccess );
+	CHECK( insert(1, "a/b") == eMQTTTopicIndexSuccess );
+	CHECK( insert(2, "a/b/d") == eMQTTTopicIndexSuccess );
+
+	CHECK( match("a/b/c") == 1 );
+	CHECK( matched[0] );
+	CHECK( match("a/b") == 1 );
+	CHECK( matched[1] );
+	CHECK( match("a") == 0 );
+	CHECK( match("a/b/c/d") == 0 );
+	CHECK( match("a/b/") == 0 );
+}
+
+
+TEST(MQTTTopicIndex, wildCards)
+{
+	CHECK( insert(0, "sport/+") == eMQTTTopicIndexSuccess );
+	CHECK( insert(1, "sport/#") == eMQTTTopicIndexSuccess );
+	CHECK( insert(2, "+/tennis/#") == eMQTTTopicIndexSuccess );
+	CHECK( insert(3, "#") == eMQTTTopicIndexSuccess );
+	CHECK( insert(4, "sport/tennis/player1") == eMQTTTopicIndexSuccess );
+
+	/* '#' includes the parent level, '+' does not */
+	CHECK( match("sport") == 2 );
+	CHECK( matched[1] && matched[3] );
+
+	/* '+' matches an empty level */
+	CHECK( match("sport/") == 3 );
+	CHECK( matched[0] && matched[1] && matched[3] );
+
+	CHECK( match("sport/tennis/player1") == 4 );
+	CHECK( matched[1] && matched[2] && matched[3] && matched[4] );
+
+	CHECK( match("news/tennis") == 2 );
+	CHECK( matched[2] && matched[3] );
+}
+
+
+TEST(MQTTTopicIndex, stop)
+{
+	size_t calls = 0;
+
+	CHECK( insert(0, "a/+") == eMQTTTopicIndexSuccess );
+	CHECK( insert(1, "a/#") == eMQTTTopicIndexSuccess );
+	CHECK( insert(2, "+/b") == eMQTTTopicIndexSuccess );
+
+	CHECK( MQTT_TopicIndexMatchWildCard(&topicIndex, (const uint8_t *)"a/b", 3, stopMatch, &calls) == eMQTTTopicIndexStop );
+	CHECK( calls == 1 );
+}
+
+
+TEST(MQTTTopicIndex, remove)
+{
+	CHECK( insert(0, "a/b/c") == eMQTTTopicIndexSuccess );
+	CHECK( insert(1, "a/b/+") == eMQTTTopicIndexSuccess );
+	CHECK( insert(2, "a/#") == eMQTTTopicIndexSuccess );
+	CHECK( match("a/b/c") == 3 );
+
+	MQTT_TopicIndexRemove(&topicIndex, 1);
+	CHECK( match("a/b/c") == 2 );
+	CHECK( !matched[1] );
+
+	MQTT_TopicIndexRemove(&topicIndex, 0);
+	MQTT_TopicIndexRemove(&topicIndex, 2);
+	CHECK( match("a/b/c") == 0 );
+
+	/* Every node is reclaimed, so the whole index can be filled again, repeatedly */
+	for (int pass = 0; pass < 3; pass++) {
+		char filter[TOPIC_FILTER_LENGTH];
+		uint16_t entry = 0;
+
+		while (true) {
+			std::snprintf(filter, sizeof(filter), "%u/x/y/z", entry);
+			if (insert(entry, filter) != eMQTTTopicIndexSuccess) {
+				break;
+			}
+			entry++;
+		}
+		CHECK( entry == (TOPIC_INDEX_NODES - 1) / 4 );
+		CHECK( match("0/x/y/z") == 1 );
+
+		for (uint16_t index = 0; index < entry; index++) {
+			MQTT_TopicIndexRemove(&topicIndex, index);
+		}
+		CHECK( match("0/x/y/z") == 0 );
+	}
+}
+
+
+TEST(MQTTTopicIndex, limits)
+{
+	CHECK( insert(0, "1/2/3/4/5/6/7/8") == eMQTTTopicIndexSuccess );
+	CHECK( insert(1, "1/2/3/4/5/6/7/8/9") == eMQTTTopicIndexTooManyLevels );
+	CHECK( match("1/2/3/4/5/6/7/8") == 1 );
+}
+
+
+/**
+ * Dispatches publish messages against 8, 64 and 256 subscriptions, through the index
+ * and through the linear search it replaced. Matches must be identical, and the elapsed
+ * time for each is reported.
+ */
+TEST(MQTTTopicIndex, benchmark)
+{
+	static const size_t sizes[] = { 8, 64, 256 };
+	char topics[16][TOPIC_FILTER_LENGTH];
+
+	for (size_t size : sizes) {
+		MQTT_TopicIndexInit(&topicIndex, topicNodes, TOPIC_INDEX_NODES, topicEntries, TOPIC_INDEX_ENTRIES, topicEdges);
+
+		/* A mix of device shadow, command and configuration subscriptions */
+		for (uint16_t entry = 0; entry < size; entry++) {
+			char filter[TOPIC_FILTER_LENGTH];
+			unsigned device = entry / 4;
+
+			switch (entry % 4) {
+			case 0: std::snprintf(filter, sizeof(filter), "$aws/things/dev%u/shadow/update/delta", device); break;
+			case 1: std::snprintf(filter, sizeof(filter), "dev%u/cmd/+", device); break;
+			case 2: std::snprintf(filter, sizeof(filter), "dev%u/config", device); break;
+			default: std::snprintf(filter, sizeof(filter), "dev%u/ota/#", device); break;
+			}
+			CHECK( insert(entry, filter) == eMQTTTopicIndexSuccess );
+		}
+
+		for (size_t index = 0; index < 16; index++) {
+			unsigned device = (index * 7) % (size / 4);
+
+			switch (index % 4) {
+			case 0: std::snprintf(topics[index], TOPIC_FILTER_LENGTH, "$aws/things/dev%u/shadow/update/delta", device); break;
+			case 1: std::snprintf(topics[index], TOPIC_FILTER_LENGTH, "dev%u/cmd/reboot", device); break;
+			case 2: std::snprintf(topics[index], TOPIC_FILTER_LENGTH, "dev%u/ota/job/1", device); break;
+			default: std::snprintf(topics[index], TOPIC_FILTER_LENGTH, "dev%u/unknown", device); break;
+			}
+		}
+
+		/* Timed with the cycle counter based clock, a dispatch is well under the 1 ms tick */
+		size_t linearMatches = 0;
+		uint32_t start = SysTime_Microseconds();
+		for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+			const char *topic = topics[i % 16];
+			for (size_t entry = 0; entry < size; entry++) {
+				linearMatches += referenceMatch(topic, topicFilters[entry]) ? 1 : 0;
+			}
+		}
+		uint32_t elapsed1 = SysTime_Microseconds() - start;
+
+		size_t indexMatches = 0;
+		start = SysTime_Microseconds();
+		for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+			indexMatches += match(topics[i % 16]);
+		}
+		uint32_t elapsed2 = SysTime_Microseconds() - start;
+
+		CHECK( linearMatches == indexMatches );
+		CHECK( indexMatches == BENCHMARK_ITERATIONS * 3 / 4 );
+
+		std::printf("\nTopic dispatch x%u, %u subscriptions: linear %lu us, index %lu us\n",
+				BENCHMARK_ITERATIONS, (unsigned)size,
+				(unsigned long)elapsed1, (unsigned long)elapsed2);
+	}
+}
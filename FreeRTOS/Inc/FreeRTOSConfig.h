@@ -39,8 +39,8 @@
 #define configIDLE_SHOULD_YIELD                 1
 #define configUSE_TASK_NOTIFICATIONS            1
 #define configUSE_MUTEXES                       1
-#define configUSE_RECURSIVE_MUTEXES             0
-#define configUSE_COUNTING_SEMAPHORES           0
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
 #define configQUEUE_REGISTRY_SIZE               8
 #define configUSE_QUEUE_SETS                    0
 #define configUSE_TIME_SLICING                  0
@@ -60,7 +60,7 @@
 
 /* Hook function related definitions. */
 #define configUSE_IDLE_HOOK                     0
-#define configUSE_TICK_HOOK                     0
+#define configUSE_TICK_HOOK                     1
 #define configCHECK_FOR_STACK_OVERFLOW          0
 #define configUSE_MALLOC_FAILED_HOOK            0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
@@ -140,6 +140,17 @@ extern void vLoggingPrint( const char * pcMessage );
  * also defines the maximum length of each log message. */
 #define configLOGGING_MAX_MESSAGE_LENGTH            128
 
+/* Sets the size, in bytes, of the buffer holding log messages that are waiting
+ * to be formatted and output by the logging task. */
+#define configLOGGING_BUFFER_SIZE                   2048
+
+/* Set to 1 to output log messages as binary trace frames, decoded on the host
+ * by Tools/trace_decoder.py, instead of formatting them as text. */
+#define configLOGGING_BINARY_TRACE                  0
+
+/* Map the logging task's binary trace output to the board specific output. */
+#define configPRINT_BINARY( pvData, xLength )    do { fwrite( ( pvData ), 1, ( xLength ), stdout ); fflush( stdout ); } while( 0 )
+
 /* Set to 1 to prepend each log message with a message number, the task name,
  * and a time stamp. */
 #define configLOGGING_INCLUDE_TIME_AND_TASK_NAME    1
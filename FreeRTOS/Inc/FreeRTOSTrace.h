@@ -10,12 +10,13 @@
 
 /* Definitions needed when configGENERATE_RUN_TIME_STATS is on */
 #if (configGENERATE_RUN_TIME_STATS > 0)
-// HAL_GetTick is provided by the BSP maintained in in a separate build project. To avoid
-// coupling the projects and invoking nested include paths, a prototype is provided via "extern"
-// to be resolved during final link.
-extern uint32_t HAL_GetTick(void);
-#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS 				HAL_GetTick // do nothing, already setup by HAL
-#define portGET_RUN_TIME_COUNTER_VALUE                      HAL_GetTick
+// SysTime_Microseconds is provided by the HAL-Extension maintained in a separate build project. To
+// avoid coupling the projects and invoking nested include paths, a prototype is provided via "extern"
+// to be resolved during final link. Run time is counted in microseconds, and kept running between
+// context switches by the tick hook, see HeapManager.c.
+extern uint32_t SysTime_Microseconds(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS 				SysTime_Microseconds // enables the cycle counter
+#define portGET_RUN_TIME_COUNTER_VALUE                      SysTime_Microseconds
 
 #endif
 
@@ -21,6 +21,7 @@
  */
 
 #include "FreeRTOS.h"
+#include "HeapManager.h"
 static uint8_t __attribute__((section(".bigData.heap"))) ucHeap[ configTOTAL_HEAP_SIZE ];
 
 #include "..\Source\portable\MemMang\heap_4.c"
@@ -90,6 +91,66 @@ size_t ret = 0;
 
 
 
+/**
+ * @brief Reports free heap space and how it is split into free blocks
+ * @note  This is a patch on top of the standard distribution. The free list is
+ * walked with the scheduler suspended, so the cost grows with fragmentation.
+ * @param  pxHeapStats is set to the current heap state
+ */
+void vPortGetHeapStats( HeapStats_t *pxHeapStats )
+{
+BlockLink_t *pxBlock;
+size_t xBlocks = 0, xMaxSize = 0, xMinSize = ~( ( size_t ) 0 );
+
+	vTaskSuspendAll();
+	{
+		pxBlock = xStart.pxNextFreeBlock;
+
+		/* pxBlock is NULL until the first allocation initializes the heap. */
+		if( pxBlock != NULL )
+		{
+			while( pxBlock != pxEnd )
+			{
+				xBlocks++;
+
+				if( pxBlock->xBlockSize > xMaxSize )
+				{
+					xMaxSize = pxBlock->xBlockSize;
+				}
+
+				if( pxBlock->xBlockSize < xMinSize )
+				{
+					xMinSize = pxBlock->xBlockSize;
+				}
+
+				pxBlock = pxBlock->pxNextFreeBlock;
+			}
+		}
+
+		pxHeapStats->xAvailableHeapSpaceInBytes = xFreeBytesRemaining;
+		pxHeapStats->xMinimumEverFreeBytesRemaining = xMinimumEverFreeBytesRemaining;
+	}
+	( void ) xTaskResumeAll();
+
+	pxHeapStats->xSizeOfLargestFreeBlockInBytes = xMaxSize;
+	pxHeapStats->xSizeOfSmallestFreeBlockInBytes = ( xBlocks == 0 ) ? 0 : xMinSize;
+	pxHeapStats->xNumberOfFreeBlocks = xBlocks;
+}
+
+
+
+/* configUSE_TICK_HOOK is set to 1, so the application must provide an
+implementation of vApplicationTickHook(). Reading the run time counter every
+tick keeps it counting through long idle periods, as it is extended from a cycle
+counter that wraps faster than the run time statistics. */
+extern uint32_t SysTime_Microseconds(void);
+
+void vApplicationTickHook( void )
+{
+	( void ) SysTime_Microseconds();
+}
+/*-----------------------------------------------------------*/
+
 /* configSUPPORT_STATIC_ALLOCATION is set to 1, so the application must provide an
 implementation of vApplicationGetIdleTaskMemory() to provide the memory that is
 used by the Idle task. */
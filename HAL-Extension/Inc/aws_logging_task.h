@@ -37,8 +37,9 @@ extern "C" {
 #endif
 
 /*
- * Called once to create the logging task and queue.  Must be called before any
- * calls to vLoggingPrintf().
+ * Called once to create the logging task and the buffer that holds messages
+ * waiting to be output.  Must be called before any calls to vLoggingPrintf().
+ * The buffer is sized by configLOGGING_BUFFER_SIZE; uxQueueLength is not used.
  */
 BaseType_t xLoggingTaskInitialize( uint16_t usStackSize,
                                    UBaseType_t uxPriority,
@@ -54,6 +55,12 @@ BaseType_t xLoggingTaskInitialize( uint16_t usStackSize,
 void vLoggingPrintf( const char * pcFormat,
                      ... );
 
+/*
+ * Returns the number of log messages discarded because the logging buffer was
+ * full.  The count only increases, and wraps at its maximum.
+ */
+uint32_t ulLoggingDroppedMessages( void );
+
 #ifdef __cplusplus
 }
 #endif /* extern "C" */
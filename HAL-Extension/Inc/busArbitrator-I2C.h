@@ -57,10 +57,47 @@ typedef struct
 	size_t inSize;
 }BA_I2C_buffer_t;
 
+
+typedef enum
+{
+	BA_I2C_PENDING,
+	BA_I2C_COMPLETE,
+	BA_I2C_FAILED
+}BA_I2C_status_t;
+
+
+typedef struct BA_I2C_transaction BA_I2C_transaction_t;
+
+/* Completion callback, runs in interrupt context. It may submit further transactions. */
+typedef void (*BA_I2C_callback_t)( BA_I2C_transaction_t *transaction );
+
+/* A queued bus transaction. The outbound message is sent first, then when there is an inbound
+ * message it is read following a repeated start. Either message may be empty. The transaction
+ * and its buffers must remain valid until it completes. */
+struct BA_I2C_transaction
+{
+	uint16_t deviceAddr;
+	BA_I2C_buffer_t buffer;
+
+	BA_I2C_callback_t callback;
+	void *context;
+
+	/* Set by the bus arbitrator */
+	volatile BA_I2C_status_t status;
+};
+
+
+/* Maximum number of transactions queued on each bus, including the one in progress */
+#define BA_I2C_QUEUE_DEPTH 8
+
+
 void BA_I2C_init( BA_I2C_descriptor_t bus );
 void BA_I2C_read( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer);
 void BA_I2C_write( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer);
 
+int BA_I2C_submit( BA_I2C_descriptor_t bus, BA_I2C_transaction_t *transaction );
+void BA_I2C_cancel( BA_I2C_descriptor_t bus, BA_I2C_transaction_t *transaction );
+
 
 #ifdef __cplusplus
 }
@@ -37,7 +37,7 @@ _ssize_t usb1_write_r(struct _reent *ptr, int fd, const void *buf, size_t len);
 _ssize_t usb1_read_r (struct _reent *ptr, int fd, void *buf, size_t len);
 
 void SYS_CDC_TxCompleteIsr(void);
-void SYS_CDC_RxMessageIsr(uint32_t length);
+void SYS_CDC_RxMessageIsr(const uint8_t *buf, uint32_t length);
 
 
 int storage_open_r(struct _reent *ptr, int fd, int flags, int mode);
@@ -45,7 +45,12 @@ int storage_close_r(struct _reent *ptr, int fd);
 _ssize_t storage_write_r(struct _reent *ptr, int fd, const void *buf, size_t len);
 _ssize_t storage_read_r (struct _reent *ptr, int fd, void *buf, size_t len);
 
+int storage_record_write(uint16_t id, const void *buf, uint16_t len);
+const void * storage_record_read(uint16_t id, uint16_t *len);
+const void * storage_legacy_read(uint16_t *len);
+
 uint32_t crc_mpeg2(uint8_t *first, uint8_t *last);
+uint32_t crc_mpeg2_software(uint8_t *first, uint8_t *last);
 
 #ifdef __cplusplus
 } /* extern "C" */
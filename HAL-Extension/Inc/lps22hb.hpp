@@ -35,6 +35,15 @@ namespace sensor
 class LPS22HB
 {
 public:
+	/* One FIFO entry, in the same units as getTemperature() and getPressure() */
+	typedef struct {
+		int16_t temperature;
+		uint16_t pressure;
+	} Sample_t;
+
+	/* Number of samples the device FIFO holds */
+	static constexpr size_t FifoDepth = 32;
+
 	LPS22HB(BA_I2C_descriptor_t );
 	~LPS22HB();
 
@@ -42,6 +51,9 @@ public:
 	int16_t getTemperature();
 	uint16_t getPressure();
 
+	bool enableFifo(uint8_t watermark);
+	size_t readBatch(Sample_t *samples, size_t count);
+
 	bool connected();
 	operator bool();
 
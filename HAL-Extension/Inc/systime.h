@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SYSTIME_H_
+#define SYSTIME_H_
+
+#ifdef __cplusplus
+
+#include <cstdint>
+extern "C" {
+
+#else
+
+#include <stdint.h>
+
+#endif
+
+
+uint32_t SysTime_Cycles(void);
+uint32_t SysTime_CyclesPerUs(void);
+uint32_t SysTime_CyclesToUs(uint32_t cycles);
+void SysTime_DelayUs(uint32_t us);
+uint32_t SysTime_Microseconds(void);
+
+#ifdef __cplusplus
+}
+#endif /* extern "C" */
+
+#endif /* SYSTIME_H_ */
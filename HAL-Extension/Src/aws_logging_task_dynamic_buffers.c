@@ -30,7 +30,7 @@
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
+#include "message_buffer.h"
 
 /* Logging includes. */
 #include "aws_logging_task.h"
@@ -38,6 +38,7 @@
 /* Standard includes. */
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 
 /* Sanity check all the definitions required by this file are set. */
@@ -53,8 +54,89 @@
     #error configLOGGING_INCLUDE_TIME_AND_TASK_NAME must be defined in FreeRTOSConfig.h to use this logging file.  Set configLOGGING_INCLUDE_TIME_AND_TASK_NAME to 1 to prepend a time stamp, message number and the name of the calling task to each logged message.  Otherwise set to 0.
 #endif
 
+#ifndef configLOGGING_BUFFER_SIZE
+    #error configLOGGING_BUFFER_SIZE must be defined in FreeRTOSConfig.h to use this logging file.  configLOGGING_BUFFER_SIZE sets the size, in bytes, of the buffer that holds log records waiting to be formatted and output.
+#endif
+
+#ifndef configLOGGING_BINARY_TRACE
+    #define configLOGGING_BINARY_TRACE    0
+#endif
+
+#if ( configLOGGING_BINARY_TRACE == 1 ) && !defined( configPRINT_BINARY )
+    #error configPRINT_BINARY( pvData, xLength ) must be defined in FreeRTOSConfig.h to use binary trace logging.  Set configPRINT_BINARY( pvData, xLength ) to a function that outputs xLength bytes from pvData.
+#endif
+
+#if ( configSUPPORT_STATIC_ALLOCATION != 1 )
+    #error configSUPPORT_STATIC_ALLOCATION must be set to 1 to use this logging file.
+#endif
+
 /* A block time of 0 just means don't block. */
-#define loggingDONT_BLOCK    0
+#define loggingDONT_BLOCK              0
+
+/* The number of bytes of serialised arguments a single record can carry. */
+#define loggingMAX_ARGUMENT_LENGTH     configLOGGING_MAX_MESSAGE_LENGTH
+
+/* The longest conversion specification, such as "%-08.3lu", that is formatted. */
+#define loggingMAX_SPECIFIER_LENGTH    16
+
+/* Binary trace frame types, see prvOutputRecord(). */
+#define loggingFRAME_RECORD            0x01
+#define loggingFRAME_TASK_NAME         0x02
+#define loggingFRAME_DROPPED           0x03
+
+/* The number of task handles whose names have been sent to the decoder. */
+#define loggingMAX_KNOWN_TASKS         16
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The class of a conversion argument, which decides both how it is read from
+ * the caller's argument list and how it is stored in the log record.
+ */
+typedef enum LoggingArgument
+{
+    eLoggingArgNone,     /* %% or a conversion that cannot be deferred. */
+    eLoggingArgInt,      /* %d %i %u %o %x %X %c, and the hh and h lengths. */
+    eLoggingArgLong,     /* The l length. */
+    eLoggingArgLongLong, /* The ll and j lengths. */
+    eLoggingArgSize,     /* The z and t lengths. */
+    eLoggingArgDouble,   /* %f %F %e %E %g %G %a %A. */
+    eLoggingArgPointer,  /* %p. */
+    eLoggingArgString    /* %s, copied into the record. */
+} LoggingArgument_t;
+
+/*
+ * One conversion specification found in a format string.
+ */
+typedef struct LoggingConversion
+{
+    const char * pcStart;        /* The '%' that starts the specification. */
+    size_t xLength;              /* Length of the specification, including the '%'. */
+    UBaseType_t uxStars;         /* Number of '*' width and precision arguments. */
+    LoggingArgument_t eArgument; /* The class of the converted argument. */
+} LoggingConversion_t;
+
+/*
+ * The fixed part of a log record.  It is followed by the raw arguments, in
+ * the order the format string consumes them.
+ */
+typedef struct LoggingRecordHeader
+{
+    const char * pcFormat; /* NULL when the record carries a vLoggingPrint() string. */
+    uint32_t ulMessageNumber;
+    TickType_t xTickCount;
+    #if ( configLOGGING_BINARY_TRACE == 1 )
+        TaskHandle_t xTask; /* The decoder is sent each task's name once. */
+    #else
+        char cTaskName[ configMAX_TASK_NAME_LEN ];
+    #endif
+} LoggingRecordHeader_t;
+
+typedef struct LoggingRecord
+{
+    LoggingRecordHeader_t xHeader;
+    uint8_t ucArguments[ loggingMAX_ARGUMENT_LENGTH ];
+} LoggingRecord_t;
 
 /*-----------------------------------------------------------*/
 
@@ -64,21 +146,89 @@
  * outputting the log message having to wait for the message to be completely
  * written.  Using a separate task also serialises access to the output port.
  *
- * The structure of this task is very simple; it blocks on a queue to wait for
- * a pointer to a string, sending any received strings to a macro that performs
- * the actual output.  The macro is port specific, so implemented outside of
- * this file.  This version uses dynamic memory, so the buffer that contained
- * the log message is freed after it has been output.
+ * The structure of this task is very simple; it blocks on a message buffer to
+ * wait for the next log record, formats it into a static buffer and sends the
+ * result to a macro that performs the actual output.  The macro is port
+ * specific, so implemented outside of this file.
  */
 static void prvLoggingTask( void * pvParameters );
 
+/*
+ * Finds the next conversion specification in a format string.  Returns a
+ * pointer to the character after the specification, or NULL if there are no
+ * more specifications or the next one cannot be deferred.  Either way
+ * pxConversion->pcStart marks the end of the literal text before it.
+ */
+static const char * prvNextConversion( const char * pcFormat,
+                                       LoggingConversion_t * pxConversion );
+
+/*
+ * Copies the arguments consumed by pcFormat into the record, returning the
+ * number of argument bytes written.
+ */
+static size_t prvSerialiseArguments( uint8_t * pucArguments,
+                                     const char * pcFormat,
+                                     va_list args );
+
+/*
+ * Outputs a record received from the message buffer, either formatted as
+ * text or, with configLOGGING_BINARY_TRACE, as a binary trace frame.
+ */
+static void prvOutputRecord( const LoggingRecord_t * pxRecord,
+                             size_t xArgumentLength );
+
+/*
+ * Reports that ulDropped messages were discarded since the last report.
+ */
+static void prvOutputDropped( uint32_t ulDropped );
+
+#if ( configLOGGING_BINARY_TRACE == 1 )
+
+/*
+ * Sends one binary trace frame: the frame type followed by xLength bytes,
+ * COBS encoded and terminated by a zero byte.
+ */
+    static void prvOutputFrame( uint8_t ucType,
+                                const void * pvData,
+                                size_t xLength );
+
+#else
+
+/*
+ * Formats a record received from the message buffer, returning the length of
+ * the text written to pcPrintString.
+ */
+    static size_t prvFormatRecord( char * pcPrintString,
+                                   const LoggingRecord_t * pxRecord,
+                                   size_t xArgumentLength );
+
+#endif /* if ( configLOGGING_BINARY_TRACE == 1 ) */
+
+/*
+ * Sends a record to the logging task, or counts it as dropped if there is not
+ * enough space in the message buffer.
+ */
+static void prvSendRecord( LoggingRecord_t * pxRecord,
+                           size_t xArgumentLength );
+
 /*-----------------------------------------------------------*/
 
 /*
- * The queue used to pass pointers to log messages from the task that created
- * the message to the task that will performs the output.
+ * The message buffer used to pass log records from the tasks that log to the
+ * task that performs the output, and its statically allocated storage.  A
+ * message buffer supports a single writer, so writers take turns by
+ * suspending the scheduler; neither side ever allocates memory or takes a lock
+ * the other side could be waiting on.
  */
-static QueueHandle_t xQueue = NULL;
+static MessageBufferHandle_t xMessageBuffer = NULL;
+static StaticMessageBuffer_t xMessageBufferStruct;
+static uint8_t ucMessageBufferStorage[ configLOGGING_BUFFER_SIZE + 1 ];
+
+/* Number of the next message, and the number of messages dropped because the
+ * message buffer was full.  Both are only written with the scheduler
+ * suspended. */
+static uint32_t ulMessageNumber = 0;
+static volatile uint32_t ulDroppedMessages = 0;
 
 /*-----------------------------------------------------------*/
 
@@ -88,13 +238,19 @@ BaseType_t xLoggingTaskInitialize( uint16_t usStackSize,
 {
     BaseType_t xReturn = pdFAIL;
 
+    /* The buffer is sized in bytes by configLOGGING_BUFFER_SIZE, rather than
+     * in messages, so the queue length is no longer used. */
+    ( void ) uxQueueLength;
+
     /* Ensure the logging task has not been created already. */
-    if( xQueue == NULL )
+    if( xMessageBuffer == NULL )
     {
-        /* Create the queue used to pass pointers to strings to the logging task. */
-        xQueue = xQueueCreate( uxQueueLength, sizeof( char ** ) );
+        /* Create the message buffer used to pass log records to the logging task. */
+        xMessageBuffer = xMessageBufferCreateStatic( sizeof( ucMessageBufferStorage ),
+                                                     ucMessageBufferStorage,
+                                                     &xMessageBufferStruct );
 
-        if( xQueue != NULL )
+        if( xMessageBuffer != NULL )
         {
             if( xTaskCreate( prvLoggingTask, "Logging", usStackSize, NULL, uxPriority, NULL ) == pdPASS )
             {
@@ -102,8 +258,9 @@ BaseType_t xLoggingTaskInitialize( uint16_t usStackSize,
             }
             else
             {
-                /* Could not create the task, so delete the queue again. */
-                vQueueDelete( xQueue );
+                /* Could not create the task, so delete the message buffer again. */
+                vMessageBufferDelete( xMessageBuffer );
+                xMessageBuffer = NULL;
             }
         }
     }
@@ -112,143 +269,731 @@ BaseType_t xLoggingTaskInitialize( uint16_t usStackSize,
 }
 /*-----------------------------------------------------------*/
 
+uint32_t ulLoggingDroppedMessages( void )
+{
+    return ulDroppedMessages;
+}
+/*-----------------------------------------------------------*/
+
 static void prvLoggingTask( void * pvParameters )
 {
-    char * pcReceivedString = NULL;
+    /* Static so the record is not taken from the logging task's stack. */
+    static LoggingRecord_t xRecord;
+    uint32_t ulReportedDropped = 0;
+    uint32_t ulDropped;
+    size_t xReceived;
+
+    ( void ) pvParameters;
 
     for( ; ; )
     {
-        /* Block to wait for the next string to print. */
-        if( xQueueReceive( xQueue, &pcReceivedString, portMAX_DELAY ) == pdPASS )
+        /* Block to wait for the next record to print. */
+        xReceived = xMessageBufferReceive( xMessageBuffer, &xRecord, sizeof( xRecord ), portMAX_DELAY );
+
+        if( xReceived >= sizeof( xRecord.xHeader ) )
+        {
+            prvOutputRecord( &xRecord, xReceived - sizeof( xRecord.xHeader ) );
+        }
+
+        /* Report any messages that were lost since the last report. */
+        ulDropped = ulDroppedMessages;
+
+        if( ulDropped != ulReportedDropped )
         {
-            configPRINT_STRING( pcReceivedString );
-            vPortFree( ( void * ) pcReceivedString );
+            prvOutputDropped( ulDropped - ulReportedDropped );
+            ulReportedDropped = ulDropped;
         }
     }
 }
 /*-----------------------------------------------------------*/
 
-/*!
- * \brief Formats a string to be printed and sends it
- * to the print queue.
- *
- * Appends the message number, time (in ticks), and task
- * that called vLoggingPrintf to the beginning of each
- * print statement.
+#if ( configLOGGING_BINARY_TRACE == 1 )
+
+/*
+ * In binary trace mode nothing is formatted on the target.  Each record is
+ * sent as it was captured, and Tools/trace_decoder.py rebuilds the text using
+ * the format string found at the record's pcFormat address in the ELF file.
+ * Frames are COBS encoded, so a zero byte always marks the end of a frame and
+ * the decoder can start reading at any point in the stream.  All values are
+ * little endian and the record layout matches LoggingRecord_t:
  *
+ *   0x01 record:    format address, message number, tick count, task handle,
+ *                   then the arguments as laid out by prvSerialiseArguments().
+ *   0x02 task name: task handle, then the name without a terminator.
+ *   0x03 dropped:   number of messages dropped since the last report.
  */
-void vLoggingPrintf( const char * pcFormat,
-                     ... )
-{
-    size_t xLength = 0;
-    int32_t xLength2 = 0;
-    va_list args;
-    char * pcPrintString = NULL;
+    static void prvOutputRecord( const LoggingRecord_t * pxRecord,
+                                 size_t xArgumentLength )
+    {
+        static TaskHandle_t xKnownTasks[ loggingMAX_KNOWN_TASKS ];
+        static UBaseType_t uxNextKnownTask = 0;
+        struct
+        {
+            TaskHandle_t xTask;
+            char cTaskName[ configMAX_TASK_NAME_LEN ];
+        }
+        xTaskName;
+        UBaseType_t uxIndex;
 
-    /* The queue is created by xLoggingTaskInitialize().  Check
-     * xLoggingTaskInitialize() has been called. */
-    configASSERT( xQueue );
+        /* Tasks in this application are never deleted, so the name can still be
+         * read from the handle when the record is output. */
+        if( pxRecord->xHeader.xTask != NULL )
+        {
+            for( uxIndex = 0; uxIndex < loggingMAX_KNOWN_TASKS; uxIndex++ )
+            {
+                if( xKnownTasks[ uxIndex ] == pxRecord->xHeader.xTask )
+                {
+                    break;
+                }
+            }
 
-    /* Allocate a buffer to hold the log message. */
-    pcPrintString = pvPortMalloc( configLOGGING_MAX_MESSAGE_LENGTH );
+            if( uxIndex == loggingMAX_KNOWN_TASKS )
+            {
+                xTaskName.xTask = pxRecord->xHeader.xTask;
+                strncpy( xTaskName.cTaskName, pcTaskGetName( xTaskName.xTask ), configMAX_TASK_NAME_LEN );
+                prvOutputFrame( loggingFRAME_TASK_NAME, &xTaskName,
+                                sizeof( xTaskName.xTask ) + strnlen( xTaskName.cTaskName, configMAX_TASK_NAME_LEN ) );
+
+                xKnownTasks[ uxNextKnownTask ] = xTaskName.xTask;
+                uxNextKnownTask = ( uxNextKnownTask + 1 ) % loggingMAX_KNOWN_TASKS;
+            }
+        }
 
-    if( pcPrintString != NULL )
+        prvOutputFrame( loggingFRAME_RECORD, pxRecord, sizeof( pxRecord->xHeader ) + xArgumentLength );
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvOutputDropped( uint32_t ulDropped )
     {
-        /* There are a variable number of parameters. */
-        va_start( args, pcFormat );
+        prvOutputFrame( loggingFRAME_DROPPED, &ulDropped, sizeof( ulDropped ) );
+    }
+/*-----------------------------------------------------------*/
 
-        if( strcmp( pcFormat, "\n" ) != 0 )
+    static void prvOutputFrame( uint8_t ucType,
+                                const void * pvData,
+                                size_t xLength )
+    {
+        /* One type byte, the data, one overhead byte per 254 bytes and the
+         * terminating zero. */
+        static uint8_t ucFrame[ sizeof( LoggingRecord_t ) + ( sizeof( LoggingRecord_t ) / 254 ) + 4 ];
+        const uint8_t * pucData = ( const uint8_t * ) pvData;
+        size_t xCodeIndex = 0;
+        size_t xWrite = 1;
+        size_t xRead;
+        uint8_t ucCode = 1;
+        uint8_t ucByte;
+
+        for( xRead = 0; xRead <= xLength; xRead++ )
         {
-            #if ( configLOGGING_INCLUDE_TIME_AND_TASK_NAME == 1 )
-                {
-                    const char * pcTaskName;
-                    const char * pcNoTask = "None";
-                    static BaseType_t xMessageNumber = 0;
-
-                    /* Add a time stamp and the name of the calling task to the
-                     * start of the log. */
-                    if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
-                    {
-                        pcTaskName = pcTaskGetName( NULL );
-                    }
-                    else
-                    {
-                        pcTaskName = pcNoTask;
-                    }
-
-                    xLength = snprintf( pcPrintString, configLOGGING_MAX_MESSAGE_LENGTH, "%lu %lu [%s] ",
-                                        xMessageNumber++,
-                                        ( unsigned long ) xTaskGetTickCount(),
-                                        pcTaskName );
-                }
-            #else /* if ( configLOGGING_INCLUDE_TIME_AND_TASK_NAME == 1 ) */
+            ucByte = ( xRead == 0 ) ? ucType : pucData[ xRead - 1 ];
+
+            if( ucByte == 0 )
+            {
+                ucFrame[ xCodeIndex ] = ucCode;
+                xCodeIndex = xWrite++;
+                ucCode = 1;
+            }
+            else
+            {
+                ucFrame[ xWrite++ ] = ucByte;
+                ucCode++;
+
+                if( ucCode == 0xFF )
                 {
-                    xLength = 0;
+                    ucFrame[ xCodeIndex ] = ucCode;
+                    xCodeIndex = xWrite++;
+                    ucCode = 1;
                 }
-            #endif /* if ( configLOGGING_INCLUDE_TIME_AND_TASK_NAME == 1 ) */
+            }
         }
 
-        xLength2 = vsnprintf( pcPrintString + xLength, configLOGGING_MAX_MESSAGE_LENGTH - xLength, pcFormat, args );
+        ucFrame[ xCodeIndex ] = ucCode;
+        ucFrame[ xWrite++ ] = 0;
+
+        configPRINT_BINARY( ucFrame, xWrite );
+    }
+/*-----------------------------------------------------------*/
+
+#else /* if ( configLOGGING_BINARY_TRACE == 1 ) */
+
+    static void prvOutputRecord( const LoggingRecord_t * pxRecord,
+                                 size_t xArgumentLength )
+    {
+        /* Static so the text is not taken from the logging task's stack. */
+        static char cPrintString[ configLOGGING_MAX_MESSAGE_LENGTH ];
 
-        if( xLength2 < 0 )
+        if( prvFormatRecord( cPrintString, pxRecord, xArgumentLength ) > 0 )
         {
-            /* vsnprintf() failed. Restore the terminating NULL
-             * character of the first part. Note that the first
-             * part of the buffer may be empty if the value of
-             * configLOGGING_INCLUDE_TIME_AND_TASK_NAME is not
-             * 1 and as a result, the whole buffer may be empty.
-             * That's the reason we have a check for xLength > 0
-             * before sending the buffer to the logging task.
-             */
-            xLength2 = 0;
-            pcPrintString[ xLength ] = '\0';
+            configPRINT_STRING( cPrintString );
         }
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvOutputDropped( uint32_t ulDropped )
+    {
+        char cPrintString[ 32 ];
+
+        snprintf( cPrintString, sizeof( cPrintString ), "%lu log messages dropped\r\n",
+                  ( unsigned long ) ulDropped );
+        configPRINT_STRING( cPrintString );
+    }
+/*-----------------------------------------------------------*/
 
-        xLength += ( size_t ) xLength2;
-        va_end( args );
+#endif /* if ( configLOGGING_BINARY_TRACE == 1 ) */
+
+static const char * prvNextConversion( const char * pcFormat,
+                                       LoggingConversion_t * pxConversion )
+{
+    const char * pc = strchr( pcFormat, '%' );
+
+    pxConversion->uxStars = 0;
+    pxConversion->eArgument = eLoggingArgNone;
+    pxConversion->xLength = 0;
+
+    if( pc == NULL )
+    {
+        /* No more specifications, so the rest of the format is literal text. */
+        pxConversion->pcStart = pcFormat + strlen( pcFormat );
+        return NULL;
+    }
+
+    pxConversion->pcStart = pc++;
+
+    if( *pc == '%' )
+    {
+        pxConversion->xLength = 2;
+        return pc + 1;
+    }
+
+    /* Flags. */
+    while( ( *pc != '\0' ) && ( strchr( "-+ #0", *pc ) != NULL ) )
+    {
+        pc++;
+    }
+
+    /* Field width. */
+    if( *pc == '*' )
+    {
+        pxConversion->uxStars++;
+        pc++;
+    }
 
-        /* Only send the buffer to the logging task if it is
-         * not empty. */
-        if( xLength > 0 )
+    while( ( *pc >= '0' ) && ( *pc <= '9' ) )
+    {
+        pc++;
+    }
+
+    /* Precision. */
+    if( *pc == '.' )
+    {
+        pc++;
+
+        if( *pc == '*' )
+        {
+            pxConversion->uxStars++;
+            pc++;
+        }
+
+        while( ( *pc >= '0' ) && ( *pc <= '9' ) )
         {
-            /* Send the string to the logging task for IO. */
-            if( xQueueSend( xQueue, &pcPrintString, loggingDONT_BLOCK ) != pdPASS )
+            pc++;
+        }
+    }
+
+    /* Length modifier, then the conversion itself. */
+    switch( *pc )
+    {
+        case 'h':
+            pc += ( pc[ 1 ] == 'h' ) ? 2 : 1;
+            pxConversion->eArgument = eLoggingArgInt;
+            break;
+
+        case 'l':
+
+            if( pc[ 1 ] == 'l' )
+            {
+                pc += 2;
+                pxConversion->eArgument = eLoggingArgLongLong;
+            }
+            else
             {
-                /* The buffer was not sent so must be freed again. */
-                vPortFree( ( void * ) pcPrintString );
+                pc += 1;
+                pxConversion->eArgument = eLoggingArgLong;
             }
+
+            break;
+
+        case 'j':
+            pc++;
+            pxConversion->eArgument = eLoggingArgLongLong;
+            break;
+
+        case 'z':
+        case 't':
+            pc++;
+            pxConversion->eArgument = eLoggingArgSize;
+            break;
+
+        default:
+            pxConversion->eArgument = eLoggingArgInt;
+            break;
+    }
+
+    switch( *pc )
+    {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            break;
+
+        case 'c':
+            pxConversion->eArgument = eLoggingArgInt;
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            pxConversion->eArgument = eLoggingArgDouble;
+            break;
+
+        case 'p':
+            pxConversion->eArgument = eLoggingArgPointer;
+            break;
+
+        case 's':
+            pxConversion->eArgument = eLoggingArgString;
+            break;
+
+        default:
+
+            /* %n, long double and anything unrecognised cannot be deferred, so
+             * formatting stops at this specification. */
+            pxConversion->eArgument = eLoggingArgNone;
+            return NULL;
+    }
+
+    pxConversion->xLength = ( size_t ) ( pc + 1 - pxConversion->pcStart );
+
+    return pc + 1;
+}
+/*-----------------------------------------------------------*/
+
+/* Appends a value to the record if there is room for it. */
+#define loggingPUT( xValue )                                              \
+    do {                                                                  \
+        if( ( xLength + sizeof( xValue ) ) > loggingMAX_ARGUMENT_LENGTH ) \
+        {                                                                 \
+            return xLength;                                               \
+        }                                                                 \
+        memcpy( &pucArguments[ xLength ], &( xValue ), sizeof( xValue ) ); \
+        xLength += sizeof( xValue );                                      \
+    } while( 0 )
+
+static size_t prvSerialiseArguments( uint8_t * pucArguments,
+                                     const char * pcFormat,
+                                     va_list args )
+{
+    LoggingConversion_t xConversion;
+    size_t xLength = 0;
+    UBaseType_t uxStar;
+
+    while( ( pcFormat = prvNextConversion( pcFormat, &xConversion ) ) != NULL )
+    {
+        for( uxStar = 0; uxStar < xConversion.uxStars; uxStar++ )
+        {
+            int lStar = va_arg( args, int );
+            loggingPUT( lStar );
         }
-        else
+
+        switch( xConversion.eArgument )
         {
-            /* The buffer was not sent, so it must be
-             * freed. */
-            vPortFree( ( void * ) pcPrintString );
+            case eLoggingArgInt:
+               {
+                   int lValue = va_arg( args, int );
+                   loggingPUT( lValue );
+               }
+               break;
+
+            case eLoggingArgLong:
+               {
+                   long lValue = va_arg( args, long );
+                   loggingPUT( lValue );
+               }
+               break;
+
+            case eLoggingArgLongLong:
+               {
+                   long long llValue = va_arg( args, long long );
+                   loggingPUT( llValue );
+               }
+               break;
+
+            case eLoggingArgSize:
+               {
+                   size_t xValue = va_arg( args, size_t );
+                   loggingPUT( xValue );
+               }
+               break;
+
+            case eLoggingArgDouble:
+               {
+                   double dValue = va_arg( args, double );
+                   loggingPUT( dValue );
+               }
+               break;
+
+            case eLoggingArgPointer:
+               {
+                   void * pvValue = va_arg( args, void * );
+                   loggingPUT( pvValue );
+               }
+               break;
+
+            case eLoggingArgString:
+               {
+                   /* The string may live on the caller's stack, so it is copied
+                    * rather than referenced, truncated to fit the record. */
+                   const char * pcValue = va_arg( args, const char * );
+                   size_t xCopy;
+
+                   if( pcValue == NULL )
+                   {
+                       pcValue = "(null)";
+                   }
+
+                   if( xLength >= loggingMAX_ARGUMENT_LENGTH )
+                   {
+                       return xLength;
+                   }
+
+                   xCopy = strnlen( pcValue, loggingMAX_ARGUMENT_LENGTH - xLength - 1 );
+                   memcpy( &pucArguments[ xLength ], pcValue, xCopy );
+                   pucArguments[ xLength + xCopy ] = '\0';
+                   xLength += xCopy + 1;
+               }
+               break;
+
+            case eLoggingArgNone:
+            default:
+                break;
         }
     }
+
+    return xLength;
 }
+
+#undef loggingPUT
 /*-----------------------------------------------------------*/
 
-void vLoggingPrint( const char * pcMessage )
+#if ( configLOGGING_BINARY_TRACE != 1 )
+
+/* Reads a value back out of the record, ending formatting if it is missing. */
+#define loggingGET( xValue )                                         \
+    do {                                                             \
+        if( ( xOffset + sizeof( xValue ) ) > xArgumentLength )       \
+        {                                                            \
+            return xLength;                                          \
+        }                                                            \
+        memcpy( &( xValue ), &pucArguments[ xOffset ], sizeof( xValue ) ); \
+        xOffset += sizeof( xValue );                                 \
+    } while( 0 )
+
+/* Formats one conversion, passing any '*' width and precision before it. */
+#define loggingFORMAT( xValue )                                                                                  \
+    ( ( xConversion.uxStars == 0 ) ? snprintf( pcOut, xRemaining, cSpecifier, xValue ) :                           \
+      ( xConversion.uxStars == 1 ) ? snprintf( pcOut, xRemaining, cSpecifier, lStars[ 0 ], xValue ) :              \
+      snprintf( pcOut, xRemaining, cSpecifier, lStars[ 0 ], lStars[ 1 ], xValue ) )
+
+static size_t prvFormatRecord( char * pcPrintString,
+                               const LoggingRecord_t * pxRecord,
+                               size_t xArgumentLength )
 {
-    char * pcPrintString = NULL;
+    const uint8_t * pucArguments = pxRecord->ucArguments;
+    const char * pcFormat = pxRecord->xHeader.pcFormat;
+    const char * pcNext;
+    LoggingConversion_t xConversion;
+    char cSpecifier[ loggingMAX_SPECIFIER_LENGTH ];
+    int lStars[ 2 ] = { 0, 0 };
     size_t xLength = 0;
+    size_t xOffset = 0;
+    UBaseType_t uxStar;
 
-    /* The queue is created by xLoggingTaskInitialize().  Check
-     * xLoggingTaskInitialize() has been called. */
-    configASSERT( xQueue );
+    pcPrintString[ 0 ] = '\0';
+
+    /* Strings from vLoggingPrint() are output as they are. */
+    if( pcFormat == NULL )
+    {
+        xArgumentLength = strnlen( ( const char * ) pucArguments, xArgumentLength );
+        xLength = ( xArgumentLength < configLOGGING_MAX_MESSAGE_LENGTH ) ? xArgumentLength : configLOGGING_MAX_MESSAGE_LENGTH - 1;
+        memcpy( pcPrintString, pucArguments, xLength );
+        pcPrintString[ xLength ] = '\0';
+        return xLength;
+    }
+
+    #if ( configLOGGING_INCLUDE_TIME_AND_TASK_NAME == 1 )
+        {
+            /* Add the message number, time stamp and the name of the calling task
+             * to the start of the log. */
+            if( strcmp( pcFormat, "\n" ) != 0 )
+            {
+                xLength = ( size_t ) snprintf( pcPrintString, configLOGGING_MAX_MESSAGE_LENGTH, "%lu %lu [%.*s] ",
+                                               ( unsigned long ) pxRecord->xHeader.ulMessageNumber,
+                                               ( unsigned long ) pxRecord->xHeader.xTickCount,
+                                               configMAX_TASK_NAME_LEN,
+                                               pxRecord->xHeader.cTaskName );
+            }
+        }
+    #endif /* if ( configLOGGING_INCLUDE_TIME_AND_TASK_NAME == 1 ) */
+
+    for( ; ; )
+    {
+        char * pcOut;
+        size_t xRemaining;
+        int lWritten = 0;
+
+        if( xLength >= ( configLOGGING_MAX_MESSAGE_LENGTH - 1 ) )
+        {
+            return configLOGGING_MAX_MESSAGE_LENGTH - 1;
+        }
+
+        pcOut = &pcPrintString[ xLength ];
+        xRemaining = configLOGGING_MAX_MESSAGE_LENGTH - xLength;
+        pcNext = prvNextConversion( pcFormat, &xConversion );
+
+        /* Copy the literal text up to the next conversion, or to the end. */
+        {
+            size_t xLiteral = ( size_t ) ( xConversion.pcStart - pcFormat );
+
+            if( xLiteral >= xRemaining )
+            {
+                xLiteral = xRemaining - 1;
+            }
+
+            memcpy( pcOut, pcFormat, xLiteral );
+            pcOut[ xLiteral ] = '\0';
+            xLength += xLiteral;
+            pcOut += xLiteral;
+            xRemaining -= xLiteral;
+        }
+
+        if( ( pcNext == NULL ) || ( xRemaining <= 1 ) )
+        {
+            return xLength;
+        }
+
+        pcFormat = pcNext;
+
+        if( xConversion.eArgument == eLoggingArgNone )
+        {
+            /* "%%" */
+            pcOut[ 0 ] = '%';
+            pcOut[ 1 ] = '\0';
+            xLength++;
+            continue;
+        }
+
+        if( xConversion.xLength >= sizeof( cSpecifier ) )
+        {
+            return xLength;
+        }
+
+        memcpy( cSpecifier, xConversion.pcStart, xConversion.xLength );
+        cSpecifier[ xConversion.xLength ] = '\0';
+
+        for( uxStar = 0; uxStar < xConversion.uxStars; uxStar++ )
+        {
+            loggingGET( lStars[ uxStar ] );
+        }
+
+        switch( xConversion.eArgument )
+        {
+            case eLoggingArgInt:
+               {
+                   int lValue;
+                   loggingGET( lValue );
+                   lWritten = loggingFORMAT( lValue );
+               }
+               break;
+
+            case eLoggingArgLong:
+               {
+                   long lValue;
+                   loggingGET( lValue );
+                   lWritten = loggingFORMAT( lValue );
+               }
+               break;
+
+            case eLoggingArgLongLong:
+               {
+                   long long llValue;
+                   loggingGET( llValue );
+                   lWritten = loggingFORMAT( llValue );
+               }
+               break;
+
+            case eLoggingArgSize:
+               {
+                   size_t xValue;
+                   loggingGET( xValue );
+                   lWritten = loggingFORMAT( xValue );
+               }
+               break;
+
+            case eLoggingArgDouble:
+               {
+                   double dValue;
+                   loggingGET( dValue );
+                   lWritten = loggingFORMAT( dValue );
+               }
+               break;
+
+            case eLoggingArgPointer:
+               {
+                   void * pvValue;
+                   loggingGET( pvValue );
+                   lWritten = loggingFORMAT( pvValue );
+               }
+               break;
+
+            case eLoggingArgString:
+               {
+                   const char * pcValue = ( const char * ) &pucArguments[ xOffset ];
+                   size_t xStringLength = strnlen( pcValue, xArgumentLength - xOffset );
+
+                   if( xOffset + xStringLength >= xArgumentLength )
+                   {
+                       return xLength;
+                   }
+
+                   xOffset += xStringLength + 1;
+                   lWritten = loggingFORMAT( pcValue );
+               }
+               break;
+
+            case eLoggingArgNone:
+            default:
+                break;
+        }
+
+        if( lWritten > 0 )
+        {
+            xLength += ( ( size_t ) lWritten < xRemaining ) ? ( size_t ) lWritten : xRemaining - 1;
+        }
+    }
+}
 
-    xLength = strlen( pcMessage ) + 1;
-    pcPrintString = pvPortMalloc( xLength );
+#undef loggingGET
+#undef loggingFORMAT
 
-    if( pcPrintString != NULL )
+#endif /* if ( configLOGGING_BINARY_TRACE != 1 ) */
+/*-----------------------------------------------------------*/
+
+static void prvSendRecord( LoggingRecord_t * pxRecord,
+                           size_t xArgumentLength )
+{
+    /* The message buffer assumes a single writer, so each record is written
+     * with the scheduler suspended.  The send never blocks, and interrupts stay
+     * enabled throughout. */
+    vTaskSuspendAll();
     {
-        strncpy( pcPrintString, pcMessage, xLength );
+        pxRecord->xHeader.ulMessageNumber = ulMessageNumber++;
 
-        /* Send the string to the logging task for IO. */
-        if( xQueueSend( xQueue, &pcPrintString, loggingDONT_BLOCK ) != pdPASS )
+        if( xMessageBufferSend( xMessageBuffer, pxRecord,
+                                sizeof( pxRecord->xHeader ) + xArgumentLength,
+                                loggingDONT_BLOCK ) == 0 )
         {
-            /* The buffer was not sent so must be freed again. */
-            vPortFree( ( void * ) pcPrintString );
+            ulDroppedMessages++;
         }
     }
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+/*!
+ * \brief Records a message to be formatted and printed by
+ * the logging task.
+ *
+ * Only the format string pointer, the message number, time
+ * (in ticks), the name of the calling task and the raw
+ * arguments are recorded; the logging task formats them
+ * later.  String arguments are copied, so they need not
+ * outlive the call.  Must not be called from an interrupt.
+ *
+ */
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    LoggingRecord_t xRecord;
+    size_t xArgumentLength;
+    va_list args;
+
+    /* The message buffer is created by xLoggingTaskInitialize().  Check
+     * xLoggingTaskInitialize() has been called. */
+    configASSERT( xMessageBuffer );
+
+    xRecord.xHeader.pcFormat = pcFormat;
+    xRecord.xHeader.xTickCount = xTaskGetTickCount();
+
+    #if ( configLOGGING_BINARY_TRACE == 1 )
+        {
+            xRecord.xHeader.xTask = ( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED ) ?
+                                    xTaskGetCurrentTaskHandle() : NULL;
+        }
+    #else
+        {
+            if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
+            {
+                strncpy( xRecord.xHeader.cTaskName, pcTaskGetName( NULL ), configMAX_TASK_NAME_LEN );
+            }
+            else
+            {
+                strncpy( xRecord.xHeader.cTaskName, "None", configMAX_TASK_NAME_LEN );
+            }
+        }
+    #endif /* if ( configLOGGING_BINARY_TRACE == 1 ) */
+
+    /* There are a variable number of parameters. */
+    va_start( args, pcFormat );
+    xArgumentLength = prvSerialiseArguments( xRecord.ucArguments, pcFormat, args );
+    va_end( args );
+
+    prvSendRecord( &xRecord, xArgumentLength );
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingPrint( const char * pcMessage )
+{
+    LoggingRecord_t xRecord;
+    size_t xLength;
+
+    /* The message buffer is created by xLoggingTaskInitialize().  Check
+     * xLoggingTaskInitialize() has been called. */
+    configASSERT( xMessageBuffer );
+
+    xRecord.xHeader.pcFormat = NULL;
+    xRecord.xHeader.xTickCount = xTaskGetTickCount();
+
+    #if ( configLOGGING_BINARY_TRACE == 1 )
+        {
+            xRecord.xHeader.xTask = NULL;
+        }
+    #else
+        {
+            xRecord.xHeader.cTaskName[ 0 ] = '\0';
+        }
+    #endif
+
+    xLength = strnlen( pcMessage, loggingMAX_ARGUMENT_LENGTH - 1 );
+    memcpy( xRecord.ucArguments, pcMessage, xLength );
+    xRecord.ucArguments[ xLength ] = '\0';
+
+    prvSendRecord( &xRecord, xLength + 1 );
 }
@@ -21,12 +21,15 @@
  */
 
 
+
 #include "busArbitrator-I2C.h"
 
+#include <stdbool.h>
+
 #include "stm32l4xx_hal.h"
 
 #include "FreeRTOS.h"
-#include "semphr.h"
+#include "task.h"
 
 
 
@@ -34,9 +37,14 @@
 typedef struct
 {
 	I2C_HandleTypeDef * i2cHandle;
-	SemaphoreHandle_t semaphoreHandle;
-	TaskHandle_t txTaskToNotify;
-	TaskHandle_t rxTaskToNotify;
+
+	/* Transactions in order of submission, queue[head] is the oldest */
+	BA_I2C_transaction_t *queue[BA_I2C_QUEUE_DEPTH];
+	size_t head;
+	size_t count;
+
+	/* queue[head] has been started on the bus */
+	bool active;
 }BA_I2C_Handle_t;
 
 /* Define ------------------------------------------------------------*/
@@ -51,6 +59,9 @@ typedef struct
 static const TickType_t maxBlockTime  = T_timeout_mS;
 static const TickType_t maxAccessTime = T_timeout_mS + 1;
 
+/* A blocking transaction may wait behind a full queue before it starts */
+static const TickType_t maxQueueTime  = T_timeout_mS * BA_I2C_QUEUE_DEPTH;
+
 
 /* Macro -------------------------------------------------------------*/
 
@@ -61,6 +72,13 @@ static BA_I2C_Handle_t handles[NumberOfI2cBusses] = {};
 
 
 /* Function prototypes -----------------------------------------------*/
+static BA_I2C_Handle_t * FindHandle( I2C_HandleTypeDef *hi2c );
+static void Transfer( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer );
+static void NotifyTask( BA_I2C_transaction_t *transaction );
+static HAL_StatusTypeDef Start( BA_I2C_Handle_t *hd );
+static void Dispatch( BA_I2C_Handle_t *hd );
+static void Complete( BA_I2C_Handle_t *hd, BA_I2C_status_t status );
+static void ResetBus( BA_I2C_Handle_t *hd );
 
 /* External functions ------------------------------------------------*/
 
@@ -73,12 +91,12 @@ void BA_I2C_init( BA_I2C_descriptor_t bus )
 	switch(bus)
 	{
 	case I2C2_Bus:
-		if (handles[I2C2_Bus].semaphoreHandle == NULL)
+		if (handles[I2C2_Bus].i2cHandle == NULL)
 		{
 			handles[I2C2_Bus].i2cHandle = &hi2c2;
-			handles[I2C2_Bus].semaphoreHandle = xSemaphoreCreateMutex();
-			handles[I2C2_Bus].txTaskToNotify = NULL;
-			handles[I2C2_Bus].rxTaskToNotify = NULL;
+			handles[I2C2_Bus].head = 0;
+			handles[I2C2_Bus].count = 0;
+			handles[I2C2_Bus].active = false;
 		}
 		break;
 
@@ -91,7 +109,7 @@ void BA_I2C_init( BA_I2C_descriptor_t bus )
 
 
 /**
- * @brief Read the contents of the requested device
+ * @brief Read the contents of the requested device, blocks until complete
  * @param bus Descriptor identifying which I2C bus to access
  * @param deviceAddr identifies which device to access
  * @param buffer:
@@ -100,60 +118,12 @@ void BA_I2C_init( BA_I2C_descriptor_t bus )
  */
 void BA_I2C_read( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer)
 {
-
-	if ( bus < NumberOfI2cBusses )
-	{
-		BA_I2C_Handle_t *hd = &handles[bus];
-
-		if ( hd->semaphoreHandle != NULL )
-		{
-			if ( xSemaphoreTake( hd->semaphoreHandle, maxAccessTime ) == pdTRUE )
-			{
-				HAL_StatusTypeDef status;
-
-				// Setup handle for task notification from ISR
-				taskENTER_CRITICAL();
-				hd->txTaskToNotify = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
-				//xTaskNotifyStateClear(xHandlingTask); // Clear pending notifications state (does not affect notification value), from prior Tx attempts
-				ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Tx attempts
-
-				/* Non-blocking: Send message requesting access starting at base register location */
-				status = HAL_I2C_Master_Transmit_DMA( hd->i2cHandle, deviceAddr, buffer->outbound, buffer->outSize );
-				taskEXIT_CRITICAL();
-
-				if ( status == HAL_OK )
-				{
-					// Wait for TX Complete
-					ulTaskNotifyTake( pdTRUE,  // Clear the notification value before exiting
-										maxBlockTime );
-				}
-
-				// Setup handle for task notification from ISR
-				taskENTER_CRITICAL();
-				hd->rxTaskToNotify = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
-				//xTaskNotifyStateClear(xHandlingTask); // Clear pending notifications state (does not affect notification value), from prior Tx attempts
-				ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Tx attempts
-
-				/* Non-blocking Read contents from device */
-				status = HAL_I2C_Master_Receive_DMA( hd->i2cHandle, deviceAddr, buffer->inbound, buffer->inSize );
-				taskEXIT_CRITICAL();
-
-				if ( status == HAL_OK )
-				{
-					// Wait for RX Complete
-					ulTaskNotifyTake( pdTRUE,  // Clear the notification value before exiting
-										maxBlockTime );
-				}
-
-				xSemaphoreGive(hd->semaphoreHandle);
-			}
-		}
-	}
+	Transfer( bus, deviceAddr, buffer );
 }
 
 
 /**
- * @brief Write data to the requested device
+ * @brief Write data to the requested device, blocks until complete
  * @param bus Descriptor identifying which I2C bus to access
  * @param deviceAddr identifies which device to access
  * @param buffer:
@@ -162,36 +132,278 @@ void BA_I2C_read( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t
  */
 void BA_I2C_write( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer)
 {
-	if ( bus < NumberOfI2cBusses )
+	BA_I2C_buffer_t outboundOnly = *buffer;
+	outboundOnly.inbound = NULL;
+	outboundOnly.inSize = 0;
+
+	Transfer( bus, deviceAddr, &outboundOnly );
+}
+
+
+/**
+ * @brief Queues a transaction without blocking, transactions on a bus run back-to-back in the
+ * order submitted. Upon completion the status is updated, then the callback is invoked from
+ * interrupt context.
+ * @note May be called from a task, or from a completion callback.
+ * @param bus Descriptor identifying which I2C bus to access
+ * @param transaction to be queued, must remain valid until it completes
+ * @retval 0 if queued, -1 if the queue is full or the transaction is invalid
+ */
+int BA_I2C_submit( BA_I2C_descriptor_t bus, BA_I2C_transaction_t *transaction )
+{
+	if ( (bus >= NumberOfI2cBusses) || (handles[bus].i2cHandle == NULL) )
+	{
+		return -1;
+	}
+
+	if ( (transaction->buffer.outSize == 0) && (transaction->buffer.inSize == 0) )
+	{
+		return -1;
+	}
+
+	BA_I2C_Handle_t *hd = &handles[bus];
+	int result = -1;
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+	if ( hd->count < BA_I2C_QUEUE_DEPTH )
+	{
+		transaction->status = BA_I2C_PENDING;
+		hd->queue[(hd->head + hd->count) % BA_I2C_QUEUE_DEPTH] = transaction;
+		hd->count++;
+		result = 0;
+
+		Dispatch( hd );
+	}
+
+	taskEXIT_CRITICAL_FROM_ISR( mask );
+
+	return result;
+}
+
+
+/**
+ * @brief Withdraws a transaction. If it has not yet started it is removed from the queue,
+ * otherwise the transfer in progress is aborted. Either way it completes as BA_I2C_FAILED,
+ * unless it has already completed.
+ * @param bus Descriptor identifying which I2C bus to access
+ * @param transaction previously submitted
+ */
+void BA_I2C_cancel( BA_I2C_descriptor_t bus, BA_I2C_transaction_t *transaction )
+{
+	if ( bus >= NumberOfI2cBusses )
+	{
+		return;
+	}
+
+	BA_I2C_Handle_t *hd = &handles[bus];
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+	for ( size_t index = 0; index < hd->count; index++ )
 	{
-		BA_I2C_Handle_t * hd = &handles[bus];
+		size_t slot = (hd->head + index) % BA_I2C_QUEUE_DEPTH;
 
-		if ( hd->semaphoreHandle != NULL )
+		if ( hd->queue[slot] != transaction )
 		{
-			if ( xSemaphoreTake( hd->semaphoreHandle, maxAccessTime ) == pdTRUE )
+			continue;
+		}
+
+		if ( (index == 0) && hd->active )
+		{
+			/* Completes through HAL_I2C_AbortCpltCallback() */
+			HAL_I2C_Master_Abort_IT( hd->i2cHandle, transaction->deviceAddr );
+		}
+		else
+		{
+			/* Close the gap, preserving the order of the others */
+			for ( ; index + 1 < hd->count; index++ )
 			{
-				// Setup handle for task notification from ISR
-				taskENTER_CRITICAL();
-				hd->txTaskToNotify = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
-				//xTaskNotifyStateClear(xHandlingTask); // Clear pending notifications state (does not affect notification value), from prior Tx attempts
-				ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Tx attempts
-
-				/* Non-blocking: Write value(s) starting at requested register location */
-				HAL_StatusTypeDef status = HAL_I2C_Master_Transmit_DMA( hd->i2cHandle, deviceAddr, buffer->outbound, buffer->outSize );
-				taskEXIT_CRITICAL();
-
-				if ( status == HAL_OK )
-				{
-					// Wait for TX Complete
-					ulTaskNotifyTake( pdTRUE,  // Clear the notification value before exiting
-										maxBlockTime );
-				}
-				
-				xSemaphoreGive(hd->semaphoreHandle);
+				hd->queue[(hd->head + index) % BA_I2C_QUEUE_DEPTH] =
+						hd->queue[(hd->head + index + 1) % BA_I2C_QUEUE_DEPTH];
+			}
+			hd->count--;
 
+			transaction->status = BA_I2C_FAILED;
+			if ( transaction->callback != NULL )
+			{
+				transaction->callback( transaction );
 			}
 		}
+		break;
+	}
+
+	taskEXIT_CRITICAL_FROM_ISR( mask );
+}
+
+
+/**
+ * @brief Runs a transaction on behalf of the calling task, and waits for it to complete.
+ * @note A transaction that outlives its time limit is cancelled, and if the bus does not
+ * respond to the abort it is reset. The buffers are never left in use on return.
+ */
+static void Transfer( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t *buffer )
+{
+	BA_I2C_transaction_t transaction;
+	transaction.deviceAddr = deviceAddr;
+	transaction.buffer = *buffer;
+	transaction.callback = NotifyTask;
+	transaction.context = xTaskGetCurrentTaskHandle();
+	transaction.status = BA_I2C_PENDING;
+
+	/* Zero wait, clear both pending notification state & pending notification value, from
+	 * prior attempts */
+	ulTaskNotifyTake( pdTRUE, 0 );
+
+	if ( (bus >= NumberOfI2cBusses) || (handles[bus].i2cHandle == NULL) )
+	{
+		return;
+	}
+
+	/* Wait for room in the queue */
+	TickType_t waited = 0;
+	while ( BA_I2C_submit( bus, &transaction ) != 0 )
+	{
+		if ( waited++ >= maxAccessTime )
+		{
+			return;
+		}
+		vTaskDelay( 1 );
+	}
+
+	while ( transaction.status == BA_I2C_PENDING )
+	{
+		if ( ulTaskNotifyTake( pdTRUE, maxQueueTime ) == 0 )
+		{
+			break;
+		}
+	}
+
+	if ( transaction.status == BA_I2C_PENDING )
+	{
+		BA_I2C_cancel( bus, &transaction );
+		ulTaskNotifyTake( pdTRUE, maxBlockTime );
+
+		if ( transaction.status == BA_I2C_PENDING )
+		{
+			ResetBus( &handles[bus] );
+		}
+	}
+}
+
+
+/**
+ * @brief Completion callback used by the blocking interface, wakes the waiting task.
+ */
+static void NotifyTask( BA_I2C_transaction_t *transaction )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	vTaskNotifyGiveFromISR( (TaskHandle_t)transaction->context, &xHigherPriorityTaskWoken );
+
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+
+/**
+ * @brief Locates the arbitrator handle for a HAL handle
+ * @retval Matching handle, or NULL if the bus is not managed here
+ */
+static BA_I2C_Handle_t * FindHandle( I2C_HandleTypeDef *hi2c )
+{
+	for ( size_t index = 0; index < NumberOfI2cBusses; index++ )
+	{
+		if ( handles[index].i2cHandle == hi2c )
+		{
+			return &handles[index];
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief Starts the oldest queued transaction. A combined write-read begins with the outbound
+ * message, leaving the bus claimed for the repeated start.
+ * @note Interrupts must be masked.
+ */
+static HAL_StatusTypeDef Start( BA_I2C_Handle_t *hd )
+{
+	BA_I2C_transaction_t *transaction = hd->queue[hd->head];
+	BA_I2C_buffer_t *buffer = &transaction->buffer;
+
+	if ( buffer->outSize > 0 )
+	{
+		return HAL_I2C_Master_Seq_Transmit_DMA( hd->i2cHandle, transaction->deviceAddr,
+				buffer->outbound, buffer->outSize,
+				(buffer->inSize > 0) ? I2C_FIRST_FRAME : I2C_FIRST_AND_LAST_FRAME );
+	}
+
+	return HAL_I2C_Master_Seq_Receive_DMA( hd->i2cHandle, transaction->deviceAddr,
+			buffer->inbound, buffer->inSize, I2C_FIRST_AND_LAST_FRAME );
+}
+
+
+/**
+ * @brief Starts queued transactions while the bus is idle, any that fail to start are
+ * completed as failed.
+ * @note Interrupts must be masked.
+ */
+static void Dispatch( BA_I2C_Handle_t *hd )
+{
+	while ( !hd->active && (hd->count > 0) )
+	{
+		if ( Start( hd ) == HAL_OK )
+		{
+			hd->active = true;
+		}
+		else
+		{
+			Complete( hd, BA_I2C_FAILED );
+		}
+	}
+}
+
+
+/**
+ * @brief Removes the oldest transaction from the queue, and reports its completion.
+ * @note Interrupts must be masked. The bus is left idle, the caller is expected to Dispatch().
+ */
+static void Complete( BA_I2C_Handle_t *hd, BA_I2C_status_t status )
+{
+	BA_I2C_transaction_t *transaction = hd->queue[hd->head];
+
+	hd->head = (hd->head + 1) % BA_I2C_QUEUE_DEPTH;
+	hd->count--;
+	hd->active = false;
+
+	transaction->status = status;
+	if ( transaction->callback != NULL )
+	{
+		transaction->callback( transaction );
+	}
+}
+
+
+/**
+ * @brief Recovers a bus that failed to respond to an abort, the peripheral and its DMA are
+ * reinitialized and the transaction in progress is failed.
+ */
+static void ResetBus( BA_I2C_Handle_t *hd )
+{
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+	if ( hd->active )
+	{
+		HAL_I2C_DeInit( hd->i2cHandle );
+		HAL_I2C_Init( hd->i2cHandle );
+
+		Complete( hd, BA_I2C_FAILED );
+		Dispatch( hd );
 	}
+
+	taskEXIT_CRITICAL_FROM_ISR( mask );
 }
 
 
@@ -203,31 +415,32 @@ void BA_I2C_write( BA_I2C_descriptor_t bus, uint16_t deviceAddr, BA_I2C_buffer_t
   */
 void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
 {
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	BA_I2C_Handle_t *hd = FindHandle( hi2c );
 
-	/* Find matching bus handle */
-	for ( size_t index = 0; index < NumberOfI2cBusses; index++ )
+	if ( (hd == NULL) || !hd->active )
 	{
-		if ( handles[index].i2cHandle == hi2c )
-		{
-			/* Match found */
-			configASSERT( handles[index].txTaskToNotify != NULL );
+		return;
+	}
 
-			vTaskNotifyGiveFromISR( handles[index].txTaskToNotify,
-							   &xHigherPriorityTaskWoken );
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
 
-			/* There is no transmission in progress, so no tasks to notify. */
-			handles[index].txTaskToNotify = NULL;
+	BA_I2C_transaction_t *transaction = hd->queue[hd->head];
+	BA_I2C_buffer_t *buffer = &transaction->buffer;
 
-			break;
-		}
+	if ( buffer->inSize == 0 )
+	{
+		Complete( hd, BA_I2C_COMPLETE );
+	}
+	else if ( HAL_I2C_Master_Seq_Receive_DMA( hi2c, transaction->deviceAddr,
+			buffer->inbound, buffer->inSize, I2C_LAST_FRAME ) != HAL_OK )
+	{
+		/* Register address was sent, the repeated start to read could not be issued */
+		Complete( hd, BA_I2C_FAILED );
 	}
 
-	/* If xHigherPriorityTaskWoken is now set to pdTRUE then a context switch
-	should be performed to ensure the interrupt returns directly to the highest
-	priority task.  The macro used for this purpose is dependent on the port in
-	use and may be called portEND_SWITCHING_ISR(). */
-	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+	Dispatch( hd );
+
+	taskEXIT_CRITICAL_FROM_ISR( mask );
 }
 
 /**
@@ -238,31 +451,51 @@ void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
   */
 void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
 {
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	BA_I2C_Handle_t *hd = FindHandle( hi2c );
 
-	/* Find matching bus handle */
-	for ( size_t index = 0; index < NumberOfI2cBusses; index++ )
+	if ( (hd == NULL) || !hd->active )
 	{
-		if ( handles[index].i2cHandle == hi2c )
-		{
-			/* Match found */
-			configASSERT( handles[index].rxTaskToNotify != NULL );
+		return;
+	}
 
-			vTaskNotifyGiveFromISR( handles[index].rxTaskToNotify,
-							   &xHigherPriorityTaskWoken );
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
 
-			/* There is no reception in progress, so no tasks to notify. */
-			handles[index].rxTaskToNotify = NULL;
+	Complete( hd, BA_I2C_COMPLETE );
+	Dispatch( hd );
 
-			break;
-		}
+	taskEXIT_CRITICAL_FROM_ISR( mask );
+}
+
+/**
+  * @brief  I2C error callback, e.g. the device did not acknowledge.
+  * @param  hi2c Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @retval None
+  */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	BA_I2C_Handle_t *hd = FindHandle( hi2c );
 
+	if ( (hd == NULL) || !hd->active )
+	{
+		return;
 	}
 
-	/* If xHigherPriorityTaskWoken is now set to pdTRUE then a context switch
-	should be performed to ensure the interrupt returns directly to the highest
-	priority task.  The macro used for this purpose is dependent on the port in
-	use and may be called portEND_SWITCHING_ISR(). */
-	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+	Complete( hd, BA_I2C_FAILED );
+	Dispatch( hd );
+
+	taskEXIT_CRITICAL_FROM_ISR( mask );
 }
 
+/**
+  * @brief  I2C abort callback, following BA_I2C_cancel() of a transfer in progress.
+  * @param  hi2c Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @retval None
+  */
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	HAL_I2C_ErrorCallback( hi2c );
+}
@@ -21,6 +21,7 @@
  */
 
 #include <errno.h> /* error codes */
+#include <string.h>
 
 #include "device.h"
 #include "usbd_cdc_if.h"
@@ -34,6 +35,23 @@
 /* Typedef -----------------------------------------------------------*/
 
 /* Define ------------------------------------------------------------*/
+/* UserTxBufferFS is split in two; the writer fills one half while the USB driver sends the other */
+#define TX_HALF_SIZE		(APP_TX_DATA_SIZE / 2)
+
+/* Longest wait for a half to be sent, assuming one 64-byte packet per frame and that the host
+ * honors the requested polling interval */
+#define TX_HALF_TIMEOUT		pdMS_TO_TICKS( ((TX_HALF_SIZE + 63) >> 6) + CDC_FS_BINTERVAL )
+
+/* Received packets are queued in a ring buffer, so the host can keep sending while the reader is
+ * busy. The host is only held off (NAK) once less than one packet of space remains. Must be a
+ * power of two. */
+#ifndef USB1_RX_BUFFER_SIZE
+#define USB1_RX_BUFFER_SIZE	(1024u)
+#endif
+
+#if (USB1_RX_BUFFER_SIZE & (USB1_RX_BUFFER_SIZE - 1)) != 0 || (USB1_RX_BUFFER_SIZE < 2 * CDC_DATA_FS_OUT_PACKET_SIZE)
+#error "USB1_RX_BUFFER_SIZE must be a power of two, holding at least two packets"
+#endif
 
 /* Macro -------------------------------------------------------------*/
 
@@ -46,12 +64,22 @@ static TaskHandle_t taskHandleNewUsbMessage;
 static SemaphoreHandle_t txSemaphore;
 static int32_t initWrite = 0;
 
+static uint8_t * const txHalf[2] = { UserTxBufferFS, UserTxBufferFS + TX_HALF_SIZE };
+static volatile uint32_t txFill = 0;		/* Half being filled by the writer */
+static volatile uint32_t txFillLength = 0;	/* Bytes pending in the half being filled */
+static volatile uint32_t txBusy = 0;		/* Other half is being sent by the USB driver */
+
 static int32_t handleSet = 0;
 static int32_t rxHandleSet = 0;
-static uint32_t rxMessageLength = 0;
+
+static uint8_t rxRing[USB1_RX_BUFFER_SIZE];
+static volatile uint32_t rxHead = 0;	/* Free running, advanced by the ISR */
+static volatile uint32_t rxTail = 0;	/* Free running, advanced by the reader */
+static volatile uint32_t rxPaused = 0;	/* OUT endpoint left unarmed, host is NAKed */
 
 
 /* Function prototypes -----------------------------------------------*/
+static int32_t StartTransmit(void);
 
 /* External functions ------------------------------------------------*/
 
@@ -83,11 +111,14 @@ int usb1_close_r(struct _reent *ptr, int fd)
 
 
 /**
-  * @brief  Redirects message out USB. Method blocks until transfer fully completes or times out.
-  * @note   Zero copy, buffer is handed off directly to USB driver
+  * @brief  Redirects message out USB. Method returns once the message is buffered, and only blocks
+  * 		while both halves of the transmit buffer are full.
+  * @note   Double buffered over UserTxBufferFS. Data is copied into one half while the USB driver
+  * 		sends the other, then SYS_CDC_TxCompleteIsr() starts the next half. Writes made while a
+  * 		transfer is in progress are combined, so short writes (cerr, clog, etc...) no longer
+  * 		cost a transfer each.
   * 		Known limitations:
-  * 			1.) If link with host is down, the transfer will fail.
-  * 			2.) 1-byte transfers (cerr, clog, etc...) will send just 1-byte and then block
+  * 			1.) If link with host is down, the transfer will fail and buffered data is discarded.
   * @param  file: not used
   * @param  buf: pointer to first character to be sent
   * @parm   len: how many characters to be sent
@@ -98,7 +129,9 @@ _ssize_t usb1_write_r(struct _reent *ptr, int file, const void *buf, size_t len)
 {
 	file = file; //not used, suppress compiler warning
 
-	uint32_t txResult = 0;
+	const uint8_t *data = (const uint8_t *)buf;
+	size_t remaining = len;
+	int32_t result = 0;
 
 	// What to do when len is zero:
 	// For USB, zero length packets are used to indicate end of transfer. For the C++ STL, zero
@@ -106,15 +139,6 @@ _ssize_t usb1_write_r(struct _reent *ptr, int file, const void *buf, size_t len)
 	// transmission and will be ignored.
 	if (len == 0) return 0; // avoid unnecessary call to USB driver
 
-	// To achieve zero-copy, means we have to block until transfer completes before releasing buffer
-	// back to application. Calculate a nominal transfer/block time based on the following
-	// assumptions:
-	// 		1. Average 'n' data packets per frame
-	//		2. Host honors requested polling interval
-	uint32_t transferTime = (len + 63) >> 6; // determine number of packets in message, assume 1 packet per frame
-	transferTime += CDC_FS_BINTERVAL; // add in polling interval requested from host
-	TickType_t xMaxBlockTime = pdMS_TO_TICKS(transferTime);
-
 	// By design, a single thread handles normal transmit of messages. However, when debugging it can
 	// be useful to allow other threads to send debug messages as well. To support multiple threads,
 	// a semaphore has been added to guard access to the USB transmit capability.
@@ -125,55 +149,104 @@ _ssize_t usb1_write_r(struct _reent *ptr, int file, const void *buf, size_t len)
 
 	}
 
-	if (txSemaphore != NULL) {
-		if (xSemaphoreTake(txSemaphore, xMaxBlockTime + 1) == pdTRUE)
-		{
-			// Setup handle for task notification from ISR
-			taskENTER_CRITICAL();
+	if ( (txSemaphore == NULL) || (xSemaphoreTake(txSemaphore, 2 * TX_HALF_TIMEOUT + 1) != pdTRUE) ) {
+		ptr->_errno = ENOLCK;
+		return -1;
+	}
+
+	while ( (remaining > 0) && (result == 0) ) {
+
+		// The buffer state is shared with the TX complete ISR, which the critical section holds off
+		taskENTER_CRITICAL();
+		size_t space = TX_HALF_SIZE - txFillLength;
+
+		if (space > 0) {
+			size_t chunk = (remaining < space) ? remaining : space;
+			memcpy(txHalf[txFill] + txFillLength, data, chunk);
+			txFillLength += chunk;
+			taskEXIT_CRITICAL();
+
+			data += chunk;
+			remaining -= chunk;
+		}
+		else if (txBusy == 0) {
+			// Filled half is waiting on an idle link
+			result = StartTransmit();
+			taskEXIT_CRITICAL();
+		}
+		else {
+			// Both halves are in use, wait for the ISR to start the filled half
 			xHandlingTask = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
-			//xTaskNotifyStateClear(xHandlingTask); // Clear pending notifications state (does not affect notification value), from prior Tx attempts
 			ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Tx attempts
 			handleSet = 1; // Flag to notify ISR handle is now set for notification
-
-			// Initiate TX
-			USBD_StatusTypeDef status = (USBD_StatusTypeDef)CDC_Transmit_FS((uint8_t *)buf, len);
 			taskEXIT_CRITICAL();
 
-			if (status == USBD_OK) {
-				// Wait for TX Complete
-				txResult = ulTaskNotifyTake( pdTRUE,  // Clear the notification value before exiting
-								  xMaxBlockTime );
-
-
-				if (txResult != 0) {
-					xSemaphoreGive(txSemaphore);
-					return len;
-				}
+			if (ulTaskNotifyTake(pdTRUE, TX_HALF_TIMEOUT) == 0) {
+				taskENTER_CRITICAL();
+				handleSet = 0;
+				txFillLength = 0; // host is not reading, discard rather than block every write
+				taskEXIT_CRITICAL();
+				result = -1;
 			}
+		}
+	}
 
-			xSemaphoreGive(txSemaphore);
-			ptr->_errno = EBUSY;
-			return -1;
+	// Start sending straight away if the link is idle, otherwise the ISR sends it on completion
+	if (result == 0) {
+		taskENTER_CRITICAL();
+		if ( (txBusy == 0) && (txFillLength > 0) ) {
+			result = StartTransmit();
 		}
+		taskEXIT_CRITICAL();
+	}
+
+	xSemaphoreGive(txSemaphore);
+
+	if (result != 0) {
+		ptr->_errno = EBUSY;
+		return -1;
+	}
+
+	return len;
+}
+
 
+/**
+  * @brief  Hands the half being filled to the USB driver, and begins filling the other half.
+  * @note   Called with the USB interrupt held off, or from the TX complete ISR. If the transfer
+  * 		cannot be started (e.g. link down), the pending data is discarded.
+  * @retval 0 on success, otherwise -1
+  */
+static int32_t StartTransmit(void)
+{
+	USBD_StatusTypeDef status = (USBD_StatusTypeDef)CDC_Transmit_FS(txHalf[txFill], (uint16_t)txFillLength);
+
+	txFillLength = 0;
+	if (status != USBD_OK) {
+		return -1;
 	}
 
-	ptr->_errno = ENOLCK;
-	return -1;
+	txBusy = 1;
+	txFill ^= 1;
+	return 0;
 }
 
 
 
 /**
-  * @brief  When USB TX complete event occurs, this method notifies the RTOS, which
-  * 		in turns notifies the blocked task waiting for USB TX complete
+  * @brief  When USB TX complete event occurs, the next half is sent if data is pending, and
+  * 		the RTOS is notified if a writer is blocked waiting for buffer space.
   */
 void SYS_CDC_TxCompleteIsr(void)
 {
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
+	txBusy = 0;
+	if (txFillLength > 0) {
+		StartTransmit();
+	}
 
-	// TX completed, notify task
+	// Buffer space available, notify task
 	if (handleSet == 1) {
 		handleSet = 0;
 		vTaskNotifyGiveFromISR( xHandlingTask,
@@ -190,8 +263,8 @@ void SYS_CDC_TxCompleteIsr(void)
 
 /**
   * @brief  Attempts to read up to count bytes from USB message into the buffer starting at buf.
-  * @note   Zero copy, buffer is handed off directly to USB driver
-  * @note   This is a blocking call with no timeout.
+  * @note   Returns whatever has been received so far, up to len bytes, and only blocks (with no
+  * 		timeout) while nothing has been received.
   * @param  file: not used
   * @param  buf: pointer to first character to be read
   * @parm   len: buffer capacity, in bytes
@@ -199,53 +272,76 @@ void SYS_CDC_TxCompleteIsr(void)
   */
 _ssize_t usb1_read_r (struct _reent *ptr, int file, void *buf, size_t len)
 {
-	// USB driver has a fixed transfer request to the host of 64-bytes or less.
-	// Since the USB driver has direct write access to the IO library buffer, need
-	// to verify the buffer from the IO library can handle at least 64-bytes to
-	// prevent buffer overrun.
-	//
-	// Note: future development could implement an additional intermediate buffer to isolate USB
-	// driver from IO library buffer...but then it would no longer be a zero copy interface.
-	if (len < 64 ) {
-		ptr->_errno = ENOBUFS;
-		return -1;
-	}
+	uint8_t *data = (uint8_t *)buf;
+	size_t count = 0;
 
-	// Setup handle for task notification from ISR
+	if (len == 0) return 0;
+
+	// Wait for the USB host to send us something
 	taskENTER_CRITICAL();
-	taskHandleNewUsbMessage = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
-	//xTaskNotifyStateClear(xHandlingTask); // Clear pending notifications state (does not affect notification value), from prior Tx attempts
-	ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Tx attempts
-	rxHandleSet = 1; // Flag to notify ISR handle is now set for notification
-
-	// Hand buffer to USB driver...notifies PC host clear to send more data
-	USBD_CDC_SetRxBuffer(&hUsbDeviceFS, (uint8_t *)buf);
-	USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	while (rxHead == rxTail) {
+		taskHandleNewUsbMessage = xTaskGetCurrentTaskHandle(); // Used by the ISR to notify this task
+		ulTaskNotifyTake( pdTRUE, 0); // Zero wait, clear both pending notification state & pending notification value, from prior Rx attempts
+		rxHandleSet = 1; // Flag to notify ISR handle is now set for notification
+		taskEXIT_CRITICAL();
+
+		ulTaskNotifyTake(pdTRUE,  // Clear the notification value before exiting
+						 portMAX_DELAY ); // wait forever
+
+		taskENTER_CRITICAL();
+	}
 	taskEXIT_CRITICAL();
 
-	// Now wait for the USB host to send us something
-	ulTaskNotifyTake(pdTRUE,  // Clear the notification value before exiting
-					 portMAX_DELAY ); // wait forever
+	// Only this task advances the tail, so the data can be copied without holding off the ISR
+	uint32_t tail = rxTail;
+	uint32_t available = rxHead - tail;
+	while ( (count < len) && (count < available) ) {
+		data[count++] = rxRing[tail++ & (USB1_RX_BUFFER_SIZE - 1)];
+	}
+	__DMB(); // data is copied out before the ISR can overwrite it
+	rxTail = tail;
+
+	// Resume reception once there is room for a full packet again
+	taskENTER_CRITICAL();
+	if ( (rxPaused == 1) && ((USB1_RX_BUFFER_SIZE - (rxHead - rxTail)) >= CDC_DATA_FS_OUT_PACKET_SIZE) ) {
+		rxPaused = 0;
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+	taskEXIT_CRITICAL();
 
-	// Message received, return number of bytes in message
-	return rxMessageLength;
+	return count;
 }
 
 
 /**
-  * @brief  When USB RX message event occurs, this method notifies the RTOS, which
-  * 		in turns notifies the blocked task waiting for USB RX message RX event.
+  * @brief  When USB RX message event occurs, the packet is queued in the receive ring buffer and
+  * 		the endpoint is armed for the next packet, unless the ring buffer is nearly full.
+  * 		The RTOS is notified if the reader is blocked waiting for data.
+  * @parm   buf: received packet
   * @parm   length: how many bytes in message
   */
-void SYS_CDC_RxMessageIsr(uint32_t length)
+void SYS_CDC_RxMessageIsr(const uint8_t *buf, uint32_t length)
 {
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
+	// The endpoint is only armed with room for a full packet, so this always fits
+	uint32_t head = rxHead;
+	for (uint32_t index = 0; index < length; index++) {
+		rxRing[head++ & (USB1_RX_BUFFER_SIZE - 1)] = buf[index];
+	}
+	__DMB(); // data is in place before the reader can see it
+	rxHead = head;
 
-	rxMessageLength = length;
+	if ((USB1_RX_BUFFER_SIZE - (head - rxTail)) >= CDC_DATA_FS_OUT_PACKET_SIZE) {
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+	else {
+		rxPaused = 1;
+	}
 
 	// RX message event, notify task
-	if (rxHandleSet == 1) {
+	if ( (rxHandleSet == 1) && (length > 0) ) {
+		rxHandleSet = 0;
 		vTaskNotifyGiveFromISR( taskHandleNewUsbMessage,
 						   &xHigherPriorityTaskWoken );
 	}
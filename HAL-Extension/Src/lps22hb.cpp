@@ -21,6 +21,8 @@
  */
 
 
+#include <algorithm>
+
 #include "lps22hb.hpp"
 
 
@@ -104,10 +106,26 @@ enum class CTRL_REG2 : uint8_t
 };
 
 
+enum class CTRL_REG3 : uint8_t
+{
+	RESERVED_BIT_MASK = 0x00,
+
+	INT_ACTIVE_LOW  = (0b1 << 7),
+	INT_OPEN_DRAIN  = (0b1 << 6),
+
+	F_FSS5_ENABLE = (0b1 << 5),
+	F_FTH_ENABLE  = (0b1 << 4),
+	F_OVR_ENABLE  = (0b1 << 3),
+	DRDY_ENABLE   = (0b1 << 2),
+};
+
+
 enum class FIFO_CTRL : uint8_t
 {
 	RESERVED_BIT_MASK = 0x00,
 
+	WTM_MASK              = 0x1F,
+
 	MODE_BYPASS           = (0b000 << 5),
 	MODE_FIFO             = (0b001 << 5),
 	MODE_STREAM           = (0b010 << 5),
@@ -117,6 +135,13 @@ enum class FIFO_CTRL : uint8_t
 	MODE_BYPASS_TO_FIFO   = (0b111 << 5)
 };
 
+enum class FIFO_STATUS : uint8_t
+{
+	FTH_FIFO = (0b1 << 7),
+	OVR      = (0b1 << 6),
+	FSS_MASK = 0x3F
+};
+
 enum class RES_CONF : uint8_t
 {
 	RESERVED_BIT_MASK = 0xFE,
@@ -154,6 +179,10 @@ static constexpr uint8_t devReadAddr = 0xBB;
 static constexpr uint8_t devWriteAddr = 0xBA;
 static constexpr uint8_t devId = 0xB1;
 
+/* Bytes per sample, PRESS_OUT_XL through TEMP_OUT_H. With the FIFO enabled, reads roll over
+ * from TEMP_OUT_H back to PRESS_OUT_XL so consecutive samples are read as one block. */
+static constexpr size_t sampleSize = 5;
+
 /* Macro -------------------------------------------------------------*/
 
 /* Variables ---------------------------------------------------------*/
@@ -262,6 +291,42 @@ public:
 	}
 
 
+	/**
+	 * @brief Converts a raw temperature reading
+	 * @param raw points to TEMP_OUT_L and TEMP_OUT_H
+	 * @retval temperature value in Celsius, -40 to 120 C
+	 */
+	static int16_t toTemperature( const uint8_t *raw )
+	{
+		int16_t value = (int16_t)( (int16_t)raw[1] << 8 | raw[0] );
+
+		/* Remove x100 scaler in temperature, truncate result */
+		return value / 100;
+	}
+
+
+	/**
+	 * @brief Converts a raw pressure reading
+	 * @param raw points to PRESS_OUT_XL, PRESS_OUT_L and PRESS_OUT_H
+	 * @retval range 260 to 1260 hPa
+	 */
+	static uint16_t toPressure( const uint8_t *raw )
+	{
+		int32_t press = (int32_t)raw[0] | ((int32_t)raw[1] << 8) | ((int32_t)raw[2] << 16);
+
+		/* convert the 2's complement 24 bit to 2's complement 32 bit */
+		if(press & 0x00800000)
+			press |= 0xFF000000;
+
+		press = press >> 12;
+
+		press = (press < 260) ? 260 : press;
+		press = (press > 1260 ) ? 1260 : press;
+
+		return press;
+	}
+
+
 	/**
 	 * @brief Reads the device's entire calibration table into local memory
 	 */
@@ -324,12 +389,10 @@ LPS22HB::LPS22HB(BA_I2C_descriptor_t location) :
  */
 int16_t LPS22HB::getTemperature()
 {
-	int16_t value = pimpl->read16bit(LPS22HB_Register::TEMP_OUT_L);
+	uint8_t raw[2] {};
+	pimpl->readBlock(LPS22HB_Register::TEMP_OUT_L, raw, sizeof(raw));
 
-	/* Remove x100 scaler in temperature, truncate result */
-	value = value / 100;
-
-	return value;
+	return impl::toTemperature(raw);
 }
 
 
@@ -339,19 +402,79 @@ int16_t LPS22HB::getTemperature()
  */
 uint16_t LPS22HB::getPressure()
 {
-	int32_t press = 0;
-	pimpl->readBlock(LPS22HB_Register::PRESS_OUT_XL, (uint8_t *)&press, 3);
+	uint8_t raw[3] {};
+	pimpl->readBlock(LPS22HB_Register::PRESS_OUT_XL, raw, sizeof(raw));
+
+	return impl::toPressure(raw);
+}
+
+
+/**
+ * @brief Switches the device FIFO into stream mode, the device then buffers up to FifoDepth
+ * samples between reads. The watermark level is also routed to the INT_DRDY pin.
+ * @note Once enabled, getTemperature() and getPressure() return the oldest buffered sample
+ * and remove it from the FIFO, use readBatch() instead.
+ * @param watermark number of samples, 1 to FifoDepth, that sets the FIFO threshold flag
+ * @retval true if the FIFO was enabled, false if the sensor is not connected
+ */
+bool LPS22HB::enableFifo(uint8_t watermark)
+{
+	uint8_t value = 0;
+
+	if( !connected() ) {
+		return false;
+	}
+
+	watermark = std::min<uint8_t>(std::max<uint8_t>(watermark, 1), FifoDepth);
 
-	/* convert the 2's complement 24 bit to 2's complement 32 bit */
-	if(press & 0x00800000)
-		press |= 0xFF000000;
+	value = (uint8_t)FIFO_CTRL::MODE_STREAM;
+	value |= (uint8_t)((watermark - 1) & (uint8_t)FIFO_CTRL::WTM_MASK);
+	pimpl->writeByte( LPS22HB_Register::FIFO_CTRL, value );
 
-	press = press >> 12;
+	value = pimpl->readByte(LPS22HB_Register::CTRL_REG3);
+	value &= (uint8_t)CTRL_REG3::RESERVED_BIT_MASK;
+	value |= (uint8_t)CTRL_REG3::F_FTH_ENABLE;
+	pimpl->writeByte( LPS22HB_Register::CTRL_REG3, value );
 
-	press = (press < 260) ? 260 : press;
-	press = (press > 1260 ) ? 1260 : press;
+	value = pimpl->readByte(LPS22HB_Register::CTRL_REG2);
+	value &= (uint8_t)CTRL_REG2::RESERVED_BIT_MASK;
+	value |= (uint8_t)CTRL_REG2::FIFO_ENABLE;
+	value |= (uint8_t)CTRL_REG2::IF_ADD_INC_ENABLE;
+	value |= (uint8_t)CTRL_REG2::I2C_ENABLE;
+	pimpl->writeByte( LPS22HB_Register::CTRL_REG2, value );
+
+	return true;
+}
+
+
+/**
+ * @brief Drains the samples buffered in the device FIFO, oldest first, with a single block
+ * read. See enableFifo().
+ * @param samples is the destination to store samples
+ * @param count is the maximum number of samples to read
+ * @retval number of samples read, zero if none were pending
+ */
+size_t LPS22HB::readBatch(Sample_t *samples, size_t count)
+{
+	uint8_t raw[FifoDepth * sampleSize];
+
+	uint8_t status = pimpl->readByte(LPS22HB_Register::FIFO_STATUS);
+	size_t pending = status & (uint8_t)FIFO_STATUS::FSS_MASK;
+	pending = std::min({pending, count, FifoDepth});
+
+	if (pending == 0) {
+		return 0;
+	}
+
+	pimpl->readBlock(LPS22HB_Register::PRESS_OUT_XL, raw, pending * sampleSize);
+
+	for (size_t index = 0; index < pending; index++) {
+		const uint8_t *entry = &raw[index * sampleSize];
+		samples[index].pressure = impl::toPressure(&entry[0]);
+		samples[index].temperature = impl::toTemperature(&entry[3]);
+	}
 
-	return press;
+	return pending;
 }
 
 
@@ -78,6 +78,14 @@ typedef enum {
 
 const Device_t Device = {.std_in = "std_in", .std_out = "std_out", .std_err = "std_err", .storage = "storage"};
 
+/* The USB device keeps its own transmit buffers, so stdout needs a separate buffer. One half of
+ * the USB transmit buffer is the most a single write can hand over without waiting. */
+static char stdoutBuffer[APP_TX_DATA_SIZE / 2];
+
+/* Likewise, received USB packets land in UserRxBufferFS and are queued by the USB device, so
+ * stdin has its own buffer. */
+static char stdinBuffer[2 * APP_RX_DATA_SIZE];
+
 
 static const DeviceOperations_t dvStdin = {
 		Device.std_in, sizeof(Device.std_in),
@@ -147,11 +155,11 @@ void app_SetBuffer(FILE *handle)
 
 	switch ((FileDescriptor_t)handle->_file) {
 	case std_in:
-		setvbuf(stdin,  (char *)UserRxBufferFS, _IOLBF, APP_RX_DATA_SIZE);
+		setvbuf(stdin,  stdinBuffer, _IOLBF, sizeof(stdinBuffer));
 		break;
 
 	case std_out:
-		setvbuf(stdout, (char *)UserTxBufferFS, _IOFBF, APP_TX_DATA_SIZE);
+		setvbuf(stdout, stdoutBuffer, _IOFBF, sizeof(stdoutBuffer));
 		break;
 
 	case std_err:
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "systime.h"
+
+#if defined(__linux__)
+#include <time.h>
+#else
+#include "stm32l4xx_hal.h"
+#endif
+
+/* Typedef -----------------------------------------------------------*/
+
+/* Define ------------------------------------------------------------*/
+#if defined(__linux__)
+/* The simulation counts nanoseconds in place of core clock cycles */
+#define SIM_CYCLES_PER_US		(1000u)
+#endif
+
+/* Macro -------------------------------------------------------------*/
+
+/* Variables ---------------------------------------------------------*/
+
+/* Function prototypes -----------------------------------------------*/
+
+/* External functions ------------------------------------------------*/
+
+
+/**
+ * @brief  Reads the free running cycle counter, wraps every 2^32 cycles (53 seconds at 80 MHz).
+ * @note   The Cortex-M4 DWT cycle counter is enabled on first use. Elapsed time is the unsigned
+ * 		   difference of two readings, which is correct across a single wrap.
+ * @retval Core clock cycles
+ */
+uint32_t SysTime_Cycles(void)
+{
+#if defined(__linux__)
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec);
+#else
+	if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0) {
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+
+	return DWT->CYCCNT;
+#endif
+}
+
+
+/**
+ * @brief  Cycle counter rate, follows changes to the core clock.
+ * @retval Cycles per microsecond
+ */
+uint32_t SysTime_CyclesPerUs(void)
+{
+#if defined(__linux__)
+	return SIM_CYCLES_PER_US;
+#else
+	uint32_t rate = SystemCoreClock / 1000000u;
+	return (rate == 0 ? 1 : rate);
+#endif
+}
+
+
+/**
+ * @brief  Converts a cycle count, typically the difference of two SysTime_Cycles() readings.
+ * @param  cycles: number of cycles
+ * @retval Microseconds, at the current core clock
+ */
+uint32_t SysTime_CyclesToUs(uint32_t cycles)
+{
+	return cycles / SysTime_CyclesPerUs();
+}
+
+
+/**
+ * @brief  Reads a free running microsecond counter, wraps every 2^32 us (71 minutes).
+ * @note   Extends the cycle counter, so it must be read at least once per cycle counter wrap;
+ * 		   the FreeRTOS tick hook does so every tick. This is the time base for the FreeRTOS run
+ * 		   time statistics, and may be called from any context.
+ * @retval Microseconds
+ */
+uint32_t SysTime_Microseconds(void)
+{
+	static uint32_t lastCycles = 0;
+	static uint32_t remainder = 0;
+	static uint32_t micros = 0;
+
+#if !defined(__linux__)
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+#endif
+
+	uint32_t cycles = SysTime_Cycles();
+	uint32_t rate = SysTime_CyclesPerUs();
+	uint32_t elapsed = (cycles - lastCycles) + remainder;
+
+	lastCycles = cycles;
+	micros += elapsed / rate;
+	remainder = elapsed % rate;
+	uint32_t now = micros;
+
+#if !defined(__linux__)
+	__set_PRIMASK(primask);
+#endif
+
+	return now;
+}
+
+
+/**
+ * @brief  Busy waits for at least the requested time, without involving the scheduler.
+ * @note   Intended for short hardware setup times. Delays of a millisecond or more should block
+ * 		   the task instead, see vTaskDelay().
+ * @param  us: microseconds to wait
+ * @retval None
+ */
+void SysTime_DelayUs(uint32_t us)
+{
+	uint32_t start = SysTime_Cycles();
+	uint32_t cycles = us * SysTime_CyclesPerUs();
+
+	while ((SysTime_Cycles() - start) < cycles) {
+	}
+}
@@ -32,13 +32,27 @@
 #define _AWS_BUFFER_POOL_CONFIG_H_
 
 /**
- * @brief The number of buffers in the static buffer pool.
+ * @brief The number of small buffers in the static buffer pool.
+ *
+ * Control packets (CONNECT, SUBSCRIBE, ACKs, PINGs) and the header of a
+ * publish sent as segments fit in a small buffer, so they do not tie up
+ * a full size buffer.
+ */
+#define bufferpoolconfigNUM_SMALL_BUFFERS    ( 10 )
+
+/**
+ * @brief The size of each small buffer in the static buffer pool.
+ */
+#define bufferpoolconfigSMALL_BUFFER_SIZE    ( 128 )
+
+/**
+ * @brief The number of full size buffers in the static buffer pool.
  */
-#define bufferpoolconfigNUM_BUFFERS    ( 6 )
+#define bufferpoolconfigNUM_BUFFERS          ( 4 )
 
 /**
- * @brief The size of each buffer in the static buffer pool.
+ * @brief The size of each full size buffer in the static buffer pool.
  */
-#define bufferpoolconfigBUFFER_SIZE    ( 1024 + 128 )
+#define bufferpoolconfigBUFFER_SIZE          ( 1024 + 128 )
 
 #endif /* _AWS_BUFFER_POOL_CONFIG_H_ */
@@ -71,6 +71,20 @@ typedef void * Socket_t;
  */
 #define Socklen_t    uint32_t
 
+/**
+ * @brief One segment of a vectored send, see SOCKETS_SendVector().
+ */
+typedef struct SocketsSegment
+{
+    const void * pvData; /**< Start of the segment. */
+    size_t xLength;      /**< Length of the segment in bytes. */
+} SocketsSegment_t;
+
+/**
+ * @brief The most segments that may be passed to SOCKETS_SendVector().
+ */
+#define SOCKETS_MAX_SEND_SEGMENTS    ( 4 )
+
 /**
  * @defgroup SocketsErrors Secure Sockets Error Codes
  * @brief Error codes returned by the SOCKETS API.
@@ -303,6 +317,26 @@ int32_t SOCKETS_Send( Socket_t xSocket,
                       size_t xDataLength,
                       uint32_t ulFlags );
 
+/**
+ * @brief Transmit a list of segments to the remote socket as one stream.
+ *
+ * Behaves like SOCKETS_Send() called with the segments joined together, but
+ * without the caller having to copy them into one buffer first.
+ *
+ * @param[in] xSocket The handle of the sending socket.
+ * @param[in] pxSegments The segments to be sent, in order.
+ * @param[in] xSegmentCount The number of segments, at most @ref SOCKETS_MAX_SEND_SEGMENTS.
+ * @param[in] ulFlags Not currently used. Should be set to 0.
+ *
+ * @return
+ * * On success, the number of bytes actually sent is returned.
+ * * If an error occurred, a negative value is returned. @ref SocketsErrors
+ */
+int32_t SOCKETS_SendVector( Socket_t xSocket,
+                            const SocketsSegment_t * pxSegments,
+                            size_t xSegmentCount,
+                            uint32_t ulFlags );
+
 /**
  * @brief Closes all or part of a full-duplex connection on the socket.
  *
@@ -48,4 +48,36 @@
  */
 #define socketsconfigDEFAULT_RECV_TIMEOUT    ( 10000 )
 
+/**
+ * @brief Time the WiFi module waits for data on each receive request, in milliseconds.
+ *
+ * The module answers as soon as data arrives, so a longer wait means fewer poll
+ * requests over SPI while a socket is idle. The WiFi module is held for the whole
+ * wait, delaying operations on other sockets by up to this amount.
+ */
+#define socketsconfigRECV_MODULE_WAIT_MS     ( 1 )
+
+/**
+ * @brief Longest sleep between two receive polls of an idle socket, in milliseconds.
+ *
+ * The WiFi module does not signal unsolicited data, so an idle socket is polled.
+ * The sleep starts at one tick and doubles after every empty poll, up to this value,
+ * and restarts at one tick once data arrives.
+ */
+#define socketsconfigRECV_MAX_POLL_DELAY_MS  ( 16 )
+
+/**
+ * @brief Priority of the task that sends and receives on the WiFi module.
+ *
+ * Socket sends and receives from all tasks are queued to this task, which
+ * carries them out one AT exchange at a time, sends first. Tasks using the
+ * sockets wait for it, so it should not run below any of them.
+ */
+#define socketsconfigMODULE_TASK_PRIORITY    ( configMAX_PRIORITIES - 3 )
+
+/**
+ * @brief Stack depth, in words, of the task that sends and receives on the WiFi module.
+ */
+#define socketsconfigMODULE_TASK_STACK_DEPTH ( configMINIMAL_STACK_SIZE * 2 )
+
 #endif /* _AWS_SOCKETS_CONFIG_H_ */
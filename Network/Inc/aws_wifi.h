@@ -481,6 +481,15 @@ WIFIReturnCode_t WIFI_GetPMMode( WIFIPMMode_t * pxPMModeType,
  */
 BaseType_t WIFI_IsConnected( void );
 
+/**
+ * @brief Check if the Wi-Fi is connected, without waiting for the module.
+ *
+ * @param[out] pxIsConnected pdTRUE if the link is up, pdFALSE otherwise. Only written on success.
+ *
+ * @return eWiFiSuccess if the module was queried, eWiFiTimeout if it was busy.
+ */
+WIFIReturnCode_t WIFI_PollConnected( BaseType_t * pxIsConnected );
+
 WIFIReturnCode_t WIFI_GetFirmwareVersion( uint8_t * pucBuffer );
 WIFIReturnCode_t WIFI_GetNetworkSettings( ES_WIFI_Network_t * networkSettings );
 WIFIReturnCode_t WIFI_GetRSSI(int32_t * rssi);
@@ -58,6 +58,11 @@
 
 /* Exported Constants --------------------------------------------------------*/
 #define ES_WIFI_PAYLOAD_SIZE     1200
+
+/* Marks a cached module parameter as unknown, forcing it to be re-sent */
+#define ES_WIFI_SOCKET_UNKNOWN   0xFF
+#define ES_WIFI_READLEN_UNKNOWN  0xFFFF
+#define ES_WIFI_TIMEOUT_UNKNOWN  0xFFFFFFFF
 /* Exported macro-------------------------------------------------------------*/
 #define MIN(a, b)  ((a) < (b) ? (a) : (b))
 
@@ -268,6 +273,9 @@ typedef struct {
   uint8_t            CmdData[ES_WIFI_DATA_SIZE];
   uint32_t           Timeout;
   uint32_t           BufferSize;  
+  uint8_t            ActiveSocket;   /*!< Socket last selected with P0 */
+  uint16_t           ReadLen;        /*!< Read length last programmed with R1 */
+  uint32_t           ReadTimeout;    /*!< Read timeout last programmed with R2 */
 } ES_WIFIObject_t;
 
 
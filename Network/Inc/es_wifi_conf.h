@@ -50,13 +50,31 @@
  extern "C" {
 #endif  
 
-#define LOCK_WIFI()
-#define UNLOCK_WIFI()
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+extern SemaphoreHandle_t es_wifi_mutex;
+extern SemaphoreHandle_t spi_rx_sem;
+extern SemaphoreHandle_t spi_tx_sem;
+extern SemaphoreHandle_t cmddata_rdy_rising_sem;
+
+void SPI_WIFI_CreateSemMutex(void);
+void SPI_WIFI_SemSignal(SemaphoreHandle_t sem);
+
+/* RTOS bindings, the task waiting on the module blocks rather than polling. Semaphores are
+ * signaled from the SPI/DMA and CMD/DATA-ready interrupts. The module lock is recursive since
+ * the ES_WIFI_* functions take it again around the AT_* helpers they call. */
+#define LOCK_WIFI()               xSemaphoreTakeRecursive(es_wifi_mutex, portMAX_DELAY)
+#define UNLOCK_WIFI()             xSemaphoreGiveRecursive(es_wifi_mutex)
+/* SPI3 is dedicated to the module and only accessed with LOCK_WIFI() held. The SPI lock/unlock
+ * pairs in es_wifi_io.c also span IO_Send/IO_Receive calls, so they are left empty. */
 #define LOCK_SPI()
 #define UNLOCK_SPI()
-#define SEM_SIGNAL(a)     
+#define SEM_WAIT(a, timeout)      ((xSemaphoreTake((a), pdMS_TO_TICKS(timeout)) == pdTRUE) ? 0 : -1)
+#define SEM_SIGNAL(a)             SPI_WIFI_SemSignal(a)
+/* Objects are statically allocated and persist, an interrupt may still signal after DeInit */
 #define RTOS_FREE_SEM_MUTEX()
-#define RTOS_CREATE_SEM_MUTEX()
+#define RTOS_CREATE_SEM_MUTEX()   SPI_WIFI_CreateSemMutex()
 
 #define ES_WIFI_MAX_SSID_NAME_SIZE                  32
 #define ES_WIFI_MAX_PSWD_NAME_SIZE                  32
@@ -78,6 +96,7 @@
 #define ES_WIFI_USE_WPS                             0
                                                     
 #define ES_WIFI_USE_SPI                             1
+#define ES_WIFI_USE_SPI_DMA                         1
 #define ES_WIFI_USE_UART                            (!ES_WIFI_USE_SPI)   
    
 
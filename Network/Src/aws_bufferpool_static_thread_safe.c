@@ -28,10 +28,15 @@
  * @file aws_bufferpool_static_thread_safe.c
  * @brief A thread safe implementation of the BufferPool interface.
  *
- * A pool of statically allocated buffers is maintained. The number
- * of buffers in the pool and the size of each buffer is controlled
- * via macros bufferpoolconfigNUM_BUFFERS and bufferpoolconfigBUFFER_SIZE
- * which must be defined in BufferPoolConfig.h.
+ * A pool of statically allocated buffers is maintained, in two size
+ * classes. The number of buffers and the size of each buffer in the classes
+ * are controlled via macros bufferpoolconfigNUM_SMALL_BUFFERS,
+ * bufferpoolconfigSMALL_BUFFER_SIZE, bufferpoolconfigNUM_BUFFERS and
+ * bufferpoolconfigBUFFER_SIZE which must be defined in BufferPoolConfig.h.
+ *
+ * The free buffers of each class are kept in a singly linked list threaded
+ * through the buffer metadata, so that getting and returning a buffer takes
+ * constant time in a single short critical section.
  */
 
 /* FreeRTOS includes. */
@@ -43,6 +48,14 @@
 #include "aws_bufferpool_config.h"
 
 /* Make sure that proper config options are defined. */
+#ifndef bufferpoolconfigNUM_SMALL_BUFFERS
+    #error bufferpoolconfigNUM_SMALL_BUFFERS must be defined in BufferPoolConfig.h
+#endif
+
+#ifndef bufferpoolconfigSMALL_BUFFER_SIZE
+    #error bufferpoolconfigSMALL_BUFFER_SIZE must be defined in BufferPoolConfig.h
+#endif
+
 #ifndef bufferpoolconfigNUM_BUFFERS
     #error bufferpoolconfigNUM_BUFFERS must be defined in BufferPoolConfig.h
 #endif
@@ -51,45 +64,50 @@
     #error bufferpoolconfigBUFFER_SIZE must be defined in BufferPoolConfig.h
 #endif
 
+#if ( bufferpoolconfigSMALL_BUFFER_SIZE >= bufferpoolconfigBUFFER_SIZE )
+    #error bufferpoolconfigSMALL_BUFFER_SIZE must be less than bufferpoolconfigBUFFER_SIZE
+#endif
+
 /**
- * @brief Moves the given pointer ahead by the number of bytes required to
- * properly align it as specified by portBYTE_ALIGNMENT.
- *
- * @param[in] pucPtr The given pointer to be aligned.
+ * @brief The number of buffer size classes.
  */
-#define bufferpoolstaticALIGN_POINTER( pucPtr )                                ( ( uint8_t * ) ( ( ( size_t ) ( pucPtr + ( portBYTE_ALIGNMENT - 1 ) ) ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK ) ) )
+#define bufferpoolstaticNUM_CLASSES                    ( 2 )
 
 /**
- * @brief Moves the given pointer ahead by the number of bytes required to
- * store the metadata.
+ * @brief Rounds the given size up to a multiple of portBYTE_ALIGNMENT.
  *
- * @param[in] pucPtr The given pointer to move.
+ * @param[in] xSize The given size.
  */
-#define bufferpoolstaticRESERVE_METADATA_SPACE( pucPtr )                       ( ( uint8_t * ) ( pucPtr + sizeof( BufferMetadata_t ) ) )
+#define bufferpoolstaticALIGN_SIZE( xSize )            ( ( ( xSize ) + ( size_t ) portBYTE_ALIGNMENT_MASK ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK ) )
 
 /**
- * @brief Extracts the location of the user data in the given buffer. The data
- * location is ensured to be properly aligned as specified by portBYTE_ALIGNMENT.
+ * @brief The space reserved for the metadata at the start of each buffer,
+ * so that the user data that follows is properly aligned.
+ */
+#define bufferpoolstaticMETADATA_SIZE                  bufferpoolstaticALIGN_SIZE( sizeof( BufferMetadata_t ) )
+
+/**
+ * @brief The total space taken by a buffer of the given size, including its
+ * metadata.
  *
- * @param[in] pucBuffer The buffer for which to find the user data location.
+ * @param[in] xSize The size of the user data in the buffer.
  */
-#define bufferpoolstaticDATA_LOCATION_IN_BUFFER( pucBuffer )                   ( ( uint8_t * ) ( bufferpoolstaticALIGN_POINTER( bufferpoolstaticRESERVE_METADATA_SPACE( pucBuffer ) ) ) )
+#define bufferpoolstaticBUFFER_SPACE( xSize )          ( bufferpoolstaticMETADATA_SIZE + bufferpoolstaticALIGN_SIZE( xSize ) )
 
 /**
- * @brief Given the data location in a buffer, extracts the buffer "in-use"
- * information from the metadata portion of the buffer.
+ * @brief Extracts the location of the user data in the given buffer.
  *
- * @param[in] pucDataLocation The given data location in the buffer.
+ * @param[in] pxMetadata The metadata at the start of the buffer.
  */
-#define bufferpoolstaticBUFFER_IN_USE_FROM_DATA_LOCATION( pucDataLocation )    ( ( ( BufferMetadata_t * ) ( ( pucDataLocation ) - sizeof( BufferMetadata_t ) ) )->ucBufferInUse )
+#define bufferpoolstaticDATA_LOCATION( pxMetadata )    ( ( uint8_t * ) ( pxMetadata ) + bufferpoolstaticMETADATA_SIZE )
 
 /**
- * @brief Extracts the buffer "in-use" information from the metadata portion
- * of the given buffer.
+ * @brief Given the data location in a buffer, finds the metadata at the
+ * start of the buffer.
  *
- * @param[in] pucBuffer The given buffer.
+ * @param[in] pucDataLocation The given data location in the buffer.
  */
-#define bufferpoolstaticBUFFER_IN_USE( pucBuffer )                             bufferpoolstaticBUFFER_IN_USE_FROM_DATA_LOCATION( bufferpoolstaticDATA_LOCATION_IN_BUFFER( pucBuffer ) )
+#define bufferpoolstaticMETADATA( pucDataLocation )    ( ( BufferMetadata_t * ) ( ( pucDataLocation ) - bufferpoolstaticMETADATA_SIZE ) ) /*lint !e9087 !e826 The metadata is at the start of the buffer. */
 /*-----------------------------------------------------------*/
 
 /**
@@ -97,33 +115,81 @@
  */
 typedef struct BufferMetadata
 {
-    uint8_t ucBufferInUse; /**< Whether or not the buffer is in use. */
+    struct BufferMetadata * pxNextFree; /**< The next free buffer of the same class, only valid while the buffer is free. */
+    uint8_t ucBufferClass;              /**< Index of the size class the buffer belongs to. */
+    uint8_t ucBufferInUse;              /**< Whether or not the buffer is in use. */
 } BufferMetadata_t;
+
+/**
+ * @brief A class of buffers of the same size.
+ */
+typedef struct BufferClass
+{
+    uint8_t * pucPool;                /**< The first buffer of the class. */
+    size_t xBufferSpace;              /**< The distance between consecutive buffers. */
+    BufferPoolStats_t xStats;         /**< The usage statistics of the class. */
+    BufferMetadata_t * pxFreeBuffers; /**< The free buffers of the class. */
+} BufferClass_t;
 /*-----------------------------------------------------------*/
 
 /**
- * @brief The pool of statically allocated buffers.
+ * @brief The pools of statically allocated buffers.
  *
- * The number of buffers in the pool and the size of each buffer is controlled
- * via macros bufferpoolconfigNUM_BUFFERS and bufferpoolconfigBUFFER_SIZE which
- * must be defined in BufferPoolConfig.h.
+ * The number of buffers in the pools and the size of each buffer are
+ * controlled via macros which must be defined in BufferPoolConfig.h.
  *
  * @note Each buffer in the buffer pool allocates additional the space required
  * to store the metadata and to ensure alignment.
  */
-static uint8_t __attribute__((section(".bigData.bufferPool"))) ucBufferPool[ bufferpoolconfigNUM_BUFFERS ][ sizeof( BufferMetadata_t ) + bufferpoolconfigBUFFER_SIZE + ( portBYTE_ALIGNMENT - 1 ) ];
+static uint8_t __attribute__((section(".bigData.bufferPool"), aligned(portBYTE_ALIGNMENT))) ucSmallBufferPool[ bufferpoolconfigNUM_SMALL_BUFFERS ][ bufferpoolstaticBUFFER_SPACE( bufferpoolconfigSMALL_BUFFER_SIZE ) ];
+static uint8_t __attribute__((section(".bigData.bufferPool"), aligned(portBYTE_ALIGNMENT))) ucBufferPool[ bufferpoolconfigNUM_BUFFERS ][ bufferpoolstaticBUFFER_SPACE( bufferpoolconfigBUFFER_SIZE ) ];
+
+/**
+ * @brief The buffer size classes, smallest buffer size first.
+ */
+static BufferClass_t xBufferClasses[ bufferpoolstaticNUM_CLASSES ] =
+{
+    {
+        .pucPool = &( ucSmallBufferPool[ 0 ][ 0 ] ),
+        .xBufferSpace = bufferpoolstaticBUFFER_SPACE( bufferpoolconfigSMALL_BUFFER_SIZE ),
+        .xStats = { .ulBufferSize = bufferpoolconfigSMALL_BUFFER_SIZE, .usNumBuffers = bufferpoolconfigNUM_SMALL_BUFFERS }
+    },
+    {
+        .pucPool = &( ucBufferPool[ 0 ][ 0 ] ),
+        .xBufferSpace = bufferpoolstaticBUFFER_SPACE( bufferpoolconfigBUFFER_SIZE ),
+        .xStats = { .ulBufferSize = bufferpoolconfigBUFFER_SIZE, .usNumBuffers = bufferpoolconfigNUM_BUFFERS }
+    }
+};
 /*-----------------------------------------------------------*/
 
 BaseType_t BUFFERPOOL_Init( void )
 {
     BaseType_t x = 0;
+    BaseType_t y = 0;
+    BufferClass_t * pxClass;
+    BufferMetadata_t * pxMetadata;
 
     /* This function is supposed to be called exactly once
      * and hence no thread safety is ensured. */
-    for( x = 0; x < bufferpoolconfigNUM_BUFFERS; x++ )
+    for( x = 0; x < bufferpoolstaticNUM_CLASSES; x++ )
     {
-        /* Mark all the buffers as free. */
-        bufferpoolstaticBUFFER_IN_USE( ucBufferPool[ x ] ) = 0;
+        pxClass = &( xBufferClasses[ x ] );
+        pxClass->pxFreeBuffers = NULL;
+
+        /* Mark all the buffers as free, building the list backwards so
+         * that buffers are handed out in address order. */
+        for( y = ( BaseType_t ) pxClass->xStats.usNumBuffers - 1; y >= 0; y-- )
+        {
+            pxMetadata = ( BufferMetadata_t * ) ( pxClass->pucPool + ( ( size_t ) y * pxClass->xBufferSpace ) ); /*lint !e9087 !e826 The metadata is at the start of the buffer. */
+            pxMetadata->ucBufferClass = ( uint8_t ) x;
+            pxMetadata->ucBufferInUse = 0;
+            pxMetadata->pxNextFree = pxClass->pxFreeBuffers;
+            pxClass->pxFreeBuffers = pxMetadata;
+        }
+
+        pxClass->xStats.usInUse = 0;
+        pxClass->xStats.usPeakInUse = 0;
+        pxClass->xStats.ulAllocationFailures = 0;
     }
 
     return pdPASS;
@@ -133,62 +199,113 @@ BaseType_t BUFFERPOOL_Init( void )
 uint8_t * BUFFERPOOL_GetFreeBuffer( uint32_t * pulBufferLength )
 {
     BaseType_t x = 0;
+    BufferClass_t * pxClass;
+    BufferClass_t * pxBestFit = NULL;
+    BufferMetadata_t * pxMetadata = NULL;
     uint8_t * pucFreeBuffer = NULL;
 
-    /* All the buffers in the pool are of size bufferpoolconfigBUFFER_SIZE,
-     * so we cannot provide any buffer larger than that. */
-    if( *pulBufferLength <= bufferpoolconfigBUFFER_SIZE )
+    /* Start critical section. */
+    taskENTER_CRITICAL();
+
+    /* Take a buffer from the smallest class which is large enough, falling
+     * back to a larger class when all of its buffers are in use. */
+    for( x = 0; x < bufferpoolstaticNUM_CLASSES; x++ )
     {
-        /* Iterate over all the buffers to find a free buffer. */
-        for( x = 0; x < bufferpoolconfigNUM_BUFFERS; x++ )
-        {
-            /* Start critical section. */
-            taskENTER_CRITICAL();
+        pxClass = &( xBufferClasses[ x ] );
 
-            /* Check if the buffer is free. */
-            if( bufferpoolstaticBUFFER_IN_USE( ucBufferPool[ x ] ) == 0 )
+        if( *pulBufferLength <= pxClass->xStats.ulBufferSize )
+        {
+            if( pxBestFit == NULL )
             {
-                /* Mark the buffer as "in-use". */
-                bufferpoolstaticBUFFER_IN_USE( ucBufferPool[ x ] ) = 1;
+                pxBestFit = pxClass;
+            }
 
-                /* End critical section. The further operations in this
-                 * if branch do not modify the buffer and hence the critical
-                 * section is not needed hereafter. */
-                taskEXIT_CRITICAL();
+            if( pxClass->pxFreeBuffers != NULL )
+            {
+                /* Remove the buffer from the free list and mark it as "in-use". */
+                pxMetadata = pxClass->pxFreeBuffers;
+                pxClass->pxFreeBuffers = pxMetadata->pxNextFree;
+                pxMetadata->ucBufferInUse = 1;
 
-                /* Return the actual buffer size (as configured by the
-                 * bufferpoolconfigBUFFER_SIZE macro) to the user. */
-                *pulBufferLength = bufferpoolconfigBUFFER_SIZE;
+                pxClass->xStats.usInUse++;
 
-                /* Return the data location to the user. */
-                pucFreeBuffer = bufferpoolstaticDATA_LOCATION_IN_BUFFER( ucBufferPool[ x ] );
+                if( pxClass->xStats.usInUse > pxClass->xStats.usPeakInUse )
+                {
+                    pxClass->xStats.usPeakInUse = pxClass->xStats.usInUse;
+                }
 
                 /* Stop as we have found a buffer. */
                 break;
             }
-            else
-            {
-                /* End critical section. */
-                taskEXIT_CRITICAL();
-            }
         }
     }
 
+    /* No buffer large enough is free. A request larger than the largest
+     * class is not counted, as more buffers would not help. */
+    if( ( pxMetadata == NULL ) && ( pxBestFit != NULL ) )
+    {
+        pxBestFit->xStats.ulAllocationFailures++;
+    }
+
+    /* End critical section. The further operations do not modify
+     * the pool and hence the critical section is not needed hereafter. */
+    taskEXIT_CRITICAL();
+
+    if( pxMetadata != NULL )
+    {
+        /* Return the actual buffer size (as configured for the class)
+         * to the user. */
+        *pulBufferLength = xBufferClasses[ pxMetadata->ucBufferClass ].xStats.ulBufferSize;
+
+        /* Return the data location to the user. */
+        pucFreeBuffer = bufferpoolstaticDATA_LOCATION( pxMetadata );
+    }
+
     return pucFreeBuffer;
 }
 /*-----------------------------------------------------------*/
 
 void BUFFERPOOL_ReturnBuffer( uint8_t * const pucBuffer )
 {
+    /* The returned buffer is the data location in the actual buffer
+     * (because we gave the data location to the user). */
+    BufferMetadata_t * pxMetadata = bufferpoolstaticMETADATA( pucBuffer );
+    BufferClass_t * pxClass = &( xBufferClasses[ pxMetadata->ucBufferClass ] );
+
     /* Start critical section. */
     taskENTER_CRITICAL();
 
-    /* Mark the buffer as free. The returned buffer is the data
-     * location in the actual buffer (because we gave the data location
-     * to the user). */
-    bufferpoolstaticBUFFER_IN_USE_FROM_DATA_LOCATION( pucBuffer ) = 0;
+    /* A buffer must not be returned twice. */
+    configASSERT( pxMetadata->ucBufferInUse != 0 );
+
+    /* Mark the buffer as free and put it back on the free list. */
+    pxMetadata->ucBufferInUse = 0;
+    pxMetadata->pxNextFree = pxClass->pxFreeBuffers;
+    pxClass->pxFreeBuffers = pxMetadata;
+
+    pxClass->xStats.usInUse--;
 
     /* End critical section. */
     taskEXIT_CRITICAL();
 }
 /*-----------------------------------------------------------*/
+
+uint32_t BUFFERPOOL_GetStats( BufferPoolStats_t * pxStats,
+                              uint32_t ulMaxClasses )
+{
+    uint32_t x = 0;
+
+    /* Start critical section, so that the statistics are consistent. */
+    taskENTER_CRITICAL();
+
+    for( x = 0; ( x < ulMaxClasses ) && ( x < ( uint32_t ) bufferpoolstaticNUM_CLASSES ); x++ )
+    {
+        pxStats[ x ] = xBufferClasses[ x ].xStats;
+    }
+
+    /* End critical section. */
+    taskEXIT_CRITICAL();
+
+    return x;
+}
+/*-----------------------------------------------------------*/
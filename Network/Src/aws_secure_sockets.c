@@ -32,6 +32,7 @@
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 #include "semphr.h"
 
 /* TLS includes. */
@@ -89,8 +90,16 @@
  * If receive timeouts are implemented by the Inventek module then
  * the SPI driver will poll for extended periods, preventing lower
  * priority tasks from executing.  Therefore timeouts are mocked in
- * the secure sockets layer, and this constant sets the sleep time
- * between each read attempt during the receive timeout period.
+ * the secure sockets layer. The sleep between read attempts starts
+ * at the minimum and backs off exponentially up to the maximum while
+ * the socket stays idle, so data arriving on an active socket is
+ * picked up quickly without flooding the SPI bus when it is quiet.
+ */
+#define stsecuresocketsMIN_POLL_DELAY              ( ( TickType_t ) 1 )
+#define stsecuresocketsMAX_POLL_DELAY              ( pdMS_TO_TICKS( socketsconfigRECV_MAX_POLL_DELAY_MS ) )
+
+/**
+ * @brief Time to wait for the WiFi module when a query should not stall the caller.
  */
 #define stsecuresocketsFIVE_MILLISECONDS           ( pdMS_TO_TICKS( 5 ) )
 
@@ -98,10 +107,10 @@
  * @brief The timeout supplied to the Inventek module in receive operation.
  *
  * Receive timeout are emulated in secure sockets layer and therefore we
- * do not want the Inventek module to block. Setting to zero means
+ * do not want the Inventek module to block for long. Setting to zero means
  * no timeout, so one is the smallest value we can set it to.
  */
-#define stsecuresocketsONE_MILLISECOND             ( 1 )
+#define stsecuresocketsMODULE_RECV_TIMEOUT         ( ( socketsconfigRECV_MODULE_WAIT_MS > 0 ) ? socketsconfigRECV_MODULE_WAIT_MS : 1 )
 
 /**
  * @brief The credential set to use for TLS on the Inventek module.
@@ -120,7 +129,9 @@
  * the WiFi module must be serialized because a single operation
  * (like socket connect, send etc) consists of multiple AT Commands
  * sent over the same SPI bus. A semaphore is therefore used to
- * serialize all the operations.
+ * serialize all the operations. Socket sends and receives are
+ * taken by the WiFi module task, which holds the semaphore for one
+ * AT exchange at a time.
  */
 typedef struct STWiFiModule
 {
@@ -128,6 +139,38 @@ typedef struct STWiFiModule
     SemaphoreHandle_t xSemaphoreHandle; /**< Semaphore used to serialize all the operations on the WiFi module. */
 } STWiFiModule_t;
 
+/**
+ * @brief Data transfers carried out by the WiFi module task.
+ */
+typedef enum STModuleRequestType
+{
+    eModuleSend,   /**< Send data on a socket. */
+    eModuleReceive /**< Poll a socket for received data. */
+} STModuleRequestType_t;
+
+/**
+ * @brief A send or receive queued for the WiFi module task.
+ *
+ * Each socket owns one request for each direction, so queuing never
+ * waits for a free slot. The lock lets one task at a time use the
+ * request, and the buffer belongs to the WiFi module task from the
+ * time the request is queued until xDone is given.
+ */
+typedef struct STModuleRequest
+{
+    STModuleRequestType_t xType;   /**< Send or receive. */
+    uint8_t ucSocketNumber;        /**< Socket the data belongs to. */
+    uint8_t * pucData;             /**< Data to send, or buffer to receive into. */
+    uint16_t usLength;             /**< Length of the data or of the buffer. */
+    uint16_t usTransferred;        /**< Number of bytes actually sent or received. */
+    uint32_t ulSocketTimeout;      /**< Send or receive timeout of the socket. */
+    ES_WIFI_Status_t xResult;      /**< Status returned by the WiFi driver. */
+    SemaphoreHandle_t xLock;       /**< Serializes tasks using this direction of the socket. */
+    SemaphoreHandle_t xDone;       /**< Given by the WiFi module task when the request completes. */
+    StaticSemaphore_t xLockBuffer; /**< Storage for xLock. */
+    StaticSemaphore_t xDoneBuffer; /**< Storage for xDone. */
+} STModuleRequest_t;
+
 /**
  * @brief Represents a secure socket.
  */
@@ -142,6 +185,8 @@ typedef struct STSecureSocket
     void * pvTLSContext;                /**< The TLS Context. */
     char * pcServerCertificate;         /**< Server certificate. Set using SOCKETS_SO_TRUSTED_SERVER_CERTIFICATE option in SOCKETS_SetSockOpt function. */
     uint32_t ulServerCertificateLength; /**< Length of the server certificate. */
+    STModuleRequest_t xSendRequest;     /**< Request used to send on the socket. */
+    STModuleRequest_t xReceiveRequest;  /**< Request used to receive on the socket. */
 } STSecureSocket_t;
 /*-----------------------------------------------------------*/
 
@@ -166,6 +211,17 @@ extern STWiFiModule_t xWiFiModule;
  * before failing the operation.
  */
 static const TickType_t xSemaphoreWaitTicks = pdMS_TO_TICKS( wificonfigMAX_SEMAPHORE_WAIT_TIME_MS );
+
+/**
+ * @brief The WiFi module task, and the queues of requests it carries out.
+ *
+ * Sends and receive polls are queued separately so that sends, which
+ * are short and often answer something the peer is waiting for, go
+ * ahead of receive polls from other sockets.
+ */
+static TaskHandle_t xModuleTask = NULL;
+static QueueHandle_t xSendQueue = NULL;
+static QueueHandle_t xReceiveQueue = NULL;
 /*-----------------------------------------------------------*/
 
 /**
@@ -201,6 +257,38 @@ static void prvReturnSocket( uint32_t ulSocketNumber );
  */
 static BaseType_t prvIsValidSocket( uint32_t ulSocketNumber );
 
+/**
+ * @brief Creates the socket requests, their queues and the WiFi module task.
+ */
+static void prvCreateModuleTask( void );
+
+/**
+ * @brief Carries out queued socket requests, sends first.
+ *
+ * @param[in] pvParameters Not used.
+ */
+static void prvModuleTask( void * pvParameters );
+
+/**
+ * @brief Carries out one socket request on the WiFi module.
+ *
+ * @param[in] pxRequest The request, which receives the result.
+ */
+static void prvModuleExecute( STModuleRequest_t * pxRequest );
+
+/**
+ * @brief Queues a socket request for the WiFi module task and waits for it.
+ *
+ * The caller must hold the lock of the request.
+ *
+ * @param[in] pxRequest The request, with its data, length and timeout set.
+ * @param[in] xQueue The send or the receive queue.
+ *
+ * @return The status returned by the WiFi driver.
+ */
+static ES_WIFI_Status_t prvModuleRequest( STModuleRequest_t * pxRequest,
+                                          QueueHandle_t xQueue );
+
 /**
  * @brief Sends the provided data over WiFi.
  *
@@ -215,6 +303,20 @@ static BaseType_t prvNetworkSend( void * pvContext,
                                   const unsigned char * pucData,
                                   size_t xDataLength );
 
+/**
+ * @brief Sends a list of segments over WiFi, one segment at a time.
+ *
+ * @param[in] xSocket The socket to send on.
+ * @param[in] pxSegments The segments to send, in order.
+ * @param[in] xSegmentCount The number of segments.
+ *
+ * @return The number of bytes actually sent, stopping at the first segment
+ * not sent in full. SOCKETS_SOCKET_ERROR if nothing could be sent.
+ */
+static int32_t prvNetworkSendVector( Socket_t xSocket,
+                                     const SocketsSegment_t * pxSegments,
+                                     size_t xSegmentCount );
+
 /**
  * @brief Receives the data over WiFi.
  *
@@ -308,20 +410,83 @@ static BaseType_t prvIsValidSocket( uint32_t ulSocketNumber )
 }
 /*-----------------------------------------------------------*/
 
-static BaseType_t prvNetworkSend( void * pvContext,
-                                  const unsigned char * pucData,
-                                  size_t xDataLength )
+static void prvCreateModuleTask( void )
 {
-    uint32_t ulSocketNumber = ( uint32_t ) pvContext; /*lint !e923 cast is necessary for port. */
-    STSecureSocket_t * pxSecureSocket;
-    uint16_t usSentBytes = 0;
-    BaseType_t xRetVal = SOCKETS_SOCKET_ERROR;
-    ES_WIFI_Status_t xWiFiResult = SOCKETS_SOCKET_ERROR;
+    static StaticQueue_t xStaticSendQueue;
+    static StaticQueue_t xStaticReceiveQueue;
+    static uint8_t ucSendQueueStorage[ wificonfigMAX_SOCKETS * sizeof( STModuleRequest_t * ) ];
+    static uint8_t ucReceiveQueueStorage[ wificonfigMAX_SOCKETS * sizeof( STModuleRequest_t * ) ];
+    static StackType_t xStack[ socketsconfigMODULE_TASK_STACK_DEPTH ];
+    static StaticTask_t xStaticTask;
+    STModuleRequest_t * pxRequest;
+    uint32_t ulIndex;
 
-    /* Shortcut for easy access. */
-    pxSecureSocket = &( xSockets[ ulSocketNumber ] );
+    for( ulIndex = 0; ulIndex < ( uint32_t ) wificonfigMAX_SOCKETS; ulIndex++ )
+    {
+        pxRequest = &( xSockets[ ulIndex ].xSendRequest );
+        pxRequest->xType = eModuleSend;
+        pxRequest->ucSocketNumber = ( uint8_t ) ulIndex;
+        pxRequest->xLock = xSemaphoreCreateMutexStatic( &( pxRequest->xLockBuffer ) );
+        pxRequest->xDone = xSemaphoreCreateBinaryStatic( &( pxRequest->xDoneBuffer ) );
+
+        pxRequest = &( xSockets[ ulIndex ].xReceiveRequest );
+        pxRequest->xType = eModuleReceive;
+        pxRequest->ucSocketNumber = ( uint8_t ) ulIndex;
+        pxRequest->xLock = xSemaphoreCreateMutexStatic( &( pxRequest->xLockBuffer ) );
+        pxRequest->xDone = xSemaphoreCreateBinaryStatic( &( pxRequest->xDoneBuffer ) );
+    }
 
-    /* Try to acquire the semaphore. */
+    /* Each socket has at most one request of each kind queued, so the
+     * queues can never fill. */
+    xSendQueue = xQueueCreateStatic( wificonfigMAX_SOCKETS, sizeof( STModuleRequest_t * ), ucSendQueueStorage, &xStaticSendQueue );
+    xReceiveQueue = xQueueCreateStatic( wificonfigMAX_SOCKETS, sizeof( STModuleRequest_t * ), ucReceiveQueueStorage, &xStaticReceiveQueue );
+    configASSERT( xSendQueue );
+    configASSERT( xReceiveQueue );
+
+    xModuleTask = xTaskCreateStatic( prvModuleTask, "WiFi", socketsconfigMODULE_TASK_STACK_DEPTH, NULL, socketsconfigMODULE_TASK_PRIORITY, xStack, &xStaticTask );
+    configASSERT( xModuleTask );
+}
+/*-----------------------------------------------------------*/
+
+static void prvModuleTask( void * pvParameters )
+{
+    STModuleRequest_t * pxRequest;
+
+    /* Remove warning about unused parameters. */
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        /* Every queued request notifies the task, so a request queued
+         * while the others are being carried out is not missed. */
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        for( ; ; )
+        {
+            /* Check the send queue before each receive poll, so a send
+             * waits for at most one AT exchange. */
+            if( xQueueReceive( xSendQueue, &( pxRequest ), 0 ) != pdTRUE )
+            {
+                if( xQueueReceive( xReceiveQueue, &( pxRequest ), 0 ) != pdTRUE )
+                {
+                    break;
+                }
+            }
+
+            prvModuleExecute( pxRequest );
+
+            /* Hand the buffer and the result back to the requesting task. */
+            ( void ) xSemaphoreGive( pxRequest->xDone );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvModuleExecute( STModuleRequest_t * pxRequest )
+{
+    pxRequest->usTransferred = 0;
+
+    /* Connect, close and the WiFi API still use the module directly. */
     if( xSemaphoreTake( xWiFiModule.xSemaphoreHandle, xSemaphoreWaitTicks ) == pdTRUE )
     {
         /* Since WiFi module has only one timeout, this needs
@@ -329,7 +494,7 @@ static BaseType_t prvNetworkSend( void * pvContext,
          * respective send or receive timeout. Also, this
          * must be done after acquiring the semaphore as the
          * xWiFiModule is a shared object.*/
-        if( pxSecureSocket->ulSendTimeout == 0 )
+        if( pxRequest->ulSocketTimeout == 0 )
         {
             /* Set the SPI timeout to the maximum uint32_t value.
              * This is a little over 49 days. */
@@ -343,23 +508,90 @@ static BaseType_t prvNetworkSend( void * pvContext,
             xWiFiModule.xWifiObject.Timeout = ES_WIFI_TIMEOUT;
         }
 
+        if( pxRequest->xType == eModuleSend )
+        {
+            /* Send the data. */
+            pxRequest->xResult = ES_WIFI_SendData( &( xWiFiModule.xWifiObject ),
+                                                   pxRequest->ucSocketNumber,
+                                                   pxRequest->pucData,
+                                                   pxRequest->usLength,
+                                                   &( pxRequest->usTransferred ),
+                                                   pxRequest->ulSocketTimeout );
+        }
+        else
+        {
+            /* Receive the data. */
+            pxRequest->xResult = ES_WIFI_ReceiveData( &( xWiFiModule.xWifiObject ),
+                                                      pxRequest->ucSocketNumber,
+                                                      pxRequest->pucData,
+                                                      pxRequest->usLength,
+                                                      &( pxRequest->usTransferred ),
+                                                      stsecuresocketsMODULE_RECV_TIMEOUT );
+        }
+
+        /* Return the semaphore. */
+        ( void ) xSemaphoreGive( xWiFiModule.xSemaphoreHandle );
+    }
+    else
+    {
+        /* The module stayed busy with another operation. */
+        pxRequest->xResult = ES_WIFI_STATUS_TIMEOUT;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static ES_WIFI_Status_t prvModuleRequest( STModuleRequest_t * pxRequest,
+                                          QueueHandle_t xQueue )
+{
+    ES_WIFI_Status_t xResult = ES_WIFI_STATUS_ERROR;
+
+    if( xQueueSendToBack( xQueue, &( pxRequest ), 0 ) == pdTRUE )
+    {
+        ( void ) xTaskNotifyGive( xModuleTask );
+
+        /* The WiFi module task owns the buffer until the request completes,
+         * and the driver applies the timeouts, so wait as long as it takes. */
+        ( void ) xSemaphoreTake( pxRequest->xDone, portMAX_DELAY );
+        xResult = pxRequest->xResult;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvNetworkSend( void * pvContext,
+                                  const unsigned char * pucData,
+                                  size_t xDataLength )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) pvContext; /*lint !e923 cast is necessary for port. */
+    STSecureSocket_t * pxSecureSocket;
+    STModuleRequest_t * pxRequest;
+    BaseType_t xRetVal = SOCKETS_SOCKET_ERROR;
+    ES_WIFI_Status_t xWiFiResult = SOCKETS_SOCKET_ERROR;
+
+    /* Shortcut for easy access. */
+    pxSecureSocket = &( xSockets[ ulSocketNumber ] );
+    pxRequest = &( pxSecureSocket->xSendRequest );
+
+    /* Only one task at a time can send on the socket. */
+    if( xSemaphoreTake( pxRequest->xLock, xSemaphoreWaitTicks ) == pdTRUE )
+    {
+        pxRequest->pucData = ( uint8_t * ) pucData; /*lint !e9005 STM function does not use const. */
+        pxRequest->usLength = ( uint16_t ) xDataLength;
+        pxRequest->ulSocketTimeout = pxSecureSocket->ulSendTimeout;
+
         /* Send the data. */
-        xWiFiResult = ES_WIFI_SendData( &( xWiFiModule.xWifiObject ),
-                                        ( uint8_t ) ulSocketNumber,
-                                        ( uint8_t * ) pucData, /*lint !e9005 STM function does not use const. */
-                                        ( uint16_t ) xDataLength,
-                                        &( usSentBytes ),
-                                        pxSecureSocket->ulSendTimeout );
+        xWiFiResult = prvModuleRequest( pxRequest, xSendQueue );
 
         if( xWiFiResult == ES_WIFI_STATUS_OK )
         {
             /* If the data was successfully sent, return the actual
              * number of bytes sent. Otherwise return SOCKETS_SOCKET_ERROR. */
-            xRetVal = ( BaseType_t ) usSentBytes;
+            xRetVal = ( BaseType_t ) pxRequest->usTransferred;
         }
 
-        /* Return the semaphore. */
-        ( void ) xSemaphoreGive( xWiFiModule.xSemaphoreHandle );
+        /* Return the lock. */
+        ( void ) xSemaphoreGive( pxRequest->xLock );
     }
 
     /* The following code attempts to revive the Inventek WiFi module
@@ -399,16 +631,53 @@ static BaseType_t prvNetworkSend( void * pvContext,
 }
 /*-----------------------------------------------------------*/
 
+static int32_t prvNetworkSendVector( Socket_t xSocket,
+                                     const SocketsSegment_t * pxSegments,
+                                     size_t xSegmentCount )
+{
+    int32_t lSentBytes = 0;
+    BaseType_t xSegmentBytes;
+    size_t x;
+
+    for( x = 0; x < xSegmentCount; x++ )
+    {
+        xSegmentBytes = prvNetworkSend( xSocket, pxSegments[ x ].pvData, pxSegments[ x ].xLength );
+
+        if( xSegmentBytes < 0 )
+        {
+            /* Report the error only if nothing has been sent yet. */
+            if( lSentBytes == 0 )
+            {
+                lSentBytes = ( int32_t ) xSegmentBytes;
+            }
+
+            break;
+        }
+
+        lSentBytes += ( int32_t ) xSegmentBytes;
+
+        if( ( size_t ) xSegmentBytes < pxSegments[ x ].xLength )
+        {
+            break;
+        }
+    }
+
+    return lSentBytes;
+}
+/*-----------------------------------------------------------*/
+
 static BaseType_t prvNetworkRecv( void * pvContext,
                                   unsigned char * pucReceiveBuffer,
                                   size_t xReceiveBufferLength )
 {
     uint32_t ulSocketNumber = ( uint32_t ) pvContext; /*lint !e923 cast is needed for portability. */
     STSecureSocket_t * pxSecureSocket;
+    STModuleRequest_t * pxRequest;
     uint16_t usReceivedBytes = 0;
     BaseType_t xRetVal;
     ES_WIFI_Status_t xWiFiResult = SOCKETS_SOCKET_ERROR;
-    TickType_t xTimeOnEntering = xTaskGetTickCount(), xSemaphoreWait;
+    TickType_t xTimeOnEntering = xTaskGetTickCount(), xSemaphoreWait, xElapsed;
+    TickType_t xPollDelay = stsecuresocketsMIN_POLL_DELAY;
 
     /* Shortcut for easy access. */
     pxSecureSocket = &( xSockets[ ulSocketNumber ] );
@@ -420,42 +689,22 @@ static BaseType_t prvNetworkRecv( void * pvContext,
         xReceiveBufferLength = ( uint32_t ) ES_WIFI_PAYLOAD_SIZE;
     }
 
-    xSemaphoreWait = pxSecureSocket->ulReceiveTimeout + stsecuresocketsFIVE_MILLISECONDS;
+    xSemaphoreWait = pxSecureSocket->ulReceiveTimeout + stsecuresocketsMAX_POLL_DELAY;
+    pxRequest = &( pxSecureSocket->xReceiveRequest );
 
-    for( ; ; )
+    /* Only one task at a time can receive on the socket. */
+    if( xSemaphoreTake( pxRequest->xLock, xSemaphoreWait ) == pdTRUE )
     {
-        /* Try to acquire the semaphore. */
-        if( xSemaphoreTake( xWiFiModule.xSemaphoreHandle, xSemaphoreWait ) == pdTRUE )
-        {
-            /* Since WiFi module has only one timeout, this needs
-             * to be set per send and receive operation to the
-             * respective send or receive timeout. Also, this
-             * must be done after acquiring the semaphore as the
-             * xWiFiModule is a shared object.*/
-            if( pxSecureSocket->ulReceiveTimeout == 0 )
-            {
-                /* Set the SPI timeout to the maximum uint32_t value.
-                 * This is a little over 49 days. */
-                xWiFiModule.xWifiObject.Timeout = 0xFFFFFFFF;
-            }
-            else
-            {
-                /* The maximum timeout for Inventek module is 30 seconds.
-                 * This timeout is about 65 seconds, so the module should
-                 * timeout before the SPI. */
-                xWiFiModule.xWifiObject.Timeout = ES_WIFI_TIMEOUT;
-            }
-
-            /* Receive the data. */
-            xWiFiResult = ES_WIFI_ReceiveData( &( xWiFiModule.xWifiObject ),
-                                               ( uint8_t ) ulSocketNumber,
-                                               ( uint8_t * ) pucReceiveBuffer,
-                                               ( uint16_t ) xReceiveBufferLength,
-                                               &( usReceivedBytes ),
-                                               stsecuresocketsONE_MILLISECOND );
+        pxRequest->pucData = ( uint8_t * ) pucReceiveBuffer;
+        pxRequest->usLength = ( uint16_t ) xReceiveBufferLength;
+        pxRequest->ulSocketTimeout = pxSecureSocket->ulReceiveTimeout;
 
-            /* Return the semaphore. */
-            ( void ) xSemaphoreGive( xWiFiModule.xSemaphoreHandle );
+        for( ; ; )
+        {
+            /* Receive the data. The module is only held for the poll itself,
+             * so other sockets can send while this one waits for data. */
+            xWiFiResult = prvModuleRequest( pxRequest, xReceiveQueue );
+            usReceivedBytes = pxRequest->usTransferred;
 
             if( ( xWiFiResult == ES_WIFI_STATUS_OK ) && ( usReceivedBytes != 0 ) )
             {
@@ -467,13 +716,28 @@ static BaseType_t prvNetworkRecv( void * pvContext,
             {
                 /* The WiFi poll timed out, but has the socket timeout expired
                  * too? */
-                if( ( xTaskGetTickCount() - xTimeOnEntering ) < pxSecureSocket->ulReceiveTimeout )
+                xElapsed = xTaskGetTickCount() - xTimeOnEntering;
+
+                if( xElapsed < pxSecureSocket->ulReceiveTimeout )
                 {
                     /* The socket has not timed out, but the driver supplied
                      * with the board is polling, which would block other tasks, so
-                     * block for a short while to allow other tasks to run before
-                     * trying again. */
-                    vTaskDelay( stsecuresocketsFIVE_MILLISECONDS );
+                     * block for a while to allow other tasks to run before trying
+                     * again. The longer the socket stays idle, the longer the sleep,
+                     * without oversleeping the socket timeout. */
+                    if( xPollDelay > ( pxSecureSocket->ulReceiveTimeout - xElapsed ) )
+                    {
+                        xPollDelay = pxSecureSocket->ulReceiveTimeout - xElapsed;
+                    }
+
+                    vTaskDelay( xPollDelay );
+
+                    xPollDelay <<= 1;
+
+                    if( xPollDelay > stsecuresocketsMAX_POLL_DELAY )
+                    {
+                        xPollDelay = stsecuresocketsMAX_POLL_DELAY;
+                    }
                 }
                 else
                 {
@@ -491,14 +755,16 @@ static BaseType_t prvNetworkRecv( void * pvContext,
                 break;
             }
         }
-        else
-        {
-            /* Semaphore wait time was longer than the receive timeout so this
-             * is also a socket timeout. Returning SOCKETS_EWOULDBLOCK will
-             * cause mBedTLS to fail and so we must return zero.*/
-            xRetVal = 0;
-            break;
-        }
+
+        /* Return the lock. */
+        ( void ) xSemaphoreGive( pxRequest->xLock );
+    }
+    else
+    {
+        /* Lock wait time was longer than the receive timeout so this
+         * is also a socket timeout. Returning SOCKETS_EWOULDBLOCK will
+         * cause mBedTLS to fail and so we must return zero.*/
+        xRetVal = 0;
     }
 
     /* The following code attempts to revive the Inventek WiFi module
@@ -864,6 +1130,78 @@ int32_t SOCKETS_Send( Socket_t xSocket,
 }
 /*-----------------------------------------------------------*/
 
+int32_t SOCKETS_SendVector( Socket_t xSocket,
+                            const SocketsSegment_t * pxSegments,
+                            size_t xSegmentCount,
+                            uint32_t ulFlags )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket; /*lint !e923 cast required for portability. */
+    STSecureSocket_t * pxSecureSocket;
+    int32_t lSentBytes = SOCKETS_SOCKET_ERROR;
+
+    #ifndef USE_OFFLOAD_SSL
+        TLSSegment_t xTLSSegments[ SOCKETS_MAX_SEND_SEGMENTS ];
+        size_t x;
+    #endif
+
+    /* Remove warning about unused parameters. */
+    ( void ) ulFlags;
+
+    /* Ensure that a valid socket was passed and the passed segments
+     * are not NULL. */
+    if( ( prvIsValidSocket( ulSocketNumber ) == pdTRUE ) &&
+        ( pxSegments != NULL ) )
+    {
+        /* Shortcut for easy access. */
+        pxSecureSocket = &( xSockets[ ulSocketNumber ] );
+
+        if( xSegmentCount > ( size_t ) SOCKETS_MAX_SEND_SEGMENTS )
+        {
+            lSentBytes = SOCKETS_EINVAL;
+        }
+        /* Check that send is allowed on the socket. */
+        else if( ( pxSecureSocket->ulFlags & stsecuresocketsSOCKET_WRITE_CLOSED_FLAG ) == 0UL )
+        {
+            #ifndef USE_OFFLOAD_SSL
+                if( ( pxSecureSocket->ulFlags & stsecuresocketsSOCKET_SECURE_FLAG ) != 0UL )
+                {
+                    for( x = 0; x < xSegmentCount; x++ )
+                    {
+                        xTLSSegments[ x ].pucData = ( const unsigned char * ) pxSegments[ x ].pvData;
+                        xTLSSegments[ x ].xLength = pxSegments[ x ].xLength;
+                    }
+
+                    /* Send through TLS pipe, the segments share records. */
+                    lSentBytes = TLS_SendVector( pxSecureSocket->pvTLSContext, xTLSSegments, xSegmentCount );
+
+                    /* Convert the error code. */
+                    if( lSentBytes < 0 )
+                    {
+                        /* TLS_SendVector failed. */
+                        lSentBytes = SOCKETS_TLS_SEND_ERROR;
+                    }
+                }
+                else
+                {
+                    /* Send un-encrypted. */
+                    lSentBytes = prvNetworkSendVector( xSocket, pxSegments, xSegmentCount );
+                }
+            #else /* USE_OFFLOAD_SSL */
+                /* Always send using prvNetworkSendVector if using offload SSL. */
+                lSentBytes = prvNetworkSendVector( xSocket, pxSegments, xSegmentCount );
+            #endif /* USE_OFFLOAD_SSL */
+        }
+        else
+        {
+            /* The socket has been closed for write. */
+            lSentBytes = SOCKETS_ECLOSED;
+        }
+    }
+
+    return lSentBytes;
+}
+/*-----------------------------------------------------------*/
+
 int32_t SOCKETS_Shutdown( Socket_t xSocket,
                           uint32_t ulHow )
 {
@@ -1197,7 +1535,13 @@ BaseType_t SOCKETS_Init( void )
         xSockets[ ulIndex ].ulFlags |= stsecuresocketsSOCKET_WRITE_CLOSED_FLAG;
     }
 
-    /* Empty initialization for ST board. */
+    /* The WiFi module task is kept when the sockets are reinitialized
+     * after a module reset. */
+    if( xModuleTask == NULL )
+    {
+        prvCreateModuleTask();
+    }
+
     return pdPASS;
 }
 /*-----------------------------------------------------------*/
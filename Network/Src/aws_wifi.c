@@ -665,6 +665,29 @@ BaseType_t WIFI_IsConnected( void )
 }
 /*-----------------------------------------------------------*/
 
+WIFIReturnCode_t WIFI_PollConnected( BaseType_t * pxIsConnected )
+{
+    WIFIReturnCode_t xRetVal = eWiFiTimeout;
+    /* Expected result from ES_WIFI_IsConnected() when the board is connected to Wi-Fi. */
+    const uint8_t uConnected = 1;
+
+    configASSERT( pxIsConnected != NULL );
+
+    /* Only query the module if it is idle, the caller keeps its last state otherwise. */
+    if( xSemaphoreTake( xWiFiModule.xSemaphoreHandle, 0 ) == pdTRUE )
+    {
+        /* Check whether or not the WiFi module is connected to any AP. */
+        *pxIsConnected = ( ES_WIFI_IsConnected( &xWiFiModule.xWifiObject ) == uConnected ) ? pdTRUE : pdFALSE;
+        xRetVal = eWiFiSuccess;
+
+        /* Return the semaphore. */
+        xSemaphoreGive( xWiFiModule.xSemaphoreHandle );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 #ifdef USE_OFFLOAD_SSL
 
     /**
@@ -82,6 +82,9 @@ static void AT_ParseConnSettings(char *pdata, ES_WIFI_Network_t *NetSettings);
 static void AT_ParseTransportSettings(char *pdata, ES_WIFI_Transport_t *TransportSettings);
 static void AT_ParseIsConnected(char *pdata, uint8_t *isConnected);
 static ES_WIFI_Status_t AT_ExecuteCommand(ES_WIFIObject_t *Obj, uint8_t* cmd, uint8_t *pdata);
+static void AT_ClearSocketCache(ES_WIFIObject_t *Obj);
+static ES_WIFI_Status_t AT_SelectSocket(ES_WIFIObject_t *Obj, uint8_t Socket);
+static ES_WIFI_Status_t AT_SetReadParameters(ES_WIFIObject_t *Obj, uint16_t Reqlen, uint32_t Timeout);
 
 uint32_t HAL_GetTick(void);
 /* Private functions ---------------------------------------------------------*/
@@ -734,7 +737,11 @@ static ES_WIFI_Status_t AT_RequestSendData(ES_WIFIObject_t *Obj, uint8_t* cmd, u
   cmd_len = strlen((char*)cmd);
 
   /* can send only even number of byte on first send */
-  if (cmd_len & 1) return ES_WIFI_STATUS_ERROR;
+  if (cmd_len & 1)
+  {
+    UNLOCK_WIFI();
+    return ES_WIFI_STATUS_ERROR;
+  }
   n=Obj->fops.IO_Send(cmd, cmd_len, Obj->Timeout);
   if (n == cmd_len)
   {    
@@ -770,9 +777,11 @@ static ES_WIFI_Status_t AT_RequestSendData(ES_WIFIObject_t *Obj, uint8_t* cmd, u
     }
     else
     {
+      UNLOCK_WIFI();
       return ES_WIFI_STATUS_ERROR;
     }
   }
+  UNLOCK_WIFI();
   return ES_WIFI_STATUS_IO_ERROR;
 }
 
@@ -797,6 +806,7 @@ static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd
     len = Obj->fops.IO_Receive(p, 0 , Obj->Timeout);
     if ((p[0]!='\r') || (p[1]!='\n'))
     {
+     UNLOCK_WIFI();
      return  ES_WIFI_STATUS_IO_ERROR;
     }
     len-=2;
@@ -838,6 +848,90 @@ static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd
 }
 
 
+/**
+  * @brief  Forget the socket and read parameters last programmed into the module.
+  * @note   Must be called whenever the module state can no longer be trusted
+  *         (reset, connection start/stop, I/O error), so the next receive
+  *         re-sends every parameter.
+  * @param  Obj: pointer to module handle
+  */
+static void AT_ClearSocketCache(ES_WIFIObject_t *Obj)
+{
+  Obj->ActiveSocket = ES_WIFI_SOCKET_UNKNOWN;
+  Obj->ReadLen = ES_WIFI_READLEN_UNKNOWN;
+  Obj->ReadTimeout = ES_WIFI_TIMEOUT_UNKNOWN;
+}
+
+/**
+  * @brief  Select the socket for the following commands, P0 is only sent when
+  *         the socket differs from the one already selected.
+  * @param  Obj: pointer to module handle
+  * @param  Socket: number of the socket
+  * @retval Operation Status.
+  */
+static ES_WIFI_Status_t AT_SelectSocket(ES_WIFIObject_t *Obj, uint8_t Socket)
+{
+  ES_WIFI_Status_t ret = ES_WIFI_STATUS_OK;
+
+  if (Obj->ActiveSocket != Socket)
+  {
+    /* Read parameters may be held per socket, so they are re-sent after a switch */
+    AT_ClearSocketCache(Obj);
+
+    sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
+    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    if (ret == ES_WIFI_STATUS_OK)
+    {
+      Obj->ActiveSocket = Socket;
+    }
+  }
+  return ret;
+}
+
+/**
+  * @brief  Program the read length (R1) and read timeout (R2) of the selected
+  *         socket, each command is only sent when its value changed.
+  * @param  Obj: pointer to module handle
+  * @param  Reqlen: requested data length
+  * @param  Timeout: read timeout in mS
+  * @retval Operation Status.
+  */
+static ES_WIFI_Status_t AT_SetReadParameters(ES_WIFIObject_t *Obj, uint16_t Reqlen, uint32_t Timeout)
+{
+  ES_WIFI_Status_t ret = ES_WIFI_STATUS_OK;
+
+  if (Obj->ReadLen != Reqlen)
+  {
+    Obj->ReadLen = ES_WIFI_READLEN_UNKNOWN;
+    sprintf((char*)Obj->CmdData,"R1=%d\r", Reqlen);
+    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    if (ret == ES_WIFI_STATUS_OK)
+    {
+      Obj->ReadLen = Reqlen;
+    }
+    else
+    {
+      DEBUG("setting requested len failed\n");
+    }
+  }
+
+  if ((ret == ES_WIFI_STATUS_OK) && (Obj->ReadTimeout != Timeout))
+  {
+    Obj->ReadTimeout = ES_WIFI_TIMEOUT_UNKNOWN;
+    sprintf((char*)Obj->CmdData,"R2=%lu\r", Timeout);
+    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    if (ret == ES_WIFI_STATUS_OK)
+    {
+      Obj->ReadTimeout = Timeout;
+    }
+    else
+    {
+      DEBUG("setting timeout failed\n");
+    }
+  }
+  return ret;
+}
+
 /**
   * @brief  Initialize WIFI module.
   * @param  Obj: pointer to module handle
@@ -850,6 +944,7 @@ ES_WIFI_Status_t  ES_WIFI_Init(ES_WIFIObject_t *Obj)
   LOCK_WIFI();  
 
   Obj->Timeout = ES_WIFI_TIMEOUT;
+  AT_ClearSocketCache(Obj);
 
   if (Obj->fops.IO_Init(ES_WIFI_INIT) == 0)
   {
@@ -959,6 +1054,8 @@ ES_WIFI_Status_t  ES_WIFI_RegisterBusIO(ES_WIFIObject_t *Obj, IO_Init_Func IO_In
   Obj->fops.IO_Receive = IO_Receive;
   Obj->fops.IO_Delay = IO_Delay;
 
+  RTOS_CREATE_SEM_MUTEX();
+
   return ES_WIFI_STATUS_OK;
 }
 
@@ -1124,6 +1221,7 @@ ES_WIFI_Status_t ES_WIFI_Disconnect(ES_WIFIObject_t *Obj)
 {
    ES_WIFI_Status_t ret;
    LOCK_WIFI();  
+   AT_ClearSocketCache(Obj);
    sprintf((char*)Obj->CmdData,"CD\r");
    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
    UNLOCK_WIFI();
@@ -1358,6 +1456,7 @@ ES_WIFI_Status_t ES_WIFI_ResetModule(ES_WIFIObject_t *Obj)
   int ret;
   LOCK_WIFI();  
 
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"ZR\r");
   ret = Obj->fops.IO_Send(Obj->CmdData, strlen((char*)Obj->CmdData), Obj->Timeout);
 #if (ES_WIFI_USE_UART == 0)
@@ -1381,6 +1480,7 @@ ES_WIFI_Status_t ES_WIFI_HardResetModule(ES_WIFIObject_t *Obj)
 {
   int ret;
   LOCK_WIFI();  
+  AT_ClearSocketCache(Obj);
   ret = Obj->fops.IO_Init(ES_WIFI_RESET);
   UNLOCK_WIFI();
   return (ret > 0) ? ES_WIFI_STATUS_OK : ES_WIFI_STATUS_ERROR;
@@ -1604,6 +1704,7 @@ ES_WIFI_Status_t ES_WIFI_StartClientConnection(ES_WIFIObject_t *Obj, ES_WIFI_Con
   
   LOCK_WIFI();  
 
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", conn->Number);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
 
@@ -1659,6 +1760,7 @@ ES_WIFI_Status_t ES_WIFI_StopClientConnection(ES_WIFIObject_t *Obj, ES_WIFI_Conn
   ES_WIFI_Status_t ret;
   LOCK_WIFI();  
 
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", conn->Number);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
 
@@ -1684,6 +1786,7 @@ ES_WIFI_Status_t ES_WIFI_StartAWSClientConnection(ES_WIFIObject_t *Obj, ES_WIFI_
   ES_WIFI_Status_t ret;
   LOCK_WIFI();  
 
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", conn->Number);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
 
@@ -1747,6 +1850,7 @@ ES_WIFI_Status_t ES_WIFI_StartServerSingleConn(ES_WIFIObject_t *Obj, ES_WIFI_Con
   ES_WIFI_Status_t ret = ES_WIFI_STATUS_OK;
   LOCK_WIFI();  
     
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", conn->Number);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
   if(ret != ES_WIFI_STATUS_OK)
@@ -1887,6 +1991,7 @@ ES_WIFI_Status_t  ES_WIFI_WaitServerConnection(ES_WIFIObject_t *Obj,uint32_t tim
     t = HAL_GetTick();
   } 
   while ((timeout==0) ||((t < tlast) || (t < tstart)));
+  UNLOCK_WIFI();
   return ES_WIFI_STATUS_TIMEOUT;
 }
 
@@ -1900,6 +2005,7 @@ ES_WIFI_Status_t ES_WIFI_CloseServerConnection(ES_WIFIObject_t *Obj, int socket)
 {
   ES_WIFI_Status_t ret;
   LOCK_WIFI();  
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", socket);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
   if(ret != ES_WIFI_STATUS_OK)
@@ -1931,6 +2037,7 @@ ES_WIFI_Status_t ES_WIFI_StopServerSingleConn(ES_WIFIObject_t *Obj, int socket)
 {
   ES_WIFI_Status_t ret;
   LOCK_WIFI();  
+  AT_ClearSocketCache(Obj);
   sprintf((char*)Obj->CmdData,"P0=%d\r", socket);
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
   if(ret != ES_WIFI_STATUS_OK)
@@ -1969,6 +2076,7 @@ ES_WIFI_Status_t ES_WIFI_StartServerMultiConn(ES_WIFIObject_t *Obj, ES_WIFI_Conn
   ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
   if(ret == ES_WIFI_STATUS_OK)
   {
+    AT_ClearSocketCache(Obj);
     sprintf((char*)Obj->CmdData,"P0=%d\r", conn->Number);
     ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
     if(ret == ES_WIFI_STATUS_OK)
@@ -2088,8 +2196,7 @@ ES_WIFI_Status_t ES_WIFI_SendData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t
   if(Reqlen >= ES_WIFI_PAYLOAD_SIZE ) Reqlen= ES_WIFI_PAYLOAD_SIZE;
 
   *SentLen = Reqlen;
-  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  ret = AT_SelectSocket(Obj, Socket);
   if(ret == ES_WIFI_STATUS_OK)
   {
     sprintf((char*)Obj->CmdData,"S2=%lu\r",Timeout);
@@ -2127,6 +2234,10 @@ ES_WIFI_Status_t ES_WIFI_SendData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t
   {
     *SentLen = 0;
   }
+  if (ret != ES_WIFI_STATUS_OK)
+  {
+    AT_ClearSocketCache(Obj);
+  }
   UNLOCK_WIFI();
   return ret;
 }
@@ -2136,8 +2247,7 @@ ES_WIFI_Status_t  ES_WIFI_SendDataTo(ES_WIFIObject_t *Obj, uint8_t Socket, uint8
   ES_WIFI_Status_t ret = ES_WIFI_STATUS_ERROR;
   LOCK_WIFI();  
 
-  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  ret = AT_SelectSocket(Obj, Socket);
 
   if (ret == ES_WIFI_STATUS_OK)
   {
@@ -2224,34 +2334,23 @@ ES_WIFI_Status_t ES_WIFI_ReceiveData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8
 
   if(Reqlen <= ES_WIFI_PAYLOAD_SIZE )
   {
-    sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    /* Socket, length and timeout are sticky within the module, only changes are sent */
+    ret = AT_SelectSocket(Obj, Socket);
 
     if(ret == ES_WIFI_STATUS_OK)
     {
-      sprintf((char*)Obj->CmdData,"R1=%d\r", Reqlen);
-      ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+      ret = AT_SetReadParameters(Obj, Reqlen, Timeout);
       if(ret == ES_WIFI_STATUS_OK)
       {
-        sprintf((char*)Obj->CmdData,"R2=%lu\r", Timeout);
-        ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
-        if(ret == ES_WIFI_STATUS_OK)
+        sprintf((char*)Obj->CmdData,"R0\r");
+        ret = AT_RequestReceiveData(Obj, Obj->CmdData, (char *)pdata, Reqlen, Receivedlen);
+        if (ret != ES_WIFI_STATUS_OK)
         {
-          sprintf((char*)Obj->CmdData,"R0\r");
-          ret = AT_RequestReceiveData(Obj, Obj->CmdData, (char *)pdata, Reqlen, Receivedlen);
-          if (ret != ES_WIFI_STATUS_OK)
-          {
-            DEBUG("AT_RequestReceiveData  failed\n"); 
-          }
-        }
-        else
-        {
-         DEBUG("setting timeout failed\n"); 
+          DEBUG("AT_RequestReceiveData  failed\n"); 
         }
       }
       else
       {
-        DEBUG("setting requested len failed\n"); 
         *Receivedlen = 0;
       }
     }
@@ -2260,6 +2359,11 @@ ES_WIFI_Status_t ES_WIFI_ReceiveData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8
       DEBUG("setting socket for read failed\n"); 
       issue15++;
     }
+
+    if (ret != ES_WIFI_STATUS_OK)
+    {
+      AT_ClearSocketCache(Obj);
+    }
   }
   UNLOCK_WIFI();
   return ret;
@@ -2274,39 +2378,23 @@ ES_WIFI_Status_t  ES_WIFI_ReceiveDataFrom(ES_WIFIObject_t *Obj, uint8_t Socket,
 
   if (Reqlen <= ES_WIFI_PAYLOAD_SIZE )
   {
-    sprintf((char*)Obj->CmdData, "P0=%d\r", Socket);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    ret = AT_SelectSocket(Obj, Socket);
   }
 
   if(ret == ES_WIFI_STATUS_OK)
   {
-    sprintf((char*)Obj->CmdData,"R1=%d\r", Reqlen);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    ret = AT_SetReadParameters(Obj, Reqlen, Timeout);
   }
   else
   {
     DEBUG("P0 failed.\n");
   }
 
-  if(ret == ES_WIFI_STATUS_OK)
-  {
-    sprintf((char*)Obj->CmdData,"R2=%lu\r", Timeout);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
-  }
-  else
-  {
-    DEBUG("R1 failed.\n");
-  }
-
   if(ret == ES_WIFI_STATUS_OK)
   {
     sprintf((char*)Obj->CmdData,"R0\r");
     ret = AT_RequestReceiveData(Obj, Obj->CmdData, (char *)pdata, Reqlen, Receivedlen);
   }
-  else
-  {
-    DEBUG("R2 failed.\n");
-  }
 
   if (ret == ES_WIFI_STATUS_OK)
   {
@@ -2339,6 +2427,7 @@ ES_WIFI_Status_t  ES_WIFI_ReceiveDataFrom(ES_WIFIObject_t *Obj, uint8_t Socket,
   {
     DEBUG("Read error:\n%s\n", Obj->CmdData);
     *Receivedlen = 0;
+    AT_ClearSocketCache(Obj);
   }
   UNLOCK_WIFI();
   return ret;
@@ -2460,8 +2549,7 @@ ES_WIFI_Status_t ES_WIFI_GetTrSettings(ES_WIFIObject_t *Obj, uint8_t Socket, ES_
 {
   ES_WIFI_Status_t ret;
 
-  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  ret = AT_SelectSocket(Obj, Socket);
 
   if (ret == ES_WIFI_STATUS_OK)
   {
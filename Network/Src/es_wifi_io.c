@@ -51,6 +51,8 @@
 #include <string.h>
 #include "es_wifi_conf.h"
 #include <core_cm4.h>
+#include "task.h"
+#include "systime.h"
 
 /* Private define ------------------------------------------------------------*/
 #define MIN(a, b)  ((a) < (b) ? (a) : (b))
@@ -61,7 +63,15 @@ extern SPI_HandleTypeDef hspi3;
 static  int volatile spi_rx_event=0;
 static  int volatile spi_tx_event=0;
 static  int volatile cmddata_rdy_rising_event=0;
-
+SemaphoreHandle_t es_wifi_mutex = NULL;
+SemaphoreHandle_t spi_rx_sem = NULL;
+SemaphoreHandle_t spi_tx_sem = NULL;
+SemaphoreHandle_t cmddata_rdy_rising_sem = NULL;
+#if (ES_WIFI_USE_SPI_DMA == 1)
+static  int volatile spi_rx_dma_active=0;
+static  uint16_t spi_rx_dma_size=0;
+static  uint16_t volatile spi_rx_dma_length=0;
+#endif
 
 
 /* Private function prototypes -----------------------------------------------*/
@@ -69,7 +79,14 @@ static  int wait_cmddata_rdy_high(int timeout);
 static  int wait_cmddata_rdy_rising_event(int timeout);
 static  int wait_spi_tx_event(int timeout);
 static  int wait_spi_rx_event(int timeout);
+#ifdef SEM_WAIT
+static  int wait_event(int volatile *event, SemaphoreHandle_t sem, int timeout);
+#endif
 static  void SPI_WIFI_DelayUs(uint32_t);
+#if (ES_WIFI_USE_SPI_DMA == 1)
+static  int16_t SPI_WIFI_ReceiveFrame_DMA(uint8_t *pData, uint16_t len, uint32_t timeout);
+static  void SPI_WIFI_StopReceive_DMA(void);
+#endif
 /* Private functions ---------------------------------------------------------*/
 /*******************************************************************************
                        COM Driver Interface (SPI)
@@ -264,6 +281,45 @@ int8_t SPI_WIFI_ResetModule(void)
   return 0;
 }
 
+/**
+  * @brief  Create the mutex and semaphores used by LOCK_WIFI() and SEM_WAIT(). Only the first
+  *         call creates them, they persist for the life of the application.
+  * @param  None
+  * @retval None
+  */
+void SPI_WIFI_CreateSemMutex(void)
+{
+  static StaticSemaphore_t es_wifi_mutex_buffer;
+  static StaticSemaphore_t spi_rx_sem_buffer;
+  static StaticSemaphore_t spi_tx_sem_buffer;
+  static StaticSemaphore_t cmddata_rdy_rising_sem_buffer;
+
+  taskENTER_CRITICAL();
+  if (es_wifi_mutex == NULL)
+  {
+    spi_rx_sem = xSemaphoreCreateBinaryStatic(&spi_rx_sem_buffer);
+    spi_tx_sem = xSemaphoreCreateBinaryStatic(&spi_tx_sem_buffer);
+    cmddata_rdy_rising_sem = xSemaphoreCreateBinaryStatic(&cmddata_rdy_rising_sem_buffer);
+    es_wifi_mutex = xSemaphoreCreateRecursiveMutexStatic(&es_wifi_mutex_buffer);
+  }
+  taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Signal a semaphore from the SPI/DMA or CMD/DATA-ready interrupts.
+  * @note   Also called from task context with interrupts disabled, see
+  *         SPI_WIFI_StopReceive_DMA(), the yield is then pended until they are enabled.
+  * @param  sem: semaphore to give
+  * @retval None
+  */
+void SPI_WIFI_SemSignal(SemaphoreHandle_t sem)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+  xSemaphoreGiveFromISR(sem, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 /**
   * @brief  DeInitialize the SPI
   * @param  None
@@ -288,6 +344,17 @@ int8_t SPI_WIFI_DeInit(void)
 
 int wait_cmddata_rdy_high(int timeout)
 {
+#ifdef SEM_WAIT
+  /* The rising edge interrupt ends the wait, the level is checked after arming so an edge
+   * in between is not missed */
+  cmddata_rdy_rising_event=1;
+  if (WIFI_IS_CMDDATA_READY())
+  {
+    cmddata_rdy_rising_event=0;
+    return 0;
+  }
+  return wait_event(&cmddata_rdy_rising_event, cmddata_rdy_rising_sem, timeout);
+#else
   int tickstart = HAL_GetTick();
   while (WIFI_IS_CMDDATA_READY()==0)
   {
@@ -297,6 +364,7 @@ int wait_cmddata_rdy_high(int timeout)
     }
   }
   return 0;
+#endif
 }
 
 
@@ -304,7 +372,7 @@ int wait_cmddata_rdy_high(int timeout)
 int wait_cmddata_rdy_rising_event(int timeout)
 {
 #ifdef SEM_WAIT
-   return SEM_WAIT(cmddata_rdy_rising_sem, timeout); 
+   return wait_event(&cmddata_rdy_rising_event, cmddata_rdy_rising_sem, timeout);
 #else
   int tickstart = HAL_GetTick();
   while (cmddata_rdy_rising_event==1)
@@ -321,7 +389,7 @@ int wait_cmddata_rdy_rising_event(int timeout)
 int wait_spi_rx_event(int timeout)
 {
 #ifdef SEM_WAIT
-   return SEM_WAIT(spi_rx_sem, timeout); 
+   return wait_event(&spi_rx_event, spi_rx_sem, timeout);
 #else
   int tickstart = HAL_GetTick();
   while (spi_rx_event==1)
@@ -338,7 +406,7 @@ int wait_spi_rx_event(int timeout)
 int wait_spi_tx_event(int timeout)
 {
 #ifdef SEM_WAIT
-   return SEM_WAIT(spi_tx_sem, timeout); 
+   return wait_event(&spi_tx_event, spi_tx_sem, timeout);
 #else
   int tickstart = HAL_GetTick();
   while (spi_tx_event==1)
@@ -352,6 +420,34 @@ int wait_spi_tx_event(int timeout)
 #endif
 }
 
+#ifdef SEM_WAIT
+/**
+  * @brief  Block until an interrupt clears the event flag, or the timeout elapses.
+  * @note   The flag is authoritative, the semaphore only wakes the task. A signal left
+  *         behind by an earlier wait that timed out can not end this wait early.
+  * @param  event: flag set when the operation was started, cleared by the interrupt
+  * @param  sem: semaphore signaled by the interrupt
+  * @param  timeout: timeout in mS
+  * @retval 0 once the event has occurred, -1 on timeout
+  */
+static int wait_event(int volatile *event, SemaphoreHandle_t sem, int timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+  uint32_t elapsed;
+
+  while (*event==1)
+  {
+    elapsed = HAL_GetTick() - tickstart;
+    if (elapsed > (uint32_t)timeout)
+    {
+      return -1;
+    }
+    SEM_WAIT(sem, (uint32_t)timeout - elapsed + 1);
+  }
+  return 0;
+}
+#endif
+
 
 
 int16_t SPI_WIFI_ReceiveData(uint8_t *pData, uint16_t len, uint32_t timeout)
@@ -372,6 +468,23 @@ int16_t SPI_WIFI_ReceiveData(uint8_t *pData, uint16_t len, uint32_t timeout)
   LOCK_SPI();  
   WIFI_ENABLE_NSS(); 
   SPI_WIFI_DelayUs(15);
+
+#if (ES_WIFI_USE_SPI_DMA == 1)
+  /* DMA moves halfwords, an unaligned buffer falls back to word by word transfers */
+  if (((uint32_t)pData & 1U) == 0U)
+  {
+    length = SPI_WIFI_ReceiveFrame_DMA(pData, len, timeout);
+    WIFI_DISABLE_NSS();
+    if (length >= ES_WIFI_DATA_SIZE)
+    {
+      SPI_WIFI_ResetModule();
+      length = ES_WIFI_ERROR_STUFFING_FOREVER;
+    }
+    UNLOCK_SPI();
+    return length;
+  }
+#endif
+
   while (WIFI_IS_CMDDATA_READY())
   {
     if((length < len) || (!len))
@@ -406,6 +519,93 @@ int16_t SPI_WIFI_ReceiveData(uint8_t *pData, uint16_t len, uint32_t timeout)
   UNLOCK_SPI();
   return length;
 }
+#if (ES_WIFI_USE_SPI_DMA == 1)
+/**
+  * @brief  Receive one frame from the module with a single DMA transfer.
+  * @note   The module frames its response with the CMD/DATA-ready line, so the
+  *         DMA is armed for the largest possible frame and stopped by
+  *         SPI_WIFI_ISR() on the falling edge of CMD/DATA-ready. NSS must already
+  *         be asserted.
+  * @param  pData : pointer to data, must be halfword aligned
+  * @param  len : Data length, zero to read until the end of frame
+  * @param  timeout : receive timeout in mS
+  * @retval Length of received data, or a negative error code
+  */
+static int16_t SPI_WIFI_ReceiveFrame_DMA(uint8_t *pData, uint16_t len, uint32_t timeout)
+{
+  uint16_t size = ((len == 0) || (len > ES_WIFI_DATA_SIZE)) ? ES_WIFI_DATA_SIZE : len;
+
+  spi_rx_dma_size = (size + 1) / 2;
+  spi_rx_dma_length = 0;
+  spi_rx_event=1;
+  spi_rx_dma_active=1;
+  if (HAL_SPI_Receive_DMA(&hspi3, pData, spi_rx_dma_size) != HAL_OK)
+  {
+    spi_rx_dma_active=0;
+    spi_rx_event=0;
+    return ES_WIFI_ERROR_SPI_FAILED;
+  }
+
+  /* The frame may have ended before the transfer was armed, in which case the
+   * falling edge has already been missed. */
+  if (!WIFI_IS_CMDDATA_READY())
+  {
+    __disable_irq();
+    SPI_WIFI_StopReceive_DMA();
+    __enable_irq();
+  }
+
+  if (wait_spi_rx_event(timeout) < 0)
+  {
+    __disable_irq();
+    SPI_WIFI_StopReceive_DMA();
+    __enable_irq();
+  }
+
+  return spi_rx_dma_length;
+}
+
+/**
+  * @brief  Stop an ongoing DMA frame reception and record how much was received.
+  * @note   Called from interrupt context, or with interrupts disabled. The SPI and
+  *         its DMA channels are stopped directly, HAL_SPI_Abort() polls for the
+  *         transfer to wind down and must not be used here. The frame has already
+  *         ended, so the dummy halfword being clocked when the SPI stops is of no
+  *         interest.
+  * @retval None
+  */
+static void SPI_WIFI_StopReceive_DMA(void)
+{
+  if (spi_rx_dma_active)
+  {
+    spi_rx_dma_active=0;
+
+    /* Reference manual order: DMA channels, then the SPI, then its DMA requests */
+    __HAL_SPI_DISABLE_IT(&hspi3, SPI_IT_ERR);
+    (void)HAL_DMA_Abort(hspi3.hdmatx);
+    (void)HAL_DMA_Abort(hspi3.hdmarx);
+    __HAL_SPI_DISABLE(&hspi3);
+    CLEAR_BIT(hspi3.Instance->CR2, SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+
+    spi_rx_dma_length = 2 * (spi_rx_dma_size - __HAL_DMA_GET_COUNTER(hspi3.hdmarx));
+
+    /* Drop what is left in the RX FIFO, nothing more arrives once disabled */
+    while ((hspi3.Instance->SR & SPI_SR_FRLVL) != SPI_FRLVL_EMPTY)
+    {
+      (void)hspi3.Instance->DR;
+    }
+    __HAL_SPI_CLEAR_OVRFLAG(&hspi3);
+    hspi3.State = HAL_SPI_STATE_READY;
+
+    if (spi_rx_event)
+    {
+      SEM_SIGNAL(spi_rx_sem);
+      spi_rx_event=0;
+    }
+  }
+}
+#endif
+
 /**
   * @brief  Send wifi Data thru SPI
   * @param  pdata : pointer to data
@@ -429,8 +629,21 @@ int16_t SPI_WIFI_SendData( uint8_t *pdata,  uint16_t len, uint32_t timeout)
   SPI_WIFI_DelayUs(15);
   if (len > 1)
   {
+    HAL_StatusTypeDef status;
+
     spi_tx_event=1;
-    if( HAL_SPI_Transmit_IT(&hspi3, (uint8_t *)pdata , len/2) != HAL_OK)
+#if (ES_WIFI_USE_SPI_DMA == 1)
+    if (((uint32_t)pdata & 1U) == 0U)
+    {
+      status = HAL_SPI_Transmit_DMA(&hspi3, (uint8_t *)pdata , len/2);
+    }
+    else
+#endif
+    {
+      status = HAL_SPI_Transmit_IT(&hspi3, (uint8_t *)pdata , len/2);
+    }
+
+    if( status != HAL_OK)
     {
       WIFI_DISABLE_NSS();
       UNLOCK_SPI();
@@ -464,7 +677,14 @@ int16_t SPI_WIFI_SendData( uint8_t *pdata,  uint16_t len, uint32_t timeout)
   */
 void SPI_WIFI_Delay(uint32_t Delay)
 {
-  HAL_Delay(Delay);
+  if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+  {
+    vTaskDelay(pdMS_TO_TICKS(Delay));
+  }
+  else
+  {
+    HAL_Delay(Delay);
+  }
 }
 
  /**
@@ -474,27 +694,7 @@ void SPI_WIFI_Delay(uint32_t Delay)
   */
 void SPI_WIFI_DelayUs(uint32_t n)
 {
-	volatile      uint32_t ct;
-	uint32_t       loop_per_us;
-	static  uint32_t cycle_per_loop=0;
-
-	// calibration happen on first call for a duration of 1 ms * nbcycle per loop
-	// 10 cycle for STM32L4
-	if (cycle_per_loop == 0 )
-	{
-		uint32_t cycle_per_ms = (SystemCoreClock/1000L);
-		uint32_t   t;
-		ct=cycle_per_ms;
-		t=HAL_GetTick();
-		while(ct) ct--;
-		cycle_per_loop=HAL_GetTick()-t;
-		if (cycle_per_loop==0) cycle_per_loop=1;
-	}
-
-	loop_per_us = SystemCoreClock/1000000/cycle_per_loop;
-	ct = n * loop_per_us;
-	while(ct) ct--;
-	return;
+  SysTime_DelayUs(n);
 }
 
 /**
@@ -506,6 +706,14 @@ void SPI_WIFI_DelayUs(uint32_t n)
 
 void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
 {
+#if (ES_WIFI_USE_SPI_DMA == 1)
+  if (spi_rx_dma_active)
+  {
+    /* Buffer filled before the end of frame */
+    spi_rx_dma_active=0;
+    spi_rx_dma_length = 2 * spi_rx_dma_size;
+  }
+#endif
   if (spi_rx_event)
   {
     SEM_SIGNAL(spi_rx_sem);
@@ -536,6 +744,15 @@ void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
   */
 void    SPI_WIFI_ISR(void)
 {
+   /* Falling edge, end of the frame being received */
+   if (!WIFI_IS_CMDDATA_READY())
+   {
+#if (ES_WIFI_USE_SPI_DMA == 1)
+     SPI_WIFI_StopReceive_DMA();
+#endif
+     return;
+   }
+
    if (cmddata_rdy_rising_event==1)  
    {
      SEM_SIGNAL(cmddata_rdy_rising_sem);
@@ -182,10 +182,25 @@ typedef struct MQTTAgentPublishParams
     const uint8_t * pucTopic; /**< The topic string on which the message should be published. */
     uint16_t usTopicLength;   /**< The length of the topic. */
     MQTTQoS_t xQoS;           /**< Quality of Service (QoS). */
-    const void * pvData;      /**< The data to publish. This data is copied into the MQTT buffers and therefore the user can free the buffer after the MQTT_AGENT_Publish call returns. */
+    const void * pvData;      /**< The data to publish. This data has been sent by the time MQTT_AGENT_Publish returns, so the user can then free the buffer. With MQTT_AGENT_PublishAsync it must remain valid until the completion callback. */
     uint32_t ulDataLength;    /**< Length of the data. */
 } MQTTAgentPublishParams_t;
 
+/**
+ * @brief Signature of the callback that reports the outcome of MQTT_AGENT_PublishAsync.
+ *
+ * The callback runs in the context of the MQTT agent task, so it must not block or call
+ * any MQTT agent API.
+ *
+ * @param[in] pvCallbackContext The context supplied to MQTT_AGENT_PublishAsync.
+ * @param[in] ulMessageId The message ID returned by MQTT_AGENT_PublishAsync.
+ * @param[in] xResult eMQTTAgentSuccess once the PUBACK is received (QoS1) or the message is
+ * sent (QoS0), eMQTTAgentTimeout if no PUBACK arrived in time, eMQTTAgentFailure otherwise.
+ */
+typedef void ( * MQTTAgentPublishCallback_t )( void * pvCallbackContext,
+                                               uint32_t ulMessageId,
+                                               MQTTAgentReturnCode_t xResult );
+
 /**
  * @brief MQTT library Init function.
  *
@@ -339,6 +354,36 @@ MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
                                           const MQTTAgentPublishParams_t * const pxPublishParams,
                                           TickType_t xTimeoutTicks );
 
+/**
+ * @brief Publishes a message to a given topic without waiting for the result.
+ *
+ * The request is queued to the MQTT agent task and the function returns at once, so a task
+ * can have several QoS1 messages awaiting their PUBACK. Up to mqttconfigMAX_PARALLEL_OPS
+ * operations, including those of the blocking APIs, may be outstanding on a connection;
+ * a publish beyond that completes with eMQTTAgentFailure. The publish parameters are copied,
+ * but the topic and data must remain valid until pxCallback is invoked.
+ *
+ * Unlike the blocking APIs, this function does not alter the calling task's notification
+ * state and value.
+ *
+ * @param[in] xMQTTHandle The opaque handle as returned from MQTT_AGENT_Create.
+ * @param[in] pxPublishParams Publish parameters.
+ * @param[in] pxCallback Invoked once with the outcome of the publish. Must not be NULL.
+ * @param[in] pvCallbackContext Passed as it is to pxCallback.
+ * @param[out] pulMessageId The ID passed to pxCallback for this message. Can be NULL.
+ * @param[in] xTimeoutTicks Maximum time in ticks to wait for space in the command queue, and
+ * then for the PUBACK. Use pdMS_TO_TICKS macro to convert milliseconds to ticks.
+ *
+ * @return eMQTTAgentSuccess if the publish was queued, in which case pxCallback will be
+ * invoked, otherwise an error code explaining the reason of the failure is returned.
+ */
+MQTTAgentReturnCode_t MQTT_AGENT_PublishAsync( MQTTAgentHandle_t xMQTTHandle,
+                                               const MQTTAgentPublishParams_t * const pxPublishParams,
+                                               MQTTAgentPublishCallback_t pxCallback,
+                                               void * pvCallbackContext,
+                                               uint32_t * pulMessageId,
+                                               TickType_t xTimeoutTicks );
+
 /**
  * @brief Returns the buffer provided in the publish callback.
  *
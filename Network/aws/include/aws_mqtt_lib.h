@@ -43,6 +43,9 @@
 /* MQTT buffer includes. */
 #include "aws_mqtt_buffer.h"
 
+/* MQTT topic filter index includes. */
+#include "aws_mqtt_topic_index.h"
+
 /**
  * @defgroup FixedHeaderSize Macros to define MQTT fixed header size.
  *
@@ -369,6 +372,38 @@ typedef uint32_t ( * MQTTSend_t )( void * pvSendContext,
                                    const uint8_t * const pucData,
                                    uint32_t ulDataLength );
 
+/**
+ * @brief One segment of a packet passed to the vectored send callback.
+ */
+typedef struct MQTTSendSegment
+{
+    const uint8_t * pucData; /**< Start of the segment. */
+    uint32_t ulDataLength;   /**< Length of the segment in bytes. */
+} MQTTSendSegment_t;
+
+/**
+ * @brief The most segments the library passes to the vectored send callback.
+ */
+#define mqttMAX_SEND_SEGMENTS    ( 4 )
+
+/**
+ * @brief Signature of the optional user supplied callback to transmit a packet
+ * held in several segments.
+ *
+ * The segments must go out in order as one stream of bytes. It lets a publish
+ * send the caller's payload directly instead of copying it into a buffer from
+ * the buffer pool first.
+ *
+ * @param[in] pvSendContext The send context as supplied by the user in Init parameters.
+ * @param[in] pxSegments The segments to transmit, in order.
+ * @param[in] ulSegmentCount The number of segments, at most mqttMAX_SEND_SEGMENTS.
+ *
+ * @return The number of bytes actually transmitted.
+ */
+typedef uint32_t ( * MQTTSendVector_t )( void * pvSendContext,
+                                         const MQTTSendSegment_t * pxSegments,
+                                         uint32_t ulSegmentCount );
+
 /**
  * @brief Signature of the callback to get the current tick count.
  *
@@ -435,8 +470,12 @@ typedef void ( * MQTTReturnBuffer_t )( uint8_t * pucBuffer );
 
     typedef struct MQTTSubscriptionManager
     {
-        MQTTSubscription_t xSubscriptions[ mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ]; /**< User subscriptions. */
-        uint32_t ulInUseSubscriptions;                                                         /**< Number of subscription entries currently in use. */
+        MQTTSubscription_t xSubscriptions[ mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];                            /**< User subscriptions. */
+        uint32_t ulInUseSubscriptions;                                                                                    /**< Number of subscription entries currently in use. */
+        MQTTTopicIndex_t xTopicIndex;                                                                                     /**< Index of the topic filters, one entry per subscription. */
+        MQTTTopicNode_t xTopicNodes[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES ];                                    /**< Storage for the topic filter index nodes. */
+        MQTTTopicEntry_t xTopicEntries[ mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];                               /**< Storage for the topic filter index entries. */
+        uint16_t usTopicEdges[ mqtttopicindexNUM_EDGES( mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES ) ];                /**< Storage for the topic filter index edges. */
     } MQTTSubscriptionManager_t;
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
@@ -481,6 +520,7 @@ typedef struct MQTTContext
     MQTTEventCallback_t pxCallback;                             /**< Callback supplied  by the user to get notified of various events. */
     void * pvSendContext;                                       /**< As supplied by the user in Init parameters. */
     MQTTSend_t pxMQTTSendFxn;                                   /**< Callback supplied by the user to transmit data. */
+    MQTTSendVector_t pxMQTTSendVectorFxn;                       /**< Optional callback supplied by the user to transmit segmented data. */
     MQTTGetTicks_t pxGetTicksFxn;                               /**< Callback supplied by the user to get current tick count. */
     MQTTBufferPoolInterface_t xBufferPoolInterface;             /**< The buffer pool interface supplied by the user. @see MQTTBufferPoolInterface_t. */
     MQTTConnectionState_t xConnectionState;                     /**< The current connection state. */
@@ -505,6 +545,7 @@ typedef struct MQTTInitParams
     MQTTEventCallback_t pxCallback;                 /**< User supplied callback to get notified of various events. Can be NULL. @see MQTTEventCallback_t.*/
     void * pvSendContext;                           /**< Passed as it is in the send callback. */
     MQTTSend_t pxMQTTSendFxn;                       /**< User supplied callback to transmit data. Must not be NULL. @see MQTTSend_t. */
+    MQTTSendVector_t pxMQTTSendVectorFxn;           /**< User supplied callback to transmit segmented data. Can be NULL, publishes are then copied into a pool buffer. @see MQTTSendVector_t. */
     MQTTGetTicks_t pxGetTicksFxn;                   /**< User supplied callback to get the current tick count. Can be NULL. @see MQTTGetTicks_t. */
     MQTTBufferPoolInterface_t xBufferPoolInterface; /**< User supplied buffer pool interface. @see MQTTBufferPoolInterface_t. */
 } MQTTInitParams_t;
@@ -677,6 +718,11 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
  * packet on the waiting ACK list which is removed when the corresponding PUBACK
  * is received or the operation times out.
  *
+ * If a vectored send callback was supplied in the Init parameters, only the
+ * fixed and variable headers are written to a buffer from the buffer pool. The
+ * topic and payload are sent straight from the caller's memory, so the payload
+ * is not limited by the size of the pool buffers.
+ *
  * @param[in] pxMQTTContext The initialized MQTT context.
  * @param[in] pxPublishParams Publish parameters.
  *
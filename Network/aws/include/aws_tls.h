@@ -98,6 +98,41 @@ typedef struct xTLS_PARAMS
     void * pvCallerContext;
 } TLSParams_t;
 
+/**
+ * @brief Handshake timing, accumulated since power-up.
+ *
+ * A full handshake performs the certificate exchange and key agreement, a
+ * resumed handshake reuses the master secret from a previous session.
+ *
+ * @param[out] ulFullCount Number of completed full handshakes.
+ * @param[out] ulFullLastMs Duration of the most recent full handshake.
+ * @param[out] ulFullMaxMs Longest full handshake.
+ * @param[out] ulResumedCount Number of completed resumed handshakes.
+ * @param[out] ulResumedLastMs Duration of the most recent resumed handshake.
+ * @param[out] ulResumedMaxMs Longest resumed handshake.
+ */
+typedef struct xTLS_HANDSHAKE_METRICS
+{
+    uint32_t ulFullCount;
+    uint32_t ulFullLastMs;
+    uint32_t ulFullMaxMs;
+    uint32_t ulResumedCount;
+    uint32_t ulResumedLastMs;
+    uint32_t ulResumedMaxMs;
+} TLSHandshakeMetrics_t;
+
+/**
+ * @brief One segment of a vectored send.
+ *
+ * @param[in] pucData Start of the segment.
+ * @param[in] xLength Length of the segment in bytes.
+ */
+typedef struct xTLS_SEGMENT
+{
+    const unsigned char * pucData;
+    size_t xLength;
+} TLSSegment_t;
+
 /**
  * @brief Initializes the TLS context.
  *
@@ -145,6 +180,30 @@ BaseType_t TLS_Send( void * pvContext,
                      const unsigned char * pucMsg,
                      size_t xMsgLength );
 
+/**
+ * @brief Writes a list of segments to the secure connection as one stream.
+ *
+ * Segments are gathered straight into the TLS record being built, so small
+ * headers and a large payload share records without first being copied into
+ * a contiguous buffer.
+ *
+ * @param pvContext Opaque context handle for TLS library.
+ * @param pxSegments Segments to be encrypted and then sent, in order.
+ * @param xSegmentCount Number of entries in pxSegments.
+ *
+ * @return Number of bytes sent. Error return codes have the high bit set.
+ */
+BaseType_t TLS_SendVector( void * pvContext,
+                           const TLSSegment_t * pxSegments,
+                           size_t xSegmentCount );
+
+/**
+ * @brief Reports handshake timing for full and resumed sessions.
+ *
+ * @param[out] pxMetrics Location to write a snapshot of the metrics.
+ */
+void TLS_GetHandshakeMetrics( TLSHandshakeMetrics_t * pxMetrics );
+
 /**
  * @brief Frees resources consumed by the TLS context.
  *
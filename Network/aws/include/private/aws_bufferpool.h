@@ -49,7 +49,7 @@ lib_initDECLARE_LIB_INIT( BUFFERPOOL_Init );
  * @brief Gets a free buffer from the central buffer pool.
  *
  * It tries to get a free buffer of the given length from the
- * buffer pool. If a free buffer of the requested length or more
+ * smallest size class of the buffer pool which can hold it. If a free buffer of the requested length or more
  * is available, it is returned and pulBufferLength is updated to
  * the actual length of the buffer. Otherwise NULL is returned to
  * indicate failure.
@@ -70,4 +70,28 @@ uint8_t * BUFFERPOOL_GetFreeBuffer( uint32_t * pulBufferLength );
  */
 void BUFFERPOOL_ReturnBuffer( uint8_t * const pucBuffer );
 
+/**
+ * @brief Usage statistics of one buffer size class.
+ */
+typedef struct BufferPoolStats
+{
+    uint32_t ulBufferSize;         /**< Size of each buffer in the class. */
+    uint16_t usNumBuffers;         /**< Number of buffers in the class. */
+    uint16_t usInUse;              /**< Number of buffers currently in use. */
+    uint16_t usPeakInUse;          /**< Largest number of buffers in use at once. */
+    uint32_t ulAllocationFailures; /**< Requests this class was the best fit for, that could not be met. */
+} BufferPoolStats_t;
+
+/**
+ * @brief Gets the usage statistics of the buffer size classes, smallest
+ * buffer size first.
+ *
+ * @param[out] pxStats Array to receive the statistics.
+ * @param[in] ulMaxClasses Number of elements in pxStats.
+ *
+ * @return The number of size classes written to pxStats.
+ */
+uint32_t BUFFERPOOL_GetStats( BufferPoolStats_t * pxStats,
+                              uint32_t ulMaxClasses );
+
 #endif /* _AWS_BUFFER_POOL_H_ */
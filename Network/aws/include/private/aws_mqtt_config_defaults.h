@@ -73,6 +73,30 @@
     #define mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS    ( 8 )
 #endif
 
+/**
+ * @brief Maximum number of levels in a topic filter which can be stored in
+ * subscription manager.
+ *
+ * The subscribe operation will fail if the user tries to subscribe to a topic
+ * filter with more levels than the maximum specified here. AWS IoT allows
+ * at most 7 forward slashes, i.e. 8 levels, in a topic filter.
+ */
+#ifndef mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS
+    #define mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS    ( 8 )
+#endif
+
+/**
+ * @brief Number of nodes in the topic filter index of subscription manager,
+ * including the root node.
+ *
+ * Each level of a stored topic filter takes one node, shared with the other
+ * topic filters which start with the same levels. The subscribe operation
+ * will fail if there is no node left to store a topic filter.
+ */
+#ifndef mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES
+    #define mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES    ( ( mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS * 4 ) + 1 )
+#endif
+
 /**
  * @brief Define mqttconfigASSERT to enable asserts.
  *
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/**
+ * @file aws_mqtt_topic_index.h
+ * @brief Topic filter index of the MQTT subscription manager.
+ *
+ * The subscribed topic filters are kept in a trie with one node per topic
+ * level, so that finding the filters which match the topic of a received
+ * publish message costs in proportion to the number of levels in the topic,
+ * not the number of subscriptions. Each node has its '+' and '#' children
+ * linked directly, while children for plain levels are found through an open
+ * addressing hash table keyed on the parent node and a hash of the level.
+ *
+ * All the storage is supplied by the user, so that it can be statically
+ * allocated. Entries are identified by their index in the entry array, which
+ * the MQTT library keeps equal to the index of the subscription in the
+ * subscription manager.
+ *
+ * Two filters with different levels that happen to hash to the same value
+ * share the same node. The match functions therefore only return candidates,
+ * which the caller must compare with the actual topic filter.
+ */
+
+#ifndef _AWS_MQTT_TOPIC_INDEX_H_
+#define _AWS_MQTT_TOPIC_INDEX_H_
+
+/* Standard includes. */
+#include <stdint.h>
+
+/**
+ * @brief The amount of storage needed in the edge hash table for the given
+ * number of nodes. The table is kept at most half full.
+ *
+ * @param[in] usMaxNodes The number of nodes in the index.
+ */
+#define mqtttopicindexNUM_EDGES( usMaxNodes )    ( 2U * ( usMaxNodes ) )
+
+/**
+ * @brief Result of adding a topic filter to the index.
+ */
+typedef enum
+{
+    eMQTTTopicIndexSuccess = 0,   /**< The topic filter was added. */
+    eMQTTTopicIndexTooManyLevels, /**< The topic filter has more than mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS levels. */
+    eMQTTTopicIndexFull           /**< No node left to store the topic filter. */
+} MQTTTopicIndexStatus_t;
+
+/**
+ * @brief Returned by the match callback to either continue with the next
+ * candidate or stop the search.
+ */
+typedef enum
+{
+    eMQTTTopicIndexContinue = 0, /**< Continue with the next candidate. */
+    eMQTTTopicIndexStop          /**< Stop the search. */
+} MQTTTopicIndexAction_t;
+
+/**
+ * @brief Called for each candidate entry found by a match function.
+ *
+ * @param[in] pvContext The context passed to the match function.
+ * @param[in] usEntry The index of the candidate entry.
+ *
+ * @return eMQTTTopicIndexStop to end the search, eMQTTTopicIndexContinue otherwise.
+ */
+typedef MQTTTopicIndexAction_t ( * MQTTTopicIndexCallback_t )( void * pvContext,
+                                                                uint16_t usEntry );
+
+/**
+ * @brief A node of the trie, representing one level of a topic filter.
+ */
+typedef struct MQTTTopicNode
+{
+    uint32_t ulLevelHash;   /**< Hash of the topic level, for a plain level. */
+    uint16_t usParent;      /**< The parent node, or the next free node while the node is free. */
+    uint16_t usPlusChild;   /**< The '+' child node, zero if none. */
+    uint16_t usHashChild;   /**< The '#' child node, zero if none. */
+    uint16_t usFirstEntry;  /**< The first entry whose topic filter ends at this node. */
+    uint16_t usReferences;  /**< Number of child nodes and entries, the node is freed when none are left. */
+    uint8_t ucLevelType;    /**< Whether the node is for a plain, '+' or '#' level. */
+} MQTTTopicNode_t;
+
+/**
+ * @brief An entry of the index, representing one topic filter.
+ */
+typedef struct MQTTTopicEntry
+{
+    uint16_t usNode;      /**< The node at which the topic filter ends, zero if the entry is not in use. */
+    uint16_t usNextEntry; /**< The next entry whose topic filter ends at the same node. */
+    uint8_t ucWildCard;   /**< Whether the topic filter contains wild-cards. */
+} MQTTTopicEntry_t;
+
+/**
+ * @brief The topic filter index.
+ */
+typedef struct MQTTTopicIndex
+{
+    MQTTTopicNode_t * pxNodes;    /**< The nodes, node 0 is the root. */
+    MQTTTopicEntry_t * pxEntries; /**< The entries. */
+    uint16_t * pusEdges;          /**< Hash table of the plain level child nodes, zero if the slot is empty. */
+    uint16_t usMaxNodes;          /**< Number of elements in pxNodes. */
+    uint16_t usMaxEntries;        /**< Number of elements in pxEntries. */
+    uint16_t usNumEdges;          /**< Number of elements in pusEdges. */
+    uint16_t usFreeNodes;         /**< The first free node, zero if none. */
+} MQTTTopicIndex_t;
+
+/**
+ * @brief Initializes an empty index in the given storage.
+ *
+ * @param[out] pxIndex The index to initialize.
+ * @param[in] pxNodes Storage for the nodes, at least 2.
+ * @param[in] usMaxNodes The number of elements in pxNodes, at most 32767.
+ * @param[in] pxEntries Storage for the entries.
+ * @param[in] usMaxEntries The number of elements in pxEntries.
+ * @param[in] pusEdges Storage for the edge hash table, of
+ * mqtttopicindexNUM_EDGES( usMaxNodes ) elements.
+ */
+void MQTT_TopicIndexInit( MQTTTopicIndex_t * pxIndex,
+                          MQTTTopicNode_t * pxNodes,
+                          uint16_t usMaxNodes,
+                          MQTTTopicEntry_t * pxEntries,
+                          uint16_t usMaxEntries,
+                          uint16_t * pusEdges );
+
+/**
+ * @brief Adds a topic filter to the index.
+ *
+ * @warning The topic filter must be valid and the entry must not be in use.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usEntry The entry to use for the topic filter.
+ * @param[in] pucTopicFilter The topic filter.
+ * @param[in] usTopicFilterLength The length of the topic filter.
+ *
+ * @return eMQTTTopicIndexSuccess if the topic filter was added, otherwise the
+ * reason of failure.
+ */
+MQTTTopicIndexStatus_t MQTT_TopicIndexInsert( MQTTTopicIndex_t * pxIndex,
+                                              uint16_t usEntry,
+                                              const uint8_t * const pucTopicFilter,
+                                              uint16_t usTopicFilterLength );
+
+/**
+ * @brief Removes a topic filter from the index, freeing the nodes no longer
+ * used by other topic filters.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usEntry The entry used for the topic filter.
+ */
+void MQTT_TopicIndexRemove( MQTTTopicIndex_t * pxIndex,
+                            uint16_t usEntry );
+
+/**
+ * @brief Finds the topic filters without wild-cards which are equal to the
+ * given topic.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] pucTopic The topic.
+ * @param[in] usTopicLength The length of the topic.
+ * @param[in] pxCallback Called for each candidate entry.
+ * @param[in] pvContext Passed as it is to pxCallback.
+ *
+ * @return eMQTTTopicIndexStop if the callback stopped the search,
+ * eMQTTTopicIndexContinue otherwise.
+ */
+MQTTTopicIndexAction_t MQTT_TopicIndexMatchSimple( const MQTTTopicIndex_t * pxIndex,
+                                                   const uint8_t * const pucTopic,
+                                                   uint16_t usTopicLength,
+                                                   MQTTTopicIndexCallback_t pxCallback,
+                                                   void * pvContext );
+
+/**
+ * @brief Finds the topic filters with wild-cards which match the given topic.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] pucTopic The topic.
+ * @param[in] usTopicLength The length of the topic.
+ * @param[in] pxCallback Called for each candidate entry.
+ * @param[in] pvContext Passed as it is to pxCallback.
+ *
+ * @return eMQTTTopicIndexStop if the callback stopped the search,
+ * eMQTTTopicIndexContinue otherwise.
+ */
+MQTTTopicIndexAction_t MQTT_TopicIndexMatchWildCard( const MQTTTopicIndex_t * pxIndex,
+                                                     const uint8_t * const pucTopic,
+                                                     uint16_t usTopicLength,
+                                                     MQTTTopicIndexCallback_t pxCallback,
+                                                     void * pvContext );
+
+#endif /* _AWS_MQTT_TOPIC_INDEX_H_ */
@@ -137,7 +137,8 @@ typedef enum
     eMQTTDisconnectRequest,  /**< Disconnect the connection to an MQTT broker. */
     eMQTTSubscribeRequest,   /**< Initiate a subscribe to a topic.  _TODO_ Currently limited to one topic per subscribe message. */
     eMQTTUnsubscribeRequest, /**< Initiate unsubscribe from a topic.  _TODO_ Currently limited to one topic per unsubscribe message. */
-    eMQTTPublishRequest      /**< Initiate a publish to a topic.  _TODO_ Currently limited to one topic per publish message. */
+    eMQTTPublishRequest,     /**< Initiate a publish to a topic.  _TODO_ Currently limited to one topic per publish message. */
+    eMQTTPublishAsyncRequest /**< Initiate a publish whose result is reported through a callback instead of a task notification. */
 } MQTTAction_t;
 
 /**
@@ -173,8 +174,10 @@ typedef enum
  */
 typedef struct MQTTNotificationData
 {
-    TaskHandle_t xTaskToNotify;   /**< The handle of the task to notify. */
-    uint32_t ulMessageIdentifier; /**< Used to match a request going from application task to MQTT task with response going the other way. */
+    TaskHandle_t xTaskToNotify;                   /**< The handle of the task to notify. */
+    uint32_t ulMessageIdentifier;                 /**< Used to match a request going from application task to MQTT task with response going the other way. */
+    MQTTAgentPublishCallback_t pxPublishCallback; /**< If not NULL, called with the result instead of notifying xTaskToNotify (asynchronous publish). */
+    void * pvPublishCallbackContext;              /**< Passed as it is to pxPublishCallback. */
 } MQTTNotificationData_t;
 
 /**
@@ -199,6 +202,7 @@ typedef struct MQTTEventData
         const MQTTAgentUnsubscribeParams_t * pxUnsubscribeParams; /**< Unsubscribe Parameters. */
         const MQTTAgentPublishParams_t * pxPublishParams;         /**< Publish Parameters. */
     } u;
+    MQTTAgentPublishParams_t xPublishParams; /**< Copy of the publish parameters for eMQTTPublishAsyncRequest, as the requesting task does not wait. */
 } MQTTEventData_t;
 
 /**
@@ -286,6 +290,24 @@ static uint32_t prvMQTTSendCallback( void * pvSendContext,
                                      const uint8_t * const pucData,
                                      uint32_t ulDataLength );
 
+/**
+ * @brief The callback registered with the core MQTT library to transmit a packet
+ * held in several segments.
+ *
+ * Sends the segments with SOCKETS_SendVector so a publish payload goes out from
+ * the caller's memory without first being copied into a pool buffer.
+ * @param[in] pvSendContext The send context is broker number in our case.
+ *
+ * @param[in] pxSegments The segments to transmit, in order.
+ * @param[in] ulSegmentCount The number of segments.
+ *
+ * @return The number of actually transmitted bytes. Can be less than the total
+ * length of the segments if transmission fails for some reason.
+ */
+static uint32_t prvMQTTSendVectorCallback( void * pvSendContext,
+                                           const MQTTSendSegment_t * pxSegments,
+                                           uint32_t ulSegmentCount );
+
 /**
  * @brief The callback registered with the core MQTT library to receive various MQTT events.
  *
@@ -607,6 +629,23 @@ static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData );
  */
 static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEventData );
 
+/**
+ * @brief Allocates the message identifier for an event about to be posted to the command queue.
+ *
+ * @param[in] pxEventData The event to allocate the message identifier for.
+ */
+static void prvSetMessageIdentifier( MQTTEventData_t * pxEventData );
+
+/**
+ * @brief Converts the notification value sent by the MQTT task to the return code of the
+ * MQTT agent API which requested the operation.
+ *
+ * @param[in] ulNotificationValue The notification value, see prvNotifyRequestingTask.
+ *
+ * @return eMQTTAgentSuccess, eMQTTAgentTimeout or eMQTTAgentFailure.
+ */
+static MQTTAgentReturnCode_t prvNotificationToReturnCode( uint32_t ulNotificationValue );
+
 /**
  * @brief Implements the task that manages the MQTT protocol.
  *
@@ -677,6 +716,89 @@ static uint32_t prvMQTTSendCallback( void * pvSendContext,
     return ulBytesSent;
 }
 /*-----------------------------------------------------------*/
+
+static uint32_t prvMQTTSendVectorCallback( void * pvSendContext,
+                                           const MQTTSendSegment_t * pxSegments,
+                                           uint32_t ulSegmentCount )
+{
+    MQTTBrokerConnection_t * pxConnection;
+    UBaseType_t uxBrokerNumber = ( UBaseType_t ) pvSendContext; /*lint !e923 The cast is ok as we passed the index of the client before. */
+    SocketsSegment_t xSegments[ SOCKETS_MAX_SEND_SEGMENTS ];
+    int32_t lSendRetVal;
+    uint32_t ulBytesSent = 0, ulFirstSegment = 0, x;
+    size_t xSentBytes;
+    TimeOut_t xTimestamp;
+    TickType_t xTicksToWait = pdMS_TO_TICKS( mqttconfigTCP_SEND_TIMEOUT_MS );
+
+    /* Broker number must be valid and the segments must fit. */
+    configASSERT( uxBrokerNumber < ( UBaseType_t ) mqttconfigMAX_BROKERS );
+    configASSERT( ulSegmentCount <= ( uint32_t ) SOCKETS_MAX_SEND_SEGMENTS );
+
+    /* Record the timestamp when this function was called. */
+    vTaskSetTimeOutState( &( xTimestamp ) );
+
+    /* Get the actual connection to the broker. */
+    pxConnection = &( xMQTTConnections[ uxBrokerNumber ] );
+
+    for( x = 0; x < ulSegmentCount; x++ )
+    {
+        xSegments[ x ].pvData = pxSegments[ x ].pucData;
+        xSegments[ x ].xLength = ( size_t ) pxSegments[ x ].ulDataLength;
+    }
+
+    /* Keep re-trying until timeout or any error
+     * other than SOCKETS_EWOULDBLOCK occurs. */
+    while( ulFirstSegment < ulSegmentCount )
+    {
+        /* Check for timeout and if timeout has occurred, stop retrying. */
+        if( xTaskCheckForTimeOut( &( xTimestamp ), &( xTicksToWait ) ) == pdTRUE )
+        {
+            break;
+        }
+
+        /* Try sending the remaining segments. */
+        lSendRetVal = SOCKETS_SendVector( pxConnection->xSocket,
+                                          &( xSegments[ ulFirstSegment ] ),
+                                          ( size_t ) ( ulSegmentCount - ulFirstSegment ),
+                                          0 );
+
+        /* A negative return value from SOCKETS_SendVector
+         * means some error occurred. */
+        if( lSendRetVal < 0 )
+        {
+            /* Since the socket is non-blocking, send can return
+             * SOCKETS_EWOULDBLOCK, in which case we retry again until
+             * timeout. In case of any other error, we stop re-trying. */
+            if( lSendRetVal != SOCKETS_EWOULDBLOCK )
+            {
+                break;
+            }
+        }
+        else
+        {
+            /* Update the count of sent bytes. */
+            ulBytesSent += ( uint32_t ) lSendRetVal;
+
+            /* Skip the segments sent in full, and the sent part of the next. */
+            xSentBytes = ( size_t ) lSendRetVal;
+
+            while( ( ulFirstSegment < ulSegmentCount ) && ( xSentBytes >= xSegments[ ulFirstSegment ].xLength ) )
+            {
+                xSentBytes -= xSegments[ ulFirstSegment ].xLength;
+                ulFirstSegment++;
+            }
+
+            if( ulFirstSegment < ulSegmentCount )
+            {
+                xSegments[ ulFirstSegment ].pvData = &( ( ( const uint8_t * ) xSegments[ ulFirstSegment ].pvData )[ xSentBytes ] );
+                xSegments[ ulFirstSegment ].xLength -= xSentBytes;
+            }
+        }
+    }
+
+    return ulBytesSent;
+}
+/*-----------------------------------------------------------*/
 static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
                                         const MQTTEventCallbackParams_t * const pxParams )
 {
@@ -1268,8 +1390,18 @@ static void prvNotifyRequestingTask( MQTTNotificationData_t * const pxNotificati
         pxNotificationData->ulMessageIdentifier |= ( UBaseType_t ) xNotificationCode;
         pxNotificationData->ulMessageIdentifier |= uxStatus;
 
-        /* Notify the task. */
-        ( void ) xTaskNotify( pxNotificationData->xTaskToNotify, pxNotificationData->ulMessageIdentifier, eSetValueWithoutOverwrite );
+        if( pxNotificationData->pxPublishCallback != NULL )
+        {
+            /* An asynchronous publish, the requesting task is not waiting. */
+            pxNotificationData->pxPublishCallback( pxNotificationData->pvPublishCallbackContext,
+                                                   mqttMESSAGE_IDENTIFIER_EXTRACT( pxNotificationData->ulMessageIdentifier ),
+                                                   prvNotificationToReturnCode( pxNotificationData->ulMessageIdentifier ) );
+        }
+        else
+        {
+            /* Notify the task. */
+            ( void ) xTaskNotify( pxNotificationData->xTaskToNotify, pxNotificationData->ulMessageIdentifier, eSetValueWithoutOverwrite );
+        }
 
         /* Free up the buffer for further use. */
         pxNotificationData->xTaskToNotify = NULL;
@@ -1654,6 +1786,7 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
 
     /* Setup notification data. */
     pxEventData->xNotificationData.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    pxEventData->xNotificationData.pxPublishCallback = NULL;
 
     /* Commands must not be sent from the MQTT task itself (which could be
      * the case if a command is sent from a callback function).  Otherwise
@@ -1661,22 +1794,7 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
      * resulting in deadlock. */
     if( pxEventData->xNotificationData.xTaskToNotify != xMQTTTaskHandle )
     {
-        taskENTER_CRITICAL();
-        {
-            /* The message identifier is used to know which message is being
-             * acknowledged.  A critical region is used as a single message identifier
-             * variable is used by all connections. The identifier uses the top 16-bits
-             * of the 32-bit word, leaving the lowest 16-bits free for use by the MQTT
-             * task to return a status code. */
-            pxEventData->xNotificationData.ulMessageIdentifier = ulQueueMessageIdentifier;
-            ulQueueMessageIdentifier += mqttMESSAGE_IDENTIFIER_MIN;
-
-            if( ulQueueMessageIdentifier >= mqttMESSAGE_IDENTIFIER_MAX )
-            {
-                ulQueueMessageIdentifier = mqttMESSAGE_IDENTIFIER_MIN;
-            }
-        }
-        taskEXIT_CRITICAL();
+        prvSetMessageIdentifier( pxEventData );
 
         /* Record the time at which this event is created. */
         vTaskSetTimeOutState( &( pxEventData->xEventCreationTimestamp ) );
@@ -1711,30 +1829,8 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
 
                 if( pxEventData->xNotificationData.ulMessageIdentifier == ( ulReceivedMessageIdentifier & mqttMESSAGE_IDENTIFIER_MASK ) )
                 {
-                    /* A reply to the message was received.  The low 16-bits
-                     * contain a status code, of which the least significant it
-                     * is 1 (pdPASS) if the status code indicates a pass, and
-                     * 0 (pdFAIL) if the status code indicates a fail. */
-
-                    if( ( ulReceivedMessageIdentifier & mqttNOTIFICATION_STATUS_MASK ) != ( uint32_t ) pdPASS )
-                    {
-                        /* A reply to the message was received, but the operation
-                         * failed. Check if the failure reason was timeout. */
-                        if( ( ulReceivedMessageIdentifier & mqttNOTIFICATION_CODE_MASK ) == ( uint32_t ) eMQTTOperationTimedOut )
-                        {
-                            xReturnCode = eMQTTAgentTimeout;
-                        }
-
-                        mqttconfigDEBUG_LOG( ( "Command sent to MQTT task failed.\r\n" ) );
-                    }
-                    else
-                    {
-                        /* A reply to the message was received and the operation
-                         * passed. */
-                        mqttconfigDEBUG_LOG( ( "Command sent to MQTT task passed.\r\n" ) );
-                        xReturnCode = eMQTTAgentSuccess;
-                    }
-
+                    /* A reply to the message was received. */
+                    xReturnCode = prvNotificationToReturnCode( ulReceivedMessageIdentifier );
                     break;
                 }
                 else
@@ -1759,6 +1855,55 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
 }
 /*-----------------------------------------------------------*/
 
+static void prvSetMessageIdentifier( MQTTEventData_t * pxEventData )
+{
+    taskENTER_CRITICAL();
+    {
+        /* The message identifier is used to know which message is being
+         * acknowledged.  A critical region is used as a single message identifier
+         * variable is used by all connections. The identifier uses the top 16-bits
+         * of the 32-bit word, leaving the lowest 16-bits free for use by the MQTT
+         * task to return a status code. */
+        pxEventData->xNotificationData.ulMessageIdentifier = ulQueueMessageIdentifier;
+        ulQueueMessageIdentifier += mqttMESSAGE_IDENTIFIER_MIN;
+
+        if( ulQueueMessageIdentifier >= mqttMESSAGE_IDENTIFIER_MAX )
+        {
+            ulQueueMessageIdentifier = mqttMESSAGE_IDENTIFIER_MIN;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static MQTTAgentReturnCode_t prvNotificationToReturnCode( uint32_t ulNotificationValue )
+{
+    MQTTAgentReturnCode_t xReturnCode = eMQTTAgentFailure;
+
+    /* The low 16-bits contain a status code, of which the least significant
+     * bit is 1 (pdPASS) if the status code indicates a pass, and 0 (pdFAIL)
+     * if the status code indicates a fail. */
+    if( ( ulNotificationValue & mqttNOTIFICATION_STATUS_MASK ) != ( uint32_t ) pdPASS )
+    {
+        /* The operation failed. Check if the failure reason was timeout. */
+        if( ( ulNotificationValue & mqttNOTIFICATION_CODE_MASK ) == ( uint32_t ) eMQTTOperationTimedOut )
+        {
+            xReturnCode = eMQTTAgentTimeout;
+        }
+
+        mqttconfigDEBUG_LOG( ( "Command sent to MQTT task failed.\r\n" ) );
+    }
+    else
+    {
+        /* The operation passed. */
+        mqttconfigDEBUG_LOG( ( "Command sent to MQTT task passed.\r\n" ) );
+        xReturnCode = eMQTTAgentSuccess;
+    }
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
 static void prvMQTTTask( void * pvParameters )
 {
     MQTTEventData_t xMQTTCommand;
@@ -1820,6 +1965,12 @@ static void prvMQTTTask( void * pvParameters )
                         prvInitiateMQTTPublish( &( xMQTTCommand ) );
                         break;
 
+                    case eMQTTPublishAsyncRequest:
+                        /* The parameters travel inside the command itself. */
+                        xMQTTCommand.u.pxPublishParams = &( xMQTTCommand.xPublishParams );
+                        prvInitiateMQTTPublish( &( xMQTTCommand ) );
+                        break;
+
                     default:
                         /* Anything else is illegal. */
                         mqttconfigDEBUG_LOG( ( "Unknown request received on command queue.\r\n" ) );
@@ -1880,6 +2031,7 @@ BaseType_t MQTT_AGENT_Init( void )
             xInitParams.pxCallback = prvMQTTEventCallback;
             xInitParams.pvSendContext = ( void * ) x;     /*lint !e923 The cast is ok as we are passing the index of the client. */
             xInitParams.pxMQTTSendFxn = prvMQTTSendCallback;
+            xInitParams.pxMQTTSendVectorFxn = prvMQTTSendVectorCallback;
             xInitParams.pxGetTicksFxn = prvMQTTGetTicks;
             xInitParams.xBufferPoolInterface.pxGetBufferFxn = mqttconfigGET_FREE_BUFFER_FXN;
             xInitParams.xBufferPoolInterface.pxReturnBufferFxn = mqttconfigRETURN_BUFFER_FXN;
@@ -2066,6 +2218,68 @@ MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
 }
 /*-----------------------------------------------------------*/
 
+MQTTAgentReturnCode_t MQTT_AGENT_PublishAsync( MQTTAgentHandle_t xMQTTHandle,
+                                               const MQTTAgentPublishParams_t * const pxPublishParams,
+                                               MQTTAgentPublishCallback_t pxCallback,
+                                               void * pvCallbackContext,
+                                               uint32_t * pulMessageId,
+                                               TickType_t xTimeoutTicks )
+{
+    MQTTEventData_t xEventData;
+    MQTTAgentReturnCode_t xReturnCode = eMQTTAgentFailure;
+
+    /* Should not try to send commands until after the MQTT task has been
+     * initialized, in which case the command queue will have been created. */
+    configASSERT( xCommandQueue );
+    configASSERT( pxCallback != NULL );
+
+    /* Setup the event to be sent to the command queue. The parameters are
+     * copied into the event as this task does not wait for it to be processed. */
+    xEventData.uxBrokerNumber = ( UBaseType_t ) mqttDECODE_BROKER_NUMBER( xMQTTHandle ); /*lint !e923 Opaque pointer. */
+    xEventData.xEventType = eMQTTPublishAsyncRequest;
+    xEventData.xTicksToWait = xTimeoutTicks;
+    xEventData.xPublishParams = *pxPublishParams;
+    xEventData.u.pxPublishParams = NULL;
+
+    /* The task handle only marks the notification data as in use, the result
+     * is reported through the callback. */
+    xEventData.xNotificationData.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xEventData.xNotificationData.pxPublishCallback = pxCallback;
+    xEventData.xNotificationData.pvPublishCallbackContext = pvCallbackContext;
+
+    if( xEventData.xNotificationData.xTaskToNotify != xMQTTTaskHandle )
+    {
+        prvSetMessageIdentifier( &xEventData );
+
+        /* Record the time at which this event is created. */
+        vTaskSetTimeOutState( &( xEventData.xEventCreationTimestamp ) );
+
+        mqttconfigDEBUG_LOG( ( "Sending asynchronous publish to MQTT task.\r\n" ) );
+
+        if( xQueueSendToBack( xCommandQueue, &xEventData, xEventData.xTicksToWait ) != pdFALSE )
+        {
+            if( pulMessageId != NULL )
+            {
+                *pulMessageId = mqttMESSAGE_IDENTIFIER_EXTRACT( xEventData.xNotificationData.ulMessageIdentifier );
+            }
+
+            xReturnCode = eMQTTAgentSuccess;
+        }
+        else
+        {
+            mqttconfigDEBUG_LOG( ( "Attempt to write to the MQTT command queue failed.\r\n" ) );
+        }
+    }
+    else
+    {
+        mqttconfigDEBUG_LOG( ( "MQTT Agent API called from MQTT task ( possibly from callback ) !!.\r\n" ) );
+        xReturnCode = eMQTTAgentAPICalledFromCallback;
+    }
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
 MQTTAgentReturnCode_t MQTT_AGENT_ReturnBuffer( MQTTAgentHandle_t xMQTTHandle,
                                                MQTTBufferHandle_t xBufferHandle )
 {
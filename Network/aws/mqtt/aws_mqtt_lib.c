@@ -490,6 +490,23 @@ static MQTTReturnCode_t prvSendData( MQTTContext_t * pxMQTTContext,
                                      const uint8_t * const pucData,
                                      uint32_t ulDataLength );
 
+/**
+ * @brief Transmits a packet held in several segments using the user supplied
+ * vectored send callback.
+ *
+ * Like prvSendData, it updates the last sent message timestamp in the MQTT
+ * context in case of a successful transmit.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ * @param[in] pxSegments The segments to transmit, in order.
+ * @param[in] ulSegmentCount The number of segments.
+ *
+ * @return eMQTTSuccess if send is successful, eMQTTSendFailed otherwise.
+ */
+static MQTTReturnCode_t prvSendSegments( MQTTContext_t * pxMQTTContext,
+                                         const MQTTSendSegment_t * pxSegments,
+                                         uint32_t ulSegmentCount );
+
 /**
  * @brief Decodes and processes the received MQTT message containing only fixed header.
  *
@@ -685,13 +702,27 @@ static uint8_t prvEncodeRemainingLength( uint32_t ulRemainingLength,
 static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemainingLength,
                                          uint32_t * const pulRemainingLength );
 
+/**
+ * @brief Marks all the entries in the subscription manager as free and
+ * empties its topic filter index.
+ *
+ * @param[in] pxMQTTContext The MQTT context whose subscription manager to
+ * initialize.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvInitSubscriptionManager( MQTTContext_t * pxMQTTContext );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
 /**
  * @brief Store the subscription in the subscription manager.
  *
  * This function can fail to store the subscription if all the entries in the
  * subscription manager are in use or the topic name is longer than the maximum
  * length as specified by the mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH
- * macro or if the topic represents an invalid topic filter. eMQTTFalse is returned
+ * macro or if the topic represents an invalid topic filter or if the topic
+ * filter cannot be added to the topic filter index. eMQTTFalse is returned
  * to indicate the failure.
  *
  * @param[in] pxMQTTContext The MQTT context for which to store the subscription.
@@ -764,6 +795,10 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
  * - Then it tries to find entries containing topic filters with wild-cards
  *   which match the topic on which the publish message is received.
  *
+ * The entries are looked up in the topic filter index, at a cost which
+ * depends on the number of levels in the topic rather than the number of
+ * subscriptions.
+ *
  * @param[in] pxMQTTContext The MQTT context for which to invoke the subscription callbacks.
  * @param[in] pxPublishData The publish data containing the topic and the received message.
  * @param[out] pxSubscriptionCallbackInvoked Set to eMQTTTrue if any callback was invoked,
@@ -779,6 +814,76 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
+/**
+ * @brief The state of prvInvokeSubscriptionCallbacks, passed to the topic
+ * filter index callbacks.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    #define mqttSUBSCRIPTION_BITMAP_WORDS    ( ( mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS + 31 ) / 32 )
+
+    typedef struct MQTTSubscriptionDispatch
+    {
+        MQTTContext_t * pxMQTTContext;                               /**< The MQTT context. */
+        const MQTTPublishData_t * pxPublishData;                     /**< The received publish message. */
+        MQTTBool_t xSubscriptionCallbackInvoked;                     /**< Set to eMQTTTrue once a callback is invoked. */
+        MQTTBool_t xBufferOwnershipTaken;                            /**< Set to eMQTTTrue if the user took the ownership of the MQTT buffer. */
+        uint32_t ulWildCardMatches[ mqttSUBSCRIPTION_BITMAP_WORDS ]; /**< One bit per subscription entry with a wild-card topic filter that matches the topic. */
+    } MQTTSubscriptionDispatch_t;
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Invokes the callback of a subscription, if the topic filter of the
+ * candidate entry returned by the topic filter index is equal to the topic.
+ *
+ * @param[in] pvContext The dispatch state, of type MQTTSubscriptionDispatch_t.
+ * @param[in] usEntry The index of the subscription entry.
+ *
+ * @return eMQTTTopicIndexStop if the user took the ownership of the MQTT
+ * buffer, eMQTTTopicIndexContinue otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvInvokeSimpleSubscriptionCallback( void * pvContext,
+                                                                       uint16_t usEntry );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Records a subscription, if the topic filter of the candidate entry
+ * returned by the topic filter index matches the topic. The index finds the
+ * entries in trie order, so the callbacks are invoked afterwards in entry
+ * order, which decides which subscriber may take the buffer ownership.
+ *
+ * @param[in] pvContext The dispatch state, of type MQTTSubscriptionDispatch_t.
+ * @param[in] usEntry The index of the subscription entry.
+ *
+ * @return eMQTTTopicIndexContinue, all the candidates are examined.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvCollectWildCardSubscription( void * pvContext,
+                                                                  uint16_t usEntry );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Invokes the callback registered with a matching subscription.
+ *
+ * @param[in] pxDispatch The dispatch state.
+ * @param[in] pxSubscription The matching subscription.
+ *
+ * @return eMQTTTopicIndexStop if the user took the ownership of the MQTT
+ * buffer, eMQTTTopicIndexContinue otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvInvokeSubscriptionCallback( MQTTSubscriptionDispatch_t * pxDispatch,
+                                                                 const MQTTSubscription_t * pxSubscription );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
 /**
  * @brief Infers the type of the given topic filter.
  *
@@ -1006,10 +1111,6 @@ static void prvResetMQTTContext( MQTTContext_t * pxMQTTContext )
     Link_t * pxLink, * pxTempLink;
     MQTTBufferHandle_t xBufferHandle;
 
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-        uint32_t x;
-    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-
     /* Set connection state to not connected. */
     pxMQTTContext->xConnectionState = eMQTTNotConnected;
 
@@ -1027,16 +1128,7 @@ static void prvResetMQTTContext( MQTTContext_t * pxMQTTContext )
     prvResetRxMessageState( pxMQTTContext );
 
     #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-
-        /* Mark all the subscription entires in the subscription
-         * manager as free. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
-        {
-            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
-        }
-
-        /* Set the number of in-use subscription entries to zero. */
-        pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions = 0;
+        prvInitSubscriptionManager( pxMQTTContext );
     #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 }
 /*-----------------------------------------------------------*/
@@ -1121,6 +1213,31 @@ static MQTTReturnCode_t prvSendData( MQTTContext_t * pxMQTTContext,
 }
 /*-----------------------------------------------------------*/
 
+static MQTTReturnCode_t prvSendSegments( MQTTContext_t * pxMQTTContext,
+                                         const MQTTSendSegment_t * pxSegments,
+                                         uint32_t ulSegmentCount )
+{
+    MQTTReturnCode_t xReturnCode = eMQTTSendFailed;
+    uint32_t ulDataLength = 0, x;
+
+    for( x = 0; x < ulSegmentCount; x++ )
+    {
+        ulDataLength += pxSegments[ x ].ulDataLength;
+    }
+
+    if( pxMQTTContext->pxMQTTSendVectorFxn( pxMQTTContext->pvSendContext, pxSegments, ulSegmentCount ) == ulDataLength )
+    {
+        xReturnCode = eMQTTSuccess;
+
+        /* Any message sent delays the next keep alive, see prvSendData. */
+        pxMQTTContext->xLastSentMessageTimestamp = prvGetCurrentTickCount( pxMQTTContext );
+        pxMQTTContext->ulNextPeriodicInvokeTicks = pxMQTTContext->ulKeepAliveActualIntervalTicks;
+    }
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
 static void prvProcessReceivedFixedHeaderOnlyMQTTPacket( MQTTContext_t * pxMQTTContext )
 {
     MQTTEventCallbackParams_t xEventCallbackParams;
@@ -1978,6 +2095,34 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
 }
 /*-----------------------------------------------------------*/
 
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvInitSubscriptionManager( MQTTContext_t * pxMQTTContext )
+    {
+        uint32_t x;
+
+        /* Mark all the subscription entires in the subscription
+         * manager as free. */
+        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+        {
+            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
+        }
+
+        /* Set the number of in-use subscription entries to zero. */
+        pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions = 0;
+
+        /* Empty the topic filter index. */
+        MQTT_TopicIndexInit( &( pxMQTTContext->xSubscriptionManager.xTopicIndex ),
+                             pxMQTTContext->xSubscriptionManager.xTopicNodes,
+                             ( uint16_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES,
+                             pxMQTTContext->xSubscriptionManager.xTopicEntries,
+                             ( uint16_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS,
+                             pxMQTTContext->xSubscriptionManager.usTopicEdges );
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
     static MQTTBool_t prvStoreSubscription( MQTTContext_t * pxMQTTContext,
@@ -1989,6 +2134,7 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
         uint32_t x;
         MQTTBool_t xSubscriptionStored = eMQTTFalse;
         MQTTTopicFilterType_t xTopicFilterType;
+        MQTTTopicIndexStatus_t xIndexStatus;
 
         /* Is there a free entry in the subscription manager? */
         if( pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
@@ -2010,25 +2156,43 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                     {
                         if( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTFalse )
                         {
-                            /* Found a free entry. Mark it as used and
-                             * store the subscription. */
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTTrue;
-
-                            /* Store the subscription. */
-                            memcpy( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter,
-                                    pucTopic,
-                                    usTopicLength );
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength = usTopicLength;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pvPublishCallbackContext = pvPublishCallbackContext;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pxPublishCallback = pxPublishCallback;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType = xTopicFilterType;
-
-                            /* Increase the in-use subscription entries count. */
-                            pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions += ( uint32_t ) 1;
-
-                            /* Inform the user that the subscription was stored
-                             * successfully. */
-                            xSubscriptionStored = eMQTTTrue;
+                            /* Found a free entry. Add the topic filter to the
+                             * index, under the same entry number. */
+                            xIndexStatus = MQTT_TopicIndexInsert( &( pxMQTTContext->xSubscriptionManager.xTopicIndex ),
+                                                                  ( uint16_t ) x,
+                                                                  pucTopic,
+                                                                  usTopicLength );
+
+                            if( xIndexStatus == eMQTTTopicIndexSuccess )
+                            {
+                                /* Mark the entry as used and store the
+                                 * subscription. */
+                                pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTTrue;
+
+                                /* Store the subscription. */
+                                memcpy( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter,
+                                        pucTopic,
+                                        usTopicLength );
+                                pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength = usTopicLength;
+                                pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pvPublishCallbackContext = pvPublishCallbackContext;
+                                pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pxPublishCallback = pxPublishCallback;
+                                pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType = xTopicFilterType;
+
+                                /* Increase the in-use subscription entries count. */
+                                pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions += ( uint32_t ) 1;
+
+                                /* Inform the user that the subscription was stored
+                                 * successfully. */
+                                xSubscriptionStored = eMQTTTrue;
+                            }
+                            else if( xIndexStatus == eMQTTTopicIndexTooManyLevels )
+                            {
+                                mqttconfigDEBUG_LOG( ( "WARN: Topic has too many levels and cannot be stored in the subscription manager. Consider increasing mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS.\r\n" ) );
+                            }
+                            else
+                            {
+                                mqttconfigDEBUG_LOG( ( "WARN: Subscription Manager topic index full! Consider increasing mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES.\r\n" ) );
+                            }
 
                             /* Done. */
                             break;
@@ -2080,6 +2244,9 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                     /* Found a matching subscription, mark it as free. */
                     pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
 
+                    /* Remove its topic filter from the index. */
+                    MQTT_TopicIndexRemove( &( pxMQTTContext->xSubscriptionManager.xTopicIndex ), ( uint16_t ) x );
+
                     /* Reduce the count of in-use subscription entries
                      * in the subscription manager. */
                     pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions -= ( uint32_t ) 1;
@@ -2135,94 +2302,132 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                                                       const MQTTPublishData_t * pxPublishData,
                                                       MQTTBool_t * pxSubscriptionCallbackInvoked )
     {
-        MQTTBool_t xBufferOwnershipTaken = eMQTTFalse;
-        MQTTSubscription_t * pxSubscription;
+        MQTTSubscriptionDispatch_t xDispatch;
         uint32_t x;
 
-        /* Set the output parameter to eMQTTFalse. It will
-         * be set to eMQTTTrue if any callback is invoked. */
-        *pxSubscriptionCallbackInvoked = eMQTTFalse;
+        xDispatch.pxMQTTContext = pxMQTTContext;
+        xDispatch.pxPublishData = pxPublishData;
+        xDispatch.xSubscriptionCallbackInvoked = eMQTTFalse;
+        xDispatch.xBufferOwnershipTaken = eMQTTFalse;
+        memset( xDispatch.ulWildCardMatches, 0x00, sizeof( xDispatch.ulWildCardMatches ) );
+
+        /* Invoke the callbacks registered for topic filters without any
+         * wild-cards which are equal to the topic. There is only one, as
+         * a topic filter is never stored twice. */
+        ( void ) MQTT_TopicIndexMatchSimple( &( pxMQTTContext->xSubscriptionManager.xTopicIndex ),
+                                             pxPublishData->pucTopic,
+                                             pxPublishData->usTopicLength,
+                                             prvInvokeSimpleSubscriptionCallback,
+                                             &( xDispatch ) );
 
-        /* Iterate over the subscription entries containing topic filters
-         * without any wild-cards and invoke the registered callbacks. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+        /* If the user has not taken the buffer ownership yet (which can
+         * happen if there is no exact matching entry in the subscription
+         * manager or the user does not take the ownership in the callback),
+         * invoke the callbacks registered for topic filters with wild-cards
+         * which match the topic, in subscription entry order. */
+        if( xDispatch.xBufferOwnershipTaken == eMQTTFalse )
         {
-            if( ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTTrue ) &&
-                ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType == eMQTTTopicFilterTypeSimple ) &&
-                ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength == pxPublishData->usTopicLength ) )
+            ( void ) MQTT_TopicIndexMatchWildCard( &( pxMQTTContext->xSubscriptionManager.xTopicIndex ),
+                                                   pxPublishData->pucTopic,
+                                                   pxPublishData->usTopicLength,
+                                                   prvCollectWildCardSubscription,
+                                                   &( xDispatch ) );
+
+            for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
             {
-                if( memcmp( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter, pxPublishData->pucTopic, pxPublishData->usTopicLength ) == 0 )
+                if( ( xDispatch.ulWildCardMatches[ x / 32U ] & ( ( uint32_t ) 1 << ( x % 32U ) ) ) != ( uint32_t ) 0 )
                 {
-                    /* Found a matching subscription. */
-                    pxSubscription = &( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ] );
-
-                    /* If a callback is registered with the subscription,
-                     * invoke it. */
-                    if( pxSubscription->pxPublishCallback != NULL )
+                    if( prvInvokeSubscriptionCallback( &( xDispatch ),
+                                                       &( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ] ) ) == eMQTTTopicIndexStop )
                     {
-                        /* Note that a callback was invoked. */
-                        *pxSubscriptionCallbackInvoked = eMQTTTrue;
-
-                        /* Invoke callback. */
-                        xBufferOwnershipTaken = pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, pxPublishData );
-
-                        /* If the user takes the buffer ownership, do
-                         * not invoke any other callbacks. */
-                        if( xBufferOwnershipTaken == eMQTTTrue )
-                        {
-                            break;
-                        }
+                        break;
                     }
                 }
             }
         }
 
-        /* If the user has not taken the buffer ownership yet (which can
-         * happen if there is no exact matching entry in the subscription
-         * manager or the user does not take the ownership in the callback),
-         * iterate over the subscription entries containing topic filters
-         * with wild-cards and invoke the registered callbacks for the ones
-         * which match the topic. */
-        if( xBufferOwnershipTaken == eMQTTFalse )
+        /* Set the output parameter. */
+        *pxSubscriptionCallbackInvoked = xDispatch.xSubscriptionCallbackInvoked;
+
+        /* Return whether or not the user has taken the
+         * ownership of the MQTT buffer. */
+        return xDispatch.xBufferOwnershipTaken;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvInvokeSimpleSubscriptionCallback( void * pvContext,
+                                                                       uint16_t usEntry )
+    {
+        MQTTSubscriptionDispatch_t * pxDispatch = ( MQTTSubscriptionDispatch_t * ) pvContext;
+        const MQTTSubscription_t * pxSubscription = &( pxDispatch->pxMQTTContext->xSubscriptionManager.xSubscriptions[ usEntry ] );
+        MQTTTopicIndexAction_t xAction = eMQTTTopicIndexContinue;
+
+        /* The index only returns candidates, confirm the match. */
+        if( ( pxSubscription->usTopicFilterLength == pxDispatch->pxPublishData->usTopicLength ) &&
+            ( memcmp( pxSubscription->ucTopicFilter, pxDispatch->pxPublishData->pucTopic, pxDispatch->pxPublishData->usTopicLength ) == 0 ) )
         {
-            for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
-            {
-                if( ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTTrue ) &&
-                    ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType == eMQTTTopicFilterTypeWildCard ) )
-                {
-                    if( prvDoesTopicMatchTopicFilter( pxPublishData->pucTopic,
-                                                      pxPublishData->usTopicLength,
-                                                      pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter,
-                                                      pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength ) == eMQTTTrue )
-                    {
-                        /* Found a matching subscription. */
-                        pxSubscription = &( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ] );
+            xAction = prvInvokeSubscriptionCallback( pxDispatch, pxSubscription );
+        }
 
-                        /* If a callback is registered with the subscription,
-                         * invoke it. */
-                        if( pxSubscription->pxPublishCallback != NULL )
-                        {
-                            /* Note that a callback was invoked. */
-                            *pxSubscriptionCallbackInvoked = eMQTTTrue;
+        return xAction;
+    }
 
-                            /* Invoke callback. */
-                            xBufferOwnershipTaken = pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, pxPublishData );
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
 
-                            /* If the user takes the buffer ownership, do
-                             * not invoke any other callbacks. */
-                            if( xBufferOwnershipTaken == eMQTTTrue )
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvCollectWildCardSubscription( void * pvContext,
+                                                                  uint16_t usEntry )
+    {
+        MQTTSubscriptionDispatch_t * pxDispatch = ( MQTTSubscriptionDispatch_t * ) pvContext;
+        const MQTTSubscription_t * pxSubscription = &( pxDispatch->pxMQTTContext->xSubscriptionManager.xSubscriptions[ usEntry ] );
+
+        /* The index only returns candidates, confirm the match. */
+        if( prvDoesTopicMatchTopicFilter( pxDispatch->pxPublishData->pucTopic,
+                                          pxDispatch->pxPublishData->usTopicLength,
+                                          pxSubscription->ucTopicFilter,
+                                          pxSubscription->usTopicFilterLength ) == eMQTTTrue )
+        {
+            pxDispatch->ulWildCardMatches[ usEntry / 32U ] |= ( uint32_t ) 1 << ( usEntry % 32U );
+        }
+
+        return eMQTTTopicIndexContinue;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicIndexAction_t prvInvokeSubscriptionCallback( MQTTSubscriptionDispatch_t * pxDispatch,
+                                                                 const MQTTSubscription_t * pxSubscription )
+    {
+        MQTTTopicIndexAction_t xAction = eMQTTTopicIndexContinue;
+
+        /* If a callback is registered with the subscription,
+         * invoke it. */
+        if( pxSubscription->pxPublishCallback != NULL )
+        {
+            /* Note that a callback was invoked. */
+            pxDispatch->xSubscriptionCallbackInvoked = eMQTTTrue;
+
+            /* Invoke callback. */
+            pxDispatch->xBufferOwnershipTaken = pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, pxDispatch->pxPublishData );
+
+            /* If the user takes the buffer ownership, do
+             * not invoke any other callbacks. */
+            if( pxDispatch->xBufferOwnershipTaken == eMQTTTrue )
+            {
+                xAction = eMQTTTopicIndexStop;
             }
         }
 
-        /* Return whether or not the user has taken the
-         * ownership of the MQTT buffer. */
-        return xBufferOwnershipTaken;
+        return xAction;
     }
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
@@ -2423,10 +2628,6 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
 MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
                             const MQTTInitParams_t * const pxInitParams )
 {
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-        uint32_t x;
-    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-
     /* These are checked here once and are later used without
      * NULL checks. */
     mqttconfigASSERT( pxMQTTContext != NULL );
@@ -2451,6 +2652,7 @@ MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
     /* Store send context and function. */
     pxMQTTContext->pvSendContext = pxInitParams->pvSendContext;
     pxMQTTContext->pxMQTTSendFxn = pxInitParams->pxMQTTSendFxn;
+    pxMQTTContext->pxMQTTSendVectorFxn = pxInitParams->pxMQTTSendVectorFxn;
 
     /* Store get ticks function. */
     pxMQTTContext->pxGetTicksFxn = pxInitParams->pxGetTicksFxn;
@@ -2459,16 +2661,7 @@ MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
     pxMQTTContext->xBufferPoolInterface = pxInitParams->xBufferPoolInterface;
 
     #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-
-        /* Mark all the subscription entires in the subscription
-         * manager as free. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
-        {
-            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
-        }
-
-        /* Set the number of in-use subscription entries to zero. */
-        pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions = 0;
+        prvInitSubscriptionManager( pxMQTTContext );
     #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
     return eMQTTSuccess;
@@ -2964,10 +3157,11 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
                                const MQTTPublishParams_t * const pxPublishParams )
 {
     uint8_t * pucNextByte, * pucLastByteInBuffer, ucRemainingLengthFieldBytes;
-    uint32_t ulRemainingLength, ulTotalMessageLength;
+    uint32_t ulRemainingLength, ulTotalMessageLength, ulBufferLength, ulTopicEndOffset = 0;
     uint16_t usTopicLength;
     MQTTBufferHandle_t xBuffer = NULL;
     MQTTReturnCode_t xReturnCode = eMQTTFailure;
+    MQTTSendSegment_t xSegments[ mqttMAX_SEND_SEGMENTS ];
 
     /* These are checked here once and are later used without
      * NULL checks. */
@@ -3004,8 +3198,19 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
             /* Calculate total MQTT message length. */
             ulTotalMessageLength = mqttTOTAL_MESSAGE_LENGTH( ucRemainingLengthFieldBytes, ulRemainingLength );
 
+            /* With a vectored send the topic and payload are sent from the
+             * caller's memory, so the buffer only holds the headers. */
+            if( pxMQTTContext->pxMQTTSendVectorFxn != NULL )
+            {
+                ulBufferLength = ulTotalMessageLength - ( uint32_t ) pxPublishParams->usTopicLength - pxPublishParams->ulDataLength;
+            }
+            else
+            {
+                ulBufferLength = ulTotalMessageLength;
+            }
+
             /* Try to get a buffer from the free buffer pool. */
-            xBuffer = prvGetFreeBuffer( pxMQTTContext, ulTotalMessageLength );
+            xBuffer = prvGetFreeBuffer( pxMQTTContext, ulBufferLength );
 
             if( xBuffer == NULL )
             {
@@ -3045,7 +3250,21 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
 
                 /* Write the topic into the message (part of variable header). */
                 pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_OFFSET, ucRemainingLengthFieldBytes ) ] );
-                pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxPublishParams->pucTopic, pxPublishParams->usTopicLength );
+
+                if( pxMQTTContext->pxMQTTSendVectorFxn != NULL )
+                {
+                    /* Only the topic length, the topic is its own segment. */
+                    *pucNextByte = ( uint8_t ) ( ( pxPublishParams->usTopicLength ) >> mqttBITS_PER_BYTE );
+                    pucNextByte++;
+                    *pucNextByte = ( uint8_t ) ( pxPublishParams->usTopicLength );
+                    pucNextByte++;
+
+                    ulTopicEndOffset = ( uint32_t ) ( pucNextByte - mqttbufferGET_DATA( xBuffer ) );
+                }
+                else
+                {
+                    pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxPublishParams->pucTopic, pxPublishParams->usTopicLength );
+                }
 
                 /* Write packet identifier into the message, if it is not QoS0. */
                 if( pxPublishParams->xQos != eMQTTQoS0 )
@@ -3059,15 +3278,19 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
                     pucNextByte++;
                 }
 
-                /* Write the payload into the message. */
-                memcpy( pucNextByte, pxPublishParams->pvData, ( size_t ) pxPublishParams->ulDataLength );
+                /* Write the payload into the message, unless it is sent as
+                 * its own segment. */
+                if( pxMQTTContext->pxMQTTSendVectorFxn == NULL )
+                {
+                    memcpy( pucNextByte, pxPublishParams->pvData, ( size_t ) pxPublishParams->ulDataLength );
+                }
 
                 /* Store the packet identifier in TxBuffer also for matching
                  * ACK later. */
                 mqttbufferGET_PACKET_IDENTIFIER( xBuffer ) = pxPublishParams->usPacketIdentifier;
 
                 /* Update the number of bytes written to the buffer. */
-                mqttbufferGET_DATA_LENGTH( xBuffer ) = ulTotalMessageLength;
+                mqttbufferGET_DATA_LENGTH( xBuffer ) = ulBufferLength;
 
                 /* MQTT packet created. */
                 xReturnCode = eMQTTSuccess;
@@ -3078,7 +3301,25 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
     /* If the packet was successfully constructed, transmit it. */
     if( xReturnCode == eMQTTSuccess )
     {
-        xReturnCode = prvSendData( pxMQTTContext, mqttbufferGET_DATA( xBuffer ), mqttbufferGET_DATA_LENGTH( xBuffer ) );
+        if( pxMQTTContext->pxMQTTSendVectorFxn != NULL )
+        {
+            /* Fixed header and topic length, topic, packet identifier (if
+             * any), payload. */
+            xSegments[ 0 ].pucData = mqttbufferGET_DATA( xBuffer );
+            xSegments[ 0 ].ulDataLength = ulTopicEndOffset;
+            xSegments[ 1 ].pucData = pxPublishParams->pucTopic;
+            xSegments[ 1 ].ulDataLength = ( uint32_t ) pxPublishParams->usTopicLength;
+            xSegments[ 2 ].pucData = &( mqttbufferGET_DATA( xBuffer )[ ulTopicEndOffset ] );
+            xSegments[ 2 ].ulDataLength = mqttbufferGET_DATA_LENGTH( xBuffer ) - ulTopicEndOffset;
+            xSegments[ 3 ].pucData = ( const uint8_t * ) pxPublishParams->pvData;
+            xSegments[ 3 ].ulDataLength = pxPublishParams->ulDataLength;
+
+            xReturnCode = prvSendSegments( pxMQTTContext, xSegments, ( uint32_t ) mqttMAX_SEND_SEGMENTS );
+        }
+        else
+        {
+            xReturnCode = prvSendData( pxMQTTContext, mqttbufferGET_DATA( xBuffer ), mqttbufferGET_DATA_LENGTH( xBuffer ) );
+        }
     }
 
     /* If some error occurred or QOS0 (No ACK is expected in case of QOS0),
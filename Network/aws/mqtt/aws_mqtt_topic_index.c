@@ -0,0 +1,693 @@
+/*
+ * Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/**
+ * @file aws_mqtt_topic_index.c
+ * @brief Topic filter index of the MQTT subscription manager.
+ */
+
+/* MQTT includes. */
+#include "aws_mqtt_lib.h"
+#include "aws_mqtt_topic_index.h"
+
+/**
+ * @defgroup TopicLevelTypes Types of the topic level a node is for.
+ */
+/** @{ */
+#define mqtttopicindexLEVEL_PLAIN    ( ( uint8_t ) 0 ) /**< A level without wild-cards. */
+#define mqtttopicindexLEVEL_PLUS     ( ( uint8_t ) 1 ) /**< The single level wild-card '+'. */
+#define mqtttopicindexLEVEL_HASH     ( ( uint8_t ) 2 ) /**< The multi level wild-card '#'. */
+/** @} */
+
+/**
+ * @brief The root node. It is never a child, so the same value is also
+ * used to indicate that there is no child node.
+ */
+#define mqtttopicindexROOT           ( ( uint16_t ) 0 )
+
+/**
+ * @brief Indicates the end of the list of entries ending at a node.
+ */
+#define mqtttopicindexNO_ENTRY       ( ( uint16_t ) 0xFFFF )
+
+/**
+ * @brief The FNV-1a offset basis and prime, used to hash topic levels.
+ */
+#define mqtttopicindexFNV_OFFSET     ( ( uint32_t ) 2166136261UL )
+#define mqtttopicindexFNV_PRIME      ( ( uint32_t ) 16777619UL )
+
+/**
+ * @brief Multiplier mixing the parent node into the edge hash table slot.
+ */
+#define mqtttopicindexPARENT_MIX     ( ( uint32_t ) 2654435761UL )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A pending step of the wild-card search: a node reached with the
+ * topic levels before ulOffset, and the levels from ulOffset still to match.
+ */
+typedef struct MQTTTopicIndexStep
+{
+    uint16_t usNode;   /**< The node reached. */
+    uint32_t ulOffset; /**< Start of the next topic level, or one past the end of the topic if all levels are matched. */
+} MQTTTopicIndexStep_t;
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Hashes a topic level.
+ *
+ * @param[in] pucLevel The topic level.
+ * @param[in] ulLength The length of the topic level.
+ *
+ * @return The hash of the topic level.
+ */
+static uint32_t prvHashLevel( const uint8_t * pucLevel,
+                              uint32_t ulLength );
+
+/**
+ * @brief Finds the end of the topic level starting at the given offset.
+ *
+ * @param[in] pucTopic The topic or topic filter.
+ * @param[in] ulLength The length of the topic or topic filter.
+ * @param[in] ulOffset The start of the topic level.
+ *
+ * @return The offset of the '/' which ends the topic level, or ulLength for
+ * the last level.
+ */
+static uint32_t prvLevelEnd( const uint8_t * pucTopic,
+                             uint32_t ulLength,
+                             uint32_t ulOffset );
+
+/**
+ * @brief Finds the slot of the edge hash table at which the search for a
+ * plain level child node starts.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usParent The parent node.
+ * @param[in] ulLevelHash The hash of the topic level.
+ *
+ * @return The slot in the edge hash table.
+ */
+static uint16_t prvEdgeSlot( const MQTTTopicIndex_t * pxIndex,
+                             uint16_t usParent,
+                             uint32_t ulLevelHash );
+
+/**
+ * @brief Finds the plain level child node of the given node.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usParent The parent node.
+ * @param[in] ulLevelHash The hash of the topic level.
+ *
+ * @return The child node, or mqtttopicindexROOT if there is none.
+ */
+static uint16_t prvFindChild( const MQTTTopicIndex_t * pxIndex,
+                              uint16_t usParent,
+                              uint32_t ulLevelHash );
+
+/**
+ * @brief Allocates a node and links it to its parent.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usParent The parent node.
+ * @param[in] ucLevelType The type of the topic level.
+ * @param[in] ulLevelHash The hash of the topic level, for a plain level.
+ *
+ * @return The new node, or mqtttopicindexROOT if no node is free.
+ */
+static uint16_t prvAddChild( MQTTTopicIndex_t * pxIndex,
+                             uint16_t usParent,
+                             uint8_t ucLevelType,
+                             uint32_t ulLevelHash );
+
+/**
+ * @brief Removes a plain level node from the edge hash table.
+ *
+ * Slots following the removed one are moved back as needed, so that no
+ * search stops early at the emptied slot.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usNode The node to remove.
+ */
+static void prvRemoveEdge( MQTTTopicIndex_t * pxIndex,
+                           uint16_t usNode );
+
+/**
+ * @brief Frees the given node if it is no longer referenced, along with
+ * any of its ancestors which are no longer referenced as a result.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usNode The node to release.
+ */
+static void prvReleaseNode( MQTTTopicIndex_t * pxIndex,
+                            uint16_t usNode );
+
+/**
+ * @brief Calls the callback for the entries ending at the given node.
+ *
+ * @param[in] pxIndex The index.
+ * @param[in] usNode The node.
+ * @param[in] ucWildCard Only visit entries with (1) or without (0) wild-cards.
+ * @param[in] pxCallback The callback.
+ * @param[in] pvContext Passed as it is to pxCallback.
+ *
+ * @return eMQTTTopicIndexStop if the callback stopped the search,
+ * eMQTTTopicIndexContinue otherwise.
+ */
+static MQTTTopicIndexAction_t prvVisitEntries( const MQTTTopicIndex_t * pxIndex,
+                                               uint16_t usNode,
+                                               uint8_t ucWildCard,
+                                               MQTTTopicIndexCallback_t pxCallback,
+                                               void * pvContext );
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHashLevel( const uint8_t * pucLevel,
+                              uint32_t ulLength )
+{
+    uint32_t ulHash = mqtttopicindexFNV_OFFSET;
+    uint32_t x;
+
+    for( x = 0; x < ulLength; x++ )
+    {
+        ulHash ^= ( uint32_t ) pucLevel[ x ];
+        ulHash *= mqtttopicindexFNV_PRIME;
+    }
+
+    return ulHash;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvLevelEnd( const uint8_t * pucTopic,
+                             uint32_t ulLength,
+                             uint32_t ulOffset )
+{
+    uint32_t ulEnd = ulOffset;
+
+    while( ( ulEnd < ulLength ) && ( pucTopic[ ulEnd ] != ( uint8_t ) '/' ) )
+    {
+        ulEnd++;
+    }
+
+    return ulEnd;
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvEdgeSlot( const MQTTTopicIndex_t * pxIndex,
+                             uint16_t usParent,
+                             uint32_t ulLevelHash )
+{
+    return ( uint16_t ) ( ( ulLevelHash ^ ( ( uint32_t ) usParent * mqtttopicindexPARENT_MIX ) ) % ( uint32_t ) pxIndex->usNumEdges );
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvFindChild( const MQTTTopicIndex_t * pxIndex,
+                              uint16_t usParent,
+                              uint32_t ulLevelHash )
+{
+    uint16_t usSlot = prvEdgeSlot( pxIndex, usParent, ulLevelHash );
+    uint16_t usChild = mqtttopicindexROOT;
+    uint16_t usNode;
+
+    /* The table is never more than half full, so there is always an
+     * empty slot to end the search. */
+    while( pxIndex->pusEdges[ usSlot ] != mqtttopicindexROOT )
+    {
+        usNode = pxIndex->pusEdges[ usSlot ];
+
+        if( ( pxIndex->pxNodes[ usNode ].usParent == usParent ) &&
+            ( pxIndex->pxNodes[ usNode ].ulLevelHash == ulLevelHash ) )
+        {
+            usChild = usNode;
+            break;
+        }
+
+        usSlot = ( uint16_t ) ( ( usSlot + 1U ) % pxIndex->usNumEdges );
+    }
+
+    return usChild;
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvAddChild( MQTTTopicIndex_t * pxIndex,
+                             uint16_t usParent,
+                             uint8_t ucLevelType,
+                             uint32_t ulLevelHash )
+{
+    uint16_t usChild = pxIndex->usFreeNodes;
+    uint16_t usSlot;
+    MQTTTopicNode_t * pxChild;
+
+    if( usChild != mqtttopicindexROOT )
+    {
+        /* Take the node from the free list. */
+        pxChild = &( pxIndex->pxNodes[ usChild ] );
+        pxIndex->usFreeNodes = pxChild->usParent;
+
+        pxChild->ulLevelHash = ulLevelHash;
+        pxChild->usParent = usParent;
+        pxChild->usPlusChild = mqtttopicindexROOT;
+        pxChild->usHashChild = mqtttopicindexROOT;
+        pxChild->usFirstEntry = mqtttopicindexNO_ENTRY;
+        pxChild->usReferences = 0;
+        pxChild->ucLevelType = ucLevelType;
+
+        /* Link it to the parent. */
+        if( ucLevelType == mqtttopicindexLEVEL_PLUS )
+        {
+            pxIndex->pxNodes[ usParent ].usPlusChild = usChild;
+        }
+        else if( ucLevelType == mqtttopicindexLEVEL_HASH )
+        {
+            pxIndex->pxNodes[ usParent ].usHashChild = usChild;
+        }
+        else
+        {
+            usSlot = prvEdgeSlot( pxIndex, usParent, ulLevelHash );
+
+            while( pxIndex->pusEdges[ usSlot ] != mqtttopicindexROOT )
+            {
+                usSlot = ( uint16_t ) ( ( usSlot + 1U ) % pxIndex->usNumEdges );
+            }
+
+            pxIndex->pusEdges[ usSlot ] = usChild;
+        }
+
+        pxIndex->pxNodes[ usParent ].usReferences++;
+    }
+
+    return usChild;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRemoveEdge( MQTTTopicIndex_t * pxIndex,
+                           uint16_t usNode )
+{
+    const MQTTTopicNode_t * pxNode = &( pxIndex->pxNodes[ usNode ] );
+    uint16_t usEmpty = prvEdgeSlot( pxIndex, pxNode->usParent, pxNode->ulLevelHash );
+    uint16_t usSlot, usHome;
+
+    /* Find the slot holding the node. */
+    while( pxIndex->pusEdges[ usEmpty ] != usNode )
+    {
+        usEmpty = ( uint16_t ) ( ( usEmpty + 1U ) % pxIndex->usNumEdges );
+    }
+
+    pxIndex->pusEdges[ usEmpty ] = mqtttopicindexROOT;
+    usSlot = usEmpty;
+
+    /* Move back the following nodes whose search would otherwise stop
+     * at the emptied slot, up to the next empty slot. */
+    for( ; ; )
+    {
+        usSlot = ( uint16_t ) ( ( usSlot + 1U ) % pxIndex->usNumEdges );
+
+        if( pxIndex->pusEdges[ usSlot ] == mqtttopicindexROOT )
+        {
+            break;
+        }
+
+        pxNode = &( pxIndex->pxNodes[ pxIndex->pusEdges[ usSlot ] ] );
+        usHome = prvEdgeSlot( pxIndex, pxNode->usParent, pxNode->ulLevelHash );
+
+        /* The node can stay if its home slot is cyclically within
+         * ( usEmpty, usSlot ]. */
+        if( ( usEmpty < usSlot ) ? ( ( usEmpty < usHome ) && ( usHome <= usSlot ) )
+                                 : ( ( usEmpty < usHome ) || ( usHome <= usSlot ) ) )
+        {
+            continue;
+        }
+
+        pxIndex->pusEdges[ usEmpty ] = pxIndex->pusEdges[ usSlot ];
+        pxIndex->pusEdges[ usSlot ] = mqtttopicindexROOT;
+        usEmpty = usSlot;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvReleaseNode( MQTTTopicIndex_t * pxIndex,
+                            uint16_t usNode )
+{
+    MQTTTopicNode_t * pxNode;
+    uint16_t usParent;
+
+    while( ( usNode != mqtttopicindexROOT ) && ( pxIndex->pxNodes[ usNode ].usReferences == 0U ) )
+    {
+        pxNode = &( pxIndex->pxNodes[ usNode ] );
+        usParent = pxNode->usParent;
+
+        /* Unlink the node from its parent. */
+        if( pxNode->ucLevelType == mqtttopicindexLEVEL_PLUS )
+        {
+            pxIndex->pxNodes[ usParent ].usPlusChild = mqtttopicindexROOT;
+        }
+        else if( pxNode->ucLevelType == mqtttopicindexLEVEL_HASH )
+        {
+            pxIndex->pxNodes[ usParent ].usHashChild = mqtttopicindexROOT;
+        }
+        else
+        {
+            prvRemoveEdge( pxIndex, usNode );
+        }
+
+        /* Put the node on the free list. */
+        pxNode->usParent = pxIndex->usFreeNodes;
+        pxIndex->usFreeNodes = usNode;
+
+        /* The parent may now be unused too. */
+        pxIndex->pxNodes[ usParent ].usReferences--;
+        usNode = usParent;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static MQTTTopicIndexAction_t prvVisitEntries( const MQTTTopicIndex_t * pxIndex,
+                                               uint16_t usNode,
+                                               uint8_t ucWildCard,
+                                               MQTTTopicIndexCallback_t pxCallback,
+                                               void * pvContext )
+{
+    MQTTTopicIndexAction_t xAction = eMQTTTopicIndexContinue;
+    uint16_t usEntry = pxIndex->pxNodes[ usNode ].usFirstEntry;
+    uint16_t usNextEntry;
+
+    while( ( usEntry != mqtttopicindexNO_ENTRY ) && ( xAction == eMQTTTopicIndexContinue ) )
+    {
+        /* Read the next entry first, in case the callback removes this one. */
+        usNextEntry = pxIndex->pxEntries[ usEntry ].usNextEntry;
+
+        if( pxIndex->pxEntries[ usEntry ].ucWildCard == ucWildCard )
+        {
+            xAction = pxCallback( pvContext, usEntry );
+        }
+
+        usEntry = usNextEntry;
+    }
+
+    return xAction;
+}
+/*-----------------------------------------------------------*/
+
+void MQTT_TopicIndexInit( MQTTTopicIndex_t * pxIndex,
+                          MQTTTopicNode_t * pxNodes,
+                          uint16_t usMaxNodes,
+                          MQTTTopicEntry_t * pxEntries,
+                          uint16_t usMaxEntries,
+                          uint16_t * pusEdges )
+{
+    uint16_t x;
+
+    mqttconfigASSERT( usMaxNodes >= 2U );
+    mqttconfigASSERT( usMaxNodes <= 32767U );
+
+    pxIndex->pxNodes = pxNodes;
+    pxIndex->pxEntries = pxEntries;
+    pxIndex->pusEdges = pusEdges;
+    pxIndex->usMaxNodes = usMaxNodes;
+    pxIndex->usMaxEntries = usMaxEntries;
+    pxIndex->usNumEdges = ( uint16_t ) mqtttopicindexNUM_EDGES( usMaxNodes );
+
+    /* The root node is never freed. */
+    pxNodes[ mqtttopicindexROOT ].ulLevelHash = 0;
+    pxNodes[ mqtttopicindexROOT ].usParent = mqtttopicindexROOT;
+    pxNodes[ mqtttopicindexROOT ].usPlusChild = mqtttopicindexROOT;
+    pxNodes[ mqtttopicindexROOT ].usHashChild = mqtttopicindexROOT;
+    pxNodes[ mqtttopicindexROOT ].usFirstEntry = mqtttopicindexNO_ENTRY;
+    pxNodes[ mqtttopicindexROOT ].usReferences = 0;
+    pxNodes[ mqtttopicindexROOT ].ucLevelType = mqtttopicindexLEVEL_PLAIN;
+
+    /* Put all the other nodes on the free list, lowest index first. */
+    pxIndex->usFreeNodes = mqtttopicindexROOT;
+
+    for( x = usMaxNodes - 1U; x > mqtttopicindexROOT; x-- )
+    {
+        pxNodes[ x ].usParent = pxIndex->usFreeNodes;
+        pxIndex->usFreeNodes = x;
+    }
+
+    for( x = 0; x < pxIndex->usNumEdges; x++ )
+    {
+        pusEdges[ x ] = mqtttopicindexROOT;
+    }
+
+    for( x = 0; x < usMaxEntries; x++ )
+    {
+        pxEntries[ x ].usNode = mqtttopicindexROOT;
+    }
+}
+/*-----------------------------------------------------------*/
+
+MQTTTopicIndexStatus_t MQTT_TopicIndexInsert( MQTTTopicIndex_t * pxIndex,
+                                              uint16_t usEntry,
+                                              const uint8_t * const pucTopicFilter,
+                                              uint16_t usTopicFilterLength )
+{
+    MQTTTopicIndexStatus_t xStatus = eMQTTTopicIndexSuccess;
+    MQTTTopicEntry_t * pxEntry = &( pxIndex->pxEntries[ usEntry ] );
+    uint16_t usNode = mqtttopicindexROOT, usChild;
+    uint32_t ulOffset = 0, ulEnd, ulLevels = 1;
+    uint32_t ulLevelHash;
+    uint8_t ucWildCard = 0;
+
+    mqttconfigASSERT( usEntry < pxIndex->usMaxEntries );
+    mqttconfigASSERT( pxEntry->usNode == mqtttopicindexROOT );
+
+    /* Count the levels, which bounds the depth of the wild-card search. */
+    for( ulEnd = 0; ulEnd < usTopicFilterLength; ulEnd++ )
+    {
+        if( pucTopicFilter[ ulEnd ] == ( uint8_t ) '/' )
+        {
+            ulLevels++;
+        }
+    }
+
+    if( ulLevels > ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS )
+    {
+        xStatus = eMQTTTopicIndexTooManyLevels;
+    }
+    else
+    {
+        /* Walk down the trie one level at a time, adding the nodes
+         * which do not exist yet. */
+        for( ; ; )
+        {
+            ulEnd = prvLevelEnd( pucTopicFilter, usTopicFilterLength, ulOffset );
+
+            if( ( ulEnd == ( ulOffset + 1U ) ) && ( pucTopicFilter[ ulOffset ] == ( uint8_t ) '+' ) )
+            {
+                ucWildCard = 1;
+                usChild = pxIndex->pxNodes[ usNode ].usPlusChild;
+
+                if( usChild == mqtttopicindexROOT )
+                {
+                    usChild = prvAddChild( pxIndex, usNode, mqtttopicindexLEVEL_PLUS, 0 );
+                }
+            }
+            else if( ( ulEnd == ( ulOffset + 1U ) ) && ( pucTopicFilter[ ulOffset ] == ( uint8_t ) '#' ) )
+            {
+                ucWildCard = 1;
+                usChild = pxIndex->pxNodes[ usNode ].usHashChild;
+
+                if( usChild == mqtttopicindexROOT )
+                {
+                    usChild = prvAddChild( pxIndex, usNode, mqtttopicindexLEVEL_HASH, 0 );
+                }
+            }
+            else
+            {
+                ulLevelHash = prvHashLevel( &( pucTopicFilter[ ulOffset ] ), ulEnd - ulOffset );
+                usChild = prvFindChild( pxIndex, usNode, ulLevelHash );
+
+                if( usChild == mqtttopicindexROOT )
+                {
+                    usChild = prvAddChild( pxIndex, usNode, mqtttopicindexLEVEL_PLAIN, ulLevelHash );
+                }
+            }
+
+            if( usChild == mqtttopicindexROOT )
+            {
+                xStatus = eMQTTTopicIndexFull;
+                break;
+            }
+
+            usNode = usChild;
+
+            if( ulEnd >= usTopicFilterLength )
+            {
+                break;
+            }
+
+            ulOffset = ulEnd + 1U;
+        }
+
+        if( xStatus == eMQTTTopicIndexSuccess )
+        {
+            /* Add the entry to the node at which the topic filter ends. */
+            pxEntry->usNode = usNode;
+            pxEntry->usNextEntry = pxIndex->pxNodes[ usNode ].usFirstEntry;
+            pxEntry->ucWildCard = ucWildCard;
+            pxIndex->pxNodes[ usNode ].usFirstEntry = usEntry;
+            pxIndex->pxNodes[ usNode ].usReferences++;
+        }
+        else
+        {
+            /* Free the nodes added for this topic filter. */
+            prvReleaseNode( pxIndex, usNode );
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+void MQTT_TopicIndexRemove( MQTTTopicIndex_t * pxIndex,
+                            uint16_t usEntry )
+{
+    MQTTTopicEntry_t * pxEntry = &( pxIndex->pxEntries[ usEntry ] );
+    MQTTTopicNode_t * pxNode;
+    uint16_t * pusLink;
+
+    mqttconfigASSERT( usEntry < pxIndex->usMaxEntries );
+    mqttconfigASSERT( pxEntry->usNode != mqtttopicindexROOT );
+
+    pxNode = &( pxIndex->pxNodes[ pxEntry->usNode ] );
+
+    /* Unlink the entry from the list of the node. */
+    pusLink = &( pxNode->usFirstEntry );
+
+    while( *pusLink != usEntry )
+    {
+        pusLink = &( pxIndex->pxEntries[ *pusLink ].usNextEntry );
+    }
+
+    *pusLink = pxEntry->usNextEntry;
+    pxNode->usReferences--;
+
+    prvReleaseNode( pxIndex, pxEntry->usNode );
+    pxEntry->usNode = mqtttopicindexROOT;
+}
+/*-----------------------------------------------------------*/
+
+MQTTTopicIndexAction_t MQTT_TopicIndexMatchSimple( const MQTTTopicIndex_t * pxIndex,
+                                                   const uint8_t * const pucTopic,
+                                                   uint16_t usTopicLength,
+                                                   MQTTTopicIndexCallback_t pxCallback,
+                                                   void * pvContext )
+{
+    MQTTTopicIndexAction_t xAction = eMQTTTopicIndexContinue;
+    uint16_t usNode = mqtttopicindexROOT;
+    uint32_t ulOffset = 0, ulEnd;
+
+    /* Follow the plain level nodes only, one per topic level. */
+    for( ; ; )
+    {
+        ulEnd = prvLevelEnd( pucTopic, usTopicLength, ulOffset );
+        usNode = prvFindChild( pxIndex, usNode, prvHashLevel( &( pucTopic[ ulOffset ] ), ulEnd - ulOffset ) );
+
+        if( ( usNode == mqtttopicindexROOT ) || ( ulEnd >= usTopicLength ) )
+        {
+            break;
+        }
+
+        ulOffset = ulEnd + 1U;
+    }
+
+    if( usNode != mqtttopicindexROOT )
+    {
+        xAction = prvVisitEntries( pxIndex, usNode, 0, pxCallback, pvContext );
+    }
+
+    return xAction;
+}
+/*-----------------------------------------------------------*/
+
+MQTTTopicIndexAction_t MQTT_TopicIndexMatchWildCard( const MQTTTopicIndex_t * pxIndex,
+                                                     const uint8_t * const pucTopic,
+                                                     uint16_t usTopicLength,
+                                                     MQTTTopicIndexCallback_t pxCallback,
+                                                     void * pvContext )
+{
+    MQTTTopicIndexAction_t xAction = eMQTTTopicIndexContinue;
+    MQTTTopicIndexStep_t xSteps[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS + 1 ];
+    const MQTTTopicNode_t * pxNode;
+    uint32_t ulSteps = 0, ulOffset, ulEnd;
+    uint16_t usNode, usChild;
+
+    /* Depth first search, from the root with all the topic levels to
+     * match. Each step pushes at most two child nodes, one level deeper,
+     * and the trie is at most mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LEVELS
+     * deep, which bounds the number of pending steps. */
+    xSteps[ ulSteps ].usNode = mqtttopicindexROOT;
+    xSteps[ ulSteps ].ulOffset = 0;
+    ulSteps++;
+
+    while( ( ulSteps > 0U ) && ( xAction == eMQTTTopicIndexContinue ) )
+    {
+        ulSteps--;
+        usNode = xSteps[ ulSteps ].usNode;
+        ulOffset = xSteps[ ulSteps ].ulOffset;
+        pxNode = &( pxIndex->pxNodes[ usNode ] );
+
+        /* '#' matches the remaining levels, if any, as it includes the
+         * parent level. */
+        if( pxNode->usHashChild != mqtttopicindexROOT )
+        {
+            xAction = prvVisitEntries( pxIndex, pxNode->usHashChild, 1, pxCallback, pvContext );
+        }
+
+        if( xAction == eMQTTTopicIndexContinue )
+        {
+            if( ulOffset > usTopicLength )
+            {
+                /* All the topic levels are matched. */
+                xAction = prvVisitEntries( pxIndex, usNode, 1, pxCallback, pvContext );
+            }
+            else
+            {
+                ulEnd = prvLevelEnd( pucTopic, usTopicLength, ulOffset );
+
+                /* '+' matches this level. Pushed first so that the plain
+                 * level is searched first. */
+                if( pxNode->usPlusChild != mqtttopicindexROOT )
+                {
+                    mqttconfigASSERT( ulSteps < ( sizeof( xSteps ) / sizeof( xSteps[ 0 ] ) ) );
+                    xSteps[ ulSteps ].usNode = pxNode->usPlusChild;
+                    xSteps[ ulSteps ].ulOffset = ulEnd + 1U;
+                    ulSteps++;
+                }
+
+                usChild = prvFindChild( pxIndex, usNode, prvHashLevel( &( pucTopic[ ulOffset ] ), ulEnd - ulOffset ) );
+
+                if( usChild != mqtttopicindexROOT )
+                {
+                    mqttconfigASSERT( ulSteps < ( sizeof( xSteps ) / sizeof( xSteps[ 0 ] ) ) );
+                    xSteps[ ulSteps ].usNode = usChild;
+                    xSteps[ ulSteps ].ulOffset = ulEnd + 1U;
+                    ulSteps++;
+                }
+            }
+        }
+    }
+
+    return xAction;
+}
+/*-----------------------------------------------------------*/
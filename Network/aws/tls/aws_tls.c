@@ -36,18 +36,21 @@
 
 /* mbedTLS includes. */
 #include "mbedtls/platform.h"
+#include "mbedtls/platform_util.h"
 #include "mbedtls/net.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/entropy.h"
 #include "mbedtls/sha256.h"
 #include "mbedtls/pk.h"
 #include "mbedtls/pk_internal.h"
+#include "mbedtls/ssl_internal.h"
 #include "mbedtls/debug.h"
 #ifdef MBEDTLS_DEBUG_C
     #define tlsDEBUG_VERBOSE    4
 #endif
 
 /* C runtime includes. */
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
 #include <stdio.h>
@@ -62,6 +65,7 @@
  * @param[in] xNetworkSend Callback for sending data on an open TCP socket.
  * @param[in] pvCallerContext Opaque pointer provided by caller for above callbacks.
  * @param[out] xTLSCHandshakeSuccessful Indicates whether TLS handshake was successfully completed.
+ * @param[out] xTLSFullHandshake Indicates the server certificate was verified, i.e. the session was not resumed.
  * @param[out] xMbedSslCtx Connection context for mbedTLS.
  * @param[out] xMbedSslConfig Configuration context for mbedTLS.
  * @param[out] xMbedX509CA Server certificate context for mbedTLS.
@@ -83,6 +87,7 @@ typedef struct TLSContext
     NetworkSend_t xNetworkSend;
     void * pvCallerContext;
     BaseType_t xTLSHandshakeSuccessful;
+    BaseType_t xTLSFullHandshake;
 
     /* mbedTLS. */
     mbedtls_ssl_context xMbedSslCtx;
@@ -101,6 +106,59 @@ typedef struct TLSContext
 
 #define TLS_PRINT( X )    vLoggingPrintf X
 
+/**
+ * @brief Largest session ticket that will be retained for resumption. Larger
+ * tickets are dropped, and the session ID is offered instead.
+ */
+#ifndef tlsconfigSESSION_TICKET_MAX_LENGTH
+    #define tlsconfigSESSION_TICKET_MAX_LENGTH    ( 512 )
+#endif
+
+/**
+ * @brief Marks a valid saved session, "TLSS".
+ */
+#define tlsSESSION_MAGIC    ( 0x544C5353UL )
+
+/**
+ * @brief The parameters of the last negotiated session, offered to the server
+ * on the next connect so the certificate exchange and key agreement can be
+ * skipped.
+ *
+ * The record is placed in RAM that the startup code does not initialize, so it
+ * survives a warm reset. A checksum guards against the random contents found
+ * after power-up.
+ */
+typedef struct TLSSavedSession
+{
+    uint32_t ulMagic;
+    uint32_t ulDestinationHash;
+    int lCiphersuite;
+    int lCompression;
+    size_t xIdLength;
+    unsigned char ucId[ 32 ];
+    unsigned char ucMaster[ 48 ];
+    uint32_t ulVerifyResult;
+    #if defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH )
+        unsigned char ucMflCode;
+    #endif
+    #if defined( MBEDTLS_SSL_TRUNCATED_HMAC )
+        int lTruncHmac;
+    #endif
+    #if defined( MBEDTLS_SSL_ENCRYPT_THEN_MAC )
+        int lEncryptThenMac;
+    #endif
+    #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+        uint32_t ulTicketLifetime;
+        size_t xTicketLength;
+        unsigned char ucTicket[ tlsconfigSESSION_TICKET_MAX_LENGTH ];
+    #endif
+    uint32_t ulChecksum;
+} TLSSavedSession_t;
+
+static TLSSavedSession_t xSavedSession __attribute__( ( section( ".noinit" ) ) );
+
+static TLSHandshakeMetrics_t xHandshakeMetrics = { 0 };
+
 /*
  * Helper routines.
  */
@@ -130,6 +188,207 @@ static void prvFreeContext( TLSContext_t * pxCtx )
     }
 }
 
+/**
+ * @brief FNV-1a hash, used to fingerprint the saved session and destination.
+ *
+ * @param[in] pucData Bytes to hash.
+ * @param[in] xLength Length in bytes of pucData.
+ *
+ * @return 32-bit hash.
+ */
+static uint32_t prvHash( const unsigned char * pucData,
+                         size_t xLength )
+{
+    uint32_t ulHash = 2166136261UL;
+
+    while( xLength-- > 0 )
+    {
+        ulHash ^= *pucData++;
+        ulHash *= 16777619UL;
+    }
+
+    return ulHash;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvSessionChecksum( void )
+{
+    return prvHash( ( const unsigned char * ) &xSavedSession,
+                    offsetof( TLSSavedSession_t, ulChecksum ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvDestinationHash( const TLSContext_t * pxCtx )
+{
+    if( NULL == pxCtx->pcDestination )
+    {
+        return 0;
+    }
+
+    return prvHash( ( const unsigned char * ) pxCtx->pcDestination, strlen( pxCtx->pcDestination ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Discards the saved session, the next connect performs a full handshake.
+ */
+static void prvSessionInvalidate( void )
+{
+    memset( &xSavedSession, 0, sizeof( xSavedSession ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Offers the saved session to the server, if one exists for this
+ * destination.
+ *
+ * @param[in] pxCtx TLS context, after mbedtls_ssl_setup().
+ */
+static void prvSessionRestore( TLSContext_t * pxCtx )
+{
+    mbedtls_ssl_session xSession;
+
+    if( ( tlsSESSION_MAGIC != xSavedSession.ulMagic ) ||
+        ( prvSessionChecksum() != xSavedSession.ulChecksum ) ||
+        ( prvDestinationHash( pxCtx ) != xSavedSession.ulDestinationHash ) )
+    {
+        return;
+    }
+
+    mbedtls_ssl_session_init( &xSession );
+    xSession.ciphersuite = xSavedSession.lCiphersuite;
+    xSession.compression = xSavedSession.lCompression;
+    xSession.id_len = xSavedSession.xIdLength;
+    memcpy( xSession.id, xSavedSession.ucId, sizeof( xSession.id ) );
+    memcpy( xSession.master, xSavedSession.ucMaster, sizeof( xSession.master ) );
+    xSession.verify_result = xSavedSession.ulVerifyResult;
+    #if defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH )
+        xSession.mfl_code = xSavedSession.ucMflCode;
+    #endif
+    #if defined( MBEDTLS_SSL_TRUNCATED_HMAC )
+        xSession.trunc_hmac = xSavedSession.lTruncHmac;
+    #endif
+    #if defined( MBEDTLS_SSL_ENCRYPT_THEN_MAC )
+        xSession.encrypt_then_mac = xSavedSession.lEncryptThenMac;
+    #endif
+    #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+        /* mbedtls_ssl_set_session() takes its own copy of the ticket. */
+        xSession.ticket = ( xSavedSession.xTicketLength > 0 ) ? xSavedSession.ucTicket : NULL;
+        xSession.ticket_len = xSavedSession.xTicketLength;
+        xSession.ticket_lifetime = xSavedSession.ulTicketLifetime;
+    #endif
+
+    if( 0 != mbedtls_ssl_set_session( &pxCtx->xMbedSslCtx, &xSession ) )
+    {
+        prvSessionInvalidate();
+    }
+
+    /* Not released with mbedtls_ssl_session_free(), the ticket is not heap
+     * allocated. Only the secrets on the stack need clearing. */
+    mbedtls_platform_zeroize( &xSession, sizeof( xSession ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Saves the session negotiated by a successful handshake.
+ *
+ * @param[in] pxCtx TLS context, after the handshake completed.
+ */
+static void prvSessionSave( const TLSContext_t * pxCtx )
+{
+    const mbedtls_ssl_session * pxSession = pxCtx->xMbedSslCtx.session;
+
+    prvSessionInvalidate();
+
+    if( NULL == pxSession )
+    {
+        return;
+    }
+
+    xSavedSession.ulDestinationHash = prvDestinationHash( pxCtx );
+    xSavedSession.lCiphersuite = pxSession->ciphersuite;
+    xSavedSession.lCompression = pxSession->compression;
+    xSavedSession.xIdLength = pxSession->id_len;
+    memcpy( xSavedSession.ucId, pxSession->id, sizeof( xSavedSession.ucId ) );
+    memcpy( xSavedSession.ucMaster, pxSession->master, sizeof( xSavedSession.ucMaster ) );
+    xSavedSession.ulVerifyResult = pxSession->verify_result;
+    #if defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH )
+        xSavedSession.ucMflCode = pxSession->mfl_code;
+    #endif
+    #if defined( MBEDTLS_SSL_TRUNCATED_HMAC )
+        xSavedSession.lTruncHmac = pxSession->trunc_hmac;
+    #endif
+    #if defined( MBEDTLS_SSL_ENCRYPT_THEN_MAC )
+        xSavedSession.lEncryptThenMac = pxSession->encrypt_then_mac;
+    #endif
+    #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+        if( ( NULL != pxSession->ticket ) &&
+            ( pxSession->ticket_len <= sizeof( xSavedSession.ucTicket ) ) )
+        {
+            memcpy( xSavedSession.ucTicket, pxSession->ticket, pxSession->ticket_len );
+            xSavedSession.xTicketLength = pxSession->ticket_len;
+            xSavedSession.ulTicketLifetime = pxSession->ticket_lifetime;
+        }
+    #endif
+
+    #if defined( MBEDTLS_SSL_SESSION_TICKETS )
+        if( ( 0 == xSavedSession.xIdLength ) && ( 0 == xSavedSession.xTicketLength ) )
+    #else
+        if( 0 == xSavedSession.xIdLength )
+    #endif
+    {
+        /* Server does not support resumption. */
+        prvSessionInvalidate();
+        return;
+    }
+
+    xSavedSession.ulMagic = tlsSESSION_MAGIC;
+    xSavedSession.ulChecksum = prvSessionChecksum();
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Records the duration of a completed handshake.
+ *
+ * @param[in] xFull pdTRUE for a full handshake, pdFALSE if resumed.
+ * @param[in] ulMs Duration in milliseconds.
+ */
+static void prvRecordHandshake( BaseType_t xFull,
+                                uint32_t ulMs )
+{
+    if( pdTRUE == xFull )
+    {
+        xHandshakeMetrics.ulFullCount++;
+        xHandshakeMetrics.ulFullLastMs = ulMs;
+
+        if( ulMs > xHandshakeMetrics.ulFullMaxMs )
+        {
+            xHandshakeMetrics.ulFullMaxMs = ulMs;
+        }
+    }
+    else
+    {
+        xHandshakeMetrics.ulResumedCount++;
+        xHandshakeMetrics.ulResumedLastMs = ulMs;
+
+        if( ulMs > xHandshakeMetrics.ulResumedMaxMs )
+        {
+            xHandshakeMetrics.ulResumedMaxMs = ulMs;
+        }
+    }
+
+    TLS_PRINT( ( "TLS %s handshake completed in %u ms\r\n",
+                 ( pdTRUE == xFull ) ? "full" : "resumed", ( unsigned ) ulMs ) );
+}
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Network send callback shim.
  *
@@ -218,9 +477,11 @@ static int prvCheckCertificate( void * pvCtx,
     const char cMonths[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
 
     /* Unreferenced parameters. */
-    ( void ) ( pvCtx );
     ( void ) ( lPathCount );
 
+    /* Certificates are only presented during a full handshake. */
+    ( ( TLSContext_t * ) pvCtx )->xTLSFullHandshake = pdTRUE; /*lint !e9087 !e9079 Allow casting void* to other types. */
+
     /* Parse the date string fields. */
     sscanf( __DATE__,
             "%3s %d %d",
@@ -601,6 +862,7 @@ BaseType_t TLS_Connect( void * pvContext )
 {
     BaseType_t xResult = 0;
     TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+    TickType_t xHandshakeStart = 0;
 
     /* Ensure that the FreeRTOS heap is used. */
     CRYPTO_ConfigureHeap();
@@ -707,6 +969,12 @@ BaseType_t TLS_Connect( void * pvContext )
         xResult = mbedtls_ssl_set_hostname( &pxCtx->xMbedSslCtx, pxCtx->pcDestination );
     }
 
+    /* Offer the previous session for resumption. */
+    if( 0 == xResult )
+    {
+        prvSessionRestore( pxCtx );
+    }
+
     /* Set the socket callbacks. */
     if( 0 == xResult )
     {
@@ -717,6 +985,9 @@ BaseType_t TLS_Connect( void * pvContext )
                              NULL );
 
         /* Negotiate. */
+        pxCtx->xTLSFullHandshake = pdFALSE;
+        xHandshakeStart = xTaskGetTickCount();
+
         while( 0 != ( xResult = mbedtls_ssl_handshake( &pxCtx->xMbedSslCtx ) ) )
         {
             if( ( MBEDTLS_ERR_SSL_WANT_READ != xResult ) &&
@@ -724,8 +995,10 @@ BaseType_t TLS_Connect( void * pvContext )
             {
                 /* There was an unexpected error. Per mbedTLS API documentation,
                  * ensure that upstream clean-up code doesn't accidentally use
-                 * a context that failed the handshake. */
+                 * a context that failed the handshake. The saved session
+                 * may be what the server objected to, so drop it too. */
                 prvFreeContext( pxCtx );
+                prvSessionInvalidate();
                 TLS_PRINT( ( "ERROR: Handshake failed with error code %d \r\n", xResult ) );
                 break;
             }
@@ -736,6 +1009,9 @@ BaseType_t TLS_Connect( void * pvContext )
     if( 0 == xResult )
     {
         pxCtx->xTLSHandshakeSuccessful = pdTRUE;
+        prvRecordHandshake( pxCtx->xTLSFullHandshake,
+                            ( uint32_t ) ( xTaskGetTickCount() - xHandshakeStart ) * portTICK_PERIOD_MS );
+        prvSessionSave( pxCtx );
     }
     else if( xResult > 0 )
     {
@@ -856,6 +1132,142 @@ BaseType_t TLS_Send( void * pvContext,
 
 /*-----------------------------------------------------------*/
 
+BaseType_t TLS_SendVector( void * pvContext,
+                           const TLSSegment_t * pxSegments,
+                           size_t xSegmentCount )
+{
+    BaseType_t xResult = 0;
+    TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
+    mbedtls_ssl_context * pxSsl;
+    size_t xWritten = 0;
+    size_t xSegment = 0;
+    size_t xOffset = 0;
+    size_t xMaxRecord = 0;
+    size_t xRecordLength;
+    size_t xCopy;
+
+    if( ( NULL != pxCtx ) && ( pdTRUE == pxCtx->xTLSHandshakeSuccessful ) )
+    {
+        /* Record splitting, renegotiation and DTLS are not enabled in
+         * tls_config.h, so an application data record is written here the same
+         * way mbedtls_ssl_write() does, except that its plaintext is gathered
+         * from the segments directly. */
+        pxSsl = &pxCtx->xMbedSslCtx;
+        xResult = mbedtls_ssl_get_max_out_record_payload( pxSsl );
+
+        if( 0 < xResult )
+        {
+            xMaxRecord = ( size_t ) xResult;
+            xResult = 0;
+        }
+        else if( 0 == xResult )
+        {
+            xResult = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+        }
+
+        while( 0 == xResult )
+        {
+            /* Finish sending the previous record first, it may be left over
+             * from an earlier call. */
+            if( 0 != pxSsl->out_left )
+            {
+                xResult = mbedtls_ssl_flush_output( pxSsl );
+
+                if( ( ( 0 == xResult ) && ( 0 != pxSsl->out_left ) ) || ( -pdFREERTOS_ERRNO_ENOSPC == xResult ) )
+                {
+                    /* No data sent. The secure sockets API supports
+                     * non-blocking send, so stop but don't flag an error. */
+                    xResult = 0;
+                    break;
+                }
+            }
+            else
+            {
+                while( ( xSegment < xSegmentCount ) && ( xOffset == pxSegments[ xSegment ].xLength ) )
+                {
+                    xSegment++;
+                    xOffset = 0;
+                }
+
+                if( xSegment == xSegmentCount )
+                {
+                    break;
+                }
+
+                /* Fill the record from as many segments as fit. */
+                xRecordLength = 0;
+
+                while( ( xSegment < xSegmentCount ) && ( xRecordLength < xMaxRecord ) )
+                {
+                    xCopy = pxSegments[ xSegment ].xLength - xOffset;
+
+                    if( xCopy > ( xMaxRecord - xRecordLength ) )
+                    {
+                        xCopy = xMaxRecord - xRecordLength;
+                    }
+
+                    memcpy( pxSsl->out_msg + xRecordLength, pxSegments[ xSegment ].pucData + xOffset, xCopy );
+                    xRecordLength += xCopy;
+                    xOffset += xCopy;
+
+                    if( xOffset == pxSegments[ xSegment ].xLength )
+                    {
+                        xSegment++;
+                        xOffset = 0;
+                    }
+                }
+
+                pxSsl->out_msglen = xRecordLength;
+                pxSsl->out_msgtype = MBEDTLS_SSL_MSG_APPLICATION_DATA;
+
+                /* Once encrypted the record is committed, if the network
+                 * could not take all of it the rest waits in out_left. */
+                xResult = mbedtls_ssl_write_record( pxSsl, 1 );
+
+                if( ( 0 == xResult ) || ( MBEDTLS_ERR_SSL_WANT_WRITE == xResult ) ||
+                    ( -pdFREERTOS_ERRNO_ENOSPC == xResult ) )
+                {
+                    xWritten += xRecordLength;
+                    xResult = 0;
+                }
+            }
+
+            if( MBEDTLS_ERR_SSL_WANT_WRITE == xResult )
+            {
+                xResult = 0;
+            }
+        }
+
+        if( 0 > xResult )
+        {
+            /* Hard error: invalidate the context. */
+            prvFreeContext( pxCtx );
+        }
+    }
+    else
+    {
+        xResult = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+    }
+
+    if( 0 <= xResult )
+    {
+        xResult = ( BaseType_t ) xWritten;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void TLS_GetHandshakeMetrics( TLSHandshakeMetrics_t * pxMetrics )
+{
+    taskENTER_CRITICAL();
+    *pxMetrics = xHandshakeMetrics;
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
 void TLS_Cleanup( void * pvContext )
 {
     TLSContext_t * pxCtx = ( TLSContext_t * ) pvContext; /*lint !e9087 !e9079 Allow casting void* to other types. */
@@ -240,11 +240,22 @@ void WiFiStation::disconnect()
 
 /**
  * @brief	Return the connection status
+ * @note	While connected, the module is queried so a dropped access point is reported
+ * 			as WL_CONNECTION_LOST. The query does not wait for a busy module, the status is
+ * 			left unchanged until the module is free.
  * @retval  Current state of connection
  */
 WiFiStatus WiFiStation::status()
 {
 	WiFiStation::init();
+
+	BaseType_t connected;
+	if ( pimpl->wifiStatus == WiFiStatus::WL_CONNECTED &&
+		 WIFI_PollConnected( &connected ) == eWiFiSuccess && connected == pdFALSE )
+	{
+		pimpl->wifiStatus = WiFiStatus::WL_CONNECTION_LOST;
+	}
+
 	return pimpl->wifiStatus;
 }
 
@@ -264,9 +264,8 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-//  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-//  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
-  SYS_CDC_RxMessageIsr(*Len);
+  /* Queued by the device layer, which also re-arms the endpoint */
+  SYS_CDC_RxMessageIsr(Buf, *Len);
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2019 Andrew Bonneville.  All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+"""Decodes the binary trace log written when configLOGGING_BINARY_TRACE is 1.
+
+The device sends each log record unformatted: the address of its format string,
+the message number, tick count, task handle and raw arguments.  This script reads
+the format strings from the ELF file that was loaded onto the device and prints
+the same text the logging task would have produced.  See prvOutputRecord() in
+HAL-Extension/Src/aws_logging_task_dynamic_buffers.c for the frame layout.
+
+Usage:
+    trace_decoder.py Startup.elf /dev/ttyACM0
+    trace_decoder.py Startup.elf capture.bin
+
+A serial port must be in raw mode, e.g. "stty -F /dev/ttyACM0 raw".
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_RECORD = 0x01
+FRAME_TASK_NAME = 0x02
+FRAME_DROPPED = 0x03
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+# A conversion specification, matching prvNextConversion() on the device.
+CONVERSION = re.compile(r'%(?P<flags>[-+ #0]*)(?P<width>\*|\d*)(?:\.(?P<precision>\*|\d*))?'
+                        r'(?P<length>hh|h|ll|l|j|z|t)?(?P<type>[diuoxXcfFeEgGaAps%])')
+
+
+class Elf:
+    """Reads constant data, such as format strings, out of an ELF file."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError('%s is not an ELF file' % path)
+
+        self.is64 = self.data[4] == 2
+        self.endian = '<' if self.data[5] == 1 else '>'
+
+        if self.is64:
+            shoff, = struct.unpack_from(self.endian + 'Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(self.endian + 'HH', self.data, 0x3A)
+            entry = self.endian + 'IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from(self.endian + 'I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(self.endian + 'HH', self.data, 0x2E)
+            entry = self.endian + 'IIIIIIIIII'
+
+        self.sections = []
+        for index in range(shnum):
+            fields = struct.unpack_from(entry, self.data, shoff + index * shentsize)
+            flags, addr, offset, size, kind = fields[2], fields[3], fields[4], fields[5], fields[1]
+            if (flags & SHF_ALLOC) and kind != SHT_NOBITS and size > 0:
+                self.sections.append((addr, offset, size))
+
+    def string(self, address):
+        """Returns the C string at a load address, or None if it is not in the file."""
+        for addr, offset, size in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.find(b'\0', start, offset + size)
+                if end < 0:
+                    end = offset + size
+                return self.data[start:end].decode('utf-8', 'replace')
+        return None
+
+
+class Decoder:
+    """Turns binary trace frames back into the device's text log."""
+
+    def __init__(self, elf):
+        self.elf = elf
+        word = 'Q' if elf.is64 else 'I'
+        self.sizes = {
+            None: ('i', 4), 'hh': ('i', 4), 'h': ('i', 4),
+            'l': ('q', 8) if elf.is64 else ('i', 4),
+            'll': ('q', 8), 'j': ('q', 8),
+            'z': (word, 8 if elf.is64 else 4), 't': (word, 8 if elf.is64 else 4),
+        }
+        self.pointer = (word, 8 if elf.is64 else 4)
+        self.header = struct.Struct(elf.endian + word + 'II' + word)
+        self.tasks = {}
+
+    def frame(self, data):
+        """Decodes one frame, already stripped of its COBS encoding."""
+        if not data:
+            return None
+
+        kind, body = data[0], data[1:]
+
+        if kind == FRAME_TASK_NAME:
+            handle, = struct.unpack_from(self.elf.endian + self.pointer[0], body)
+            self.tasks[handle] = body[self.pointer[1]:].decode('utf-8', 'replace')
+            return None
+
+        if kind == FRAME_DROPPED:
+            dropped, = struct.unpack_from(self.elf.endian + 'I', body)
+            return '%u log messages dropped\r\n' % dropped
+
+        if kind == FRAME_RECORD and len(body) >= self.header.size:
+            address, number, ticks, handle = self.header.unpack_from(body)
+            arguments = body[self.header.size:]
+
+            if address == 0:
+                return arguments.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+            fmt = self.elf.string(address)
+            if fmt is None:
+                return '<unknown format string at 0x%x>\r\n' % address
+
+            text = self.format(fmt, arguments)
+            if fmt == '\n':
+                return text
+            task = self.tasks.get(handle, 'None' if handle == 0 else '0x%x' % handle)
+            return '%u %u [%s] %s' % (number, ticks, task, text)
+
+        return '<malformed frame>\r\n'
+
+    def format(self, fmt, arguments):
+        """Rebuilds the text of one record the way prvFormatRecord() does."""
+        out = []
+        offset = 0
+        position = 0
+
+        def take(code, size):
+            nonlocal offset
+            if offset + size > len(arguments):
+                raise IndexError
+            value, = struct.unpack_from(self.elf.endian + code, arguments, offset)
+            offset += size
+            return value
+
+        try:
+            while True:
+                start = fmt.find('%', position)
+                if start < 0:
+                    break
+
+                out.append(fmt[position:start])
+                match = CONVERSION.match(fmt, start)
+                if match is None:
+                    # Like the device, stop at a conversion that cannot be deferred.
+                    return ''.join(out)
+
+                position = match.end()
+                conversion = match.group('type')
+
+                if conversion == '%':
+                    out.append('%')
+                    continue
+
+                stars = []
+                if match.group('width') == '*':
+                    stars.append(take('i', 4))
+                if match.group('precision') == '*':
+                    stars.append(take('i', 4))
+
+                if conversion == 's':
+                    end = arguments.find(b'\0', offset)
+                    if end < 0:
+                        raise IndexError
+                    value = arguments[offset:end].decode('utf-8', 'replace')
+                    offset = end + 1
+                elif conversion == 'p':
+                    value = take(*self.pointer)
+                elif conversion in 'fFeEgGaA':
+                    value = take('d', 8)
+                else:
+                    code, size = self.sizes[match.group('length')]
+                    if conversion not in 'dic':
+                        code = code.upper()
+                    value = take(code, size)
+
+                # Python formats like C once the length modifier is dropped,
+                # apart from %p and %a which are spelled out here.
+                spec = '%' + match.group('flags') + match.group('width')
+                if match.group('precision') is not None:
+                    spec += '.' + match.group('precision')
+
+                if conversion == 'p':
+                    out.append((spec + 's') % tuple(stars + [hex(value)]))
+                elif conversion in 'aA':
+                    out.append((spec + 's') % tuple(stars + [value.hex()]))
+                else:
+                    spec += 'd' if conversion in 'iu' else conversion
+                    out.append(spec % tuple(stars + [value]))
+        except IndexError:
+            # The device stops formatting at the first missing argument too.
+            return ''.join(out)
+
+        out.append(fmt[position:])
+        return ''.join(out)
+
+
+def frames(stream):
+    """Yields COBS decoded frames, each delimited by a zero byte."""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        if chunk[0] != 0:
+            buffer += chunk
+            continue
+
+        decoded = bytearray()
+        index = 0
+        valid = True
+        while index < len(buffer):
+            code = buffer[index]
+            if code == 0 or index + code > len(buffer):
+                valid = False
+                break
+            decoded += buffer[index + 1:index + code]
+            index += code
+            if code != 0xFF and index < len(buffer):
+                decoded.append(0)
+
+        buffer.clear()
+        if valid:
+            yield bytes(decoded)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes the device binary trace log.')
+    parser.add_argument('elf', help='ELF file loaded onto the device')
+    parser.add_argument('input', nargs='?', help='serial port or capture file, default stdin')
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf))
+    stream = open(args.input, 'rb', buffering=0) if args.input else sys.stdin.buffer
+
+    for data in frames(stream):
+        text = decoder.frame(data)
+        if text:
+            sys.stdout.write(text)
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()